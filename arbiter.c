@@ -0,0 +1,76 @@
+/* Filename: arbiter.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: First press wins. See arbiter.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include "arbiter.h"
+
+void ArbiterInit(Arbiter *a)
+{
+	atomic_init(&a->Word, 0);
+	atomic_init(&a->Claims, 0);
+	atomic_init(&a->Retries, 0);
+	atomic_init(&a->Overtaken, 0);
+}
+
+void ArbiterOpen(Arbiter *a, uint32_t round)
+{
+	atomic_store_explicit(&a->Claims, 0, memory_order_relaxed);
+	atomic_store_explicit(&a->Word, (uint64_t)(uint16_t)round << ARB_ROUND_SHIFT, memory_order_release);
+}
+
+ArbResult ArbiterClaim(Arbiter *a, uint32_t round, uint64_t pressns, int rank, int player)
+{
+	uint64_t cur = atomic_load_explicit(&a->Word, memory_order_acquire);
+	uint64_t mine;
+
+	if(pressns > ARB_PRESS_MAX)
+		pressns = ARB_PRESS_MAX;
+	if(rank <= 0 || rank > ARB_RANK_NONE)
+		rank = ARB_RANK_NONE;
+	mine = (uint64_t)(uint16_t)round << ARB_ROUND_SHIFT | pressns << ARB_PRESS_SHIFT
+		| (uint64_t)rank << ARB_RANK_SHIFT | (uint64_t)(player & 0x1f);
+
+	atomic_fetch_add_explicit(&a->Claims, 1, memory_order_relaxed);
+	while(1)
+	{
+		if(ArbRound(cur) != (uint16_t)round)
+			return ARB_CLOSED;
+		if(ArbSealed(cur))
+		{
+			/* too late, however early: main() already lit someone up */
+			if((mine & ARB_KEY_MASK) < (cur & ARB_KEY_MASK))
+				atomic_fetch_add_explicit(&a->Overtaken, 1, memory_order_relaxed);
+			return ARB_BEATEN;
+		}
+		if(ArbPlayer(cur) != 0 && (cur & ARB_KEY_MASK) < (mine & ARB_KEY_MASK))
+			return ARB_BEATEN;
+		if(atomic_compare_exchange_weak_explicit(&a->Word, &cur, mine, memory_order_acq_rel, memory_order_acquire))
+			return ARB_LEADING;
+		atomic_fetch_add_explicit(&a->Retries, 1, memory_order_relaxed);
+	}
+}
+
+bool ArbiterSeal(Arbiter *a, uint32_t round, uint64_t *w)
+{
+	uint64_t cur = atomic_load_explicit(&a->Word, memory_order_acquire);
+
+	while(1)
+	{
+		if(ArbRound(cur) != (uint16_t)round || ArbSealed(cur) || ArbPlayer(cur) == 0)
+			return false;
+		if(atomic_compare_exchange_weak_explicit(&a->Word, &cur, cur | ARB_SEALED, memory_order_acq_rel, memory_order_acquire))
+		{
+			*w = cur | ARB_SEALED;
+			return true;
+		}
+	}
+}
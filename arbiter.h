@@ -0,0 +1,105 @@
+/* Filename: arbiter.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Who rang in first. One 64-bit word, shared by every
+   player thread and main(), holds the round's best claim so far:
+
+	bits	63-48	round (the Enabler-active edge's Seq)
+		47	sealed: main() has started the winner's countdown
+		46-10	the press, ns after the Enabler went live (saturates at 137 s)
+		9-5	place in a scanner tie, 31 if we don't know it
+		4-0	player, 1-based, 0 while nobody has claimed
+
+   Bits 46-0 compare as one number: the earlier press wins, then the
+   better tie place, then the lower player. A player thread with a good
+   press claims it with one compare-and-swap that only goes through if
+   nobody holds a better claim, so it knows straight away, with no lock
+   and no word from main(), whether it's still in the running or
+   locked out. main() seals the word when it lights the winner's
+   countdown; from then on every claim loses.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef ARBITER_H
+#define ARBITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define ARB_ROUND_SHIFT		48
+#define ARB_SEALED		(1ull << 47)
+#define ARB_PRESS_SHIFT		10
+#define ARB_PRESS_MAX		((1ull << 37) - 1)
+#define ARB_RANK_SHIFT		5
+#define ARB_RANK_NONE		0x1f	// after every known place in a tie
+#define ARB_KEY_MASK		(ARB_SEALED - 1)
+
+typedef enum ArbResult {
+	ARB_LEADING,				// ours is the best claim so far
+	ARB_BEATEN,				// someone pressed first, or it's already decided
+	ARB_CLOSED				// that round isn't the one open
+} ArbResult;
+
+typedef struct Arbiter {
+	_Alignas(64) _Atomic uint64_t Word;
+	_Atomic uint32_t Claims;		// this round's, for "contested"
+	_Atomic uint32_t Retries;		// CASes that lost a race and looked again, ever
+	_Atomic uint32_t Overtaken;		// claims earlier than the one already sealed, ever
+} Arbiter;
+
+static inline uint16_t ArbRound(uint64_t w)
+{
+	return (uint16_t)(w >> ARB_ROUND_SHIFT);
+}
+
+static inline bool ArbSealed(uint64_t w)
+{
+	return (w & ARB_SEALED) != 0;
+}
+
+static inline uint64_t ArbPressNs(uint64_t w)
+{
+	return (w >> ARB_PRESS_SHIFT) & ARB_PRESS_MAX;
+}
+
+static inline int ArbRank(uint64_t w)
+{
+	int rank = (int)((w >> ARB_RANK_SHIFT) & 0x1f);
+
+	return rank == ARB_RANK_NONE ? 0 : rank;
+}
+
+static inline int ArbPlayer(uint64_t w)
+{
+	return (int)(w & 0x1f);
+}
+
+void ArbiterInit(Arbiter *a);
+
+/* A new round: nobody has claimed it. main() calls this before telling
+   the player threads the Enabler is live. */
+void ArbiterOpen(Arbiter *a, uint32_t round);
+
+/* Claim round's ring-in for player, pressed pressns after the Enabler
+   went live, rank in its tie (0 for none) */
+ArbResult ArbiterClaim(Arbiter *a, uint32_t round, uint64_t pressns, int rank, int player);
+
+/* main(): close round on the best claim so far. Returns true with *w
+   the sealed word, or false if nobody has claimed it (or it's already
+   sealed, or it isn't the open round). */
+bool ArbiterSeal(Arbiter *a, uint32_t round, uint64_t *w);
+
+/* The word as it stands */
+static inline uint64_t ArbiterPeek(Arbiter *a)
+{
+	return atomic_load_explicit(&a->Word, memory_order_acquire);
+}
+
+#endif
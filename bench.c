@@ -0,0 +1,2226 @@
+/* Filename: bench.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Benchmarks and stress tests for the ring-in internals.
+   Runs on any Linux box; build with "make SIM=1 bench" off the Pi.
+
+   Usage: jeopardy-bench [name...]    (no names runs everything)
+   Exits nonzero if any benchmark's correctness check fails.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <termios.h>
+
+#include "msgqueue.h"
+#include "reactor.h"
+#include "scanner.h"
+#include "debounce.h"
+#include "serproto.h"
+#include "countdown.h"
+#include "pins.h"
+#include "gpioio.h"
+#include "gpiosim.h"
+#include "player.h"
+#include "latency.h"
+#include "trace.h"
+#include "clock.h"
+#include "rt.h"
+#include "cancel.h"
+#include "log.h"
+#include "serlink.h"
+#include "serout.h"
+#include "arbiter.h"
+
+#define SPSC_MESSAGES 1000000
+#define ARMED_EDGES 5000
+#define PLAYERS_PRESSES 4000
+#define LINES_PRESSES 1000
+#define FRAMES_COUNT 100000
+#define COUNTDOWN_RUNS 500
+#define LATENCY_SAMPLES 1000000
+#define TRACE_WRITERS 4
+#define TRACE_WRITES 250000
+#define WAKEUP_PERIOD_NS 100000ull
+#define WAKEUP_SAMPLES 10000
+#define WAKEUP_LOAD 2
+#define LIGHTBAR_COUNTDOWNS 100000
+#define CANCEL_RUNS 1000
+#define CANCEL_POLLED_RUNS 100
+#define CANCEL_POLL_NS 10000000ull
+#define LOG_LINES 2000
+#define LOG_GAP_NS 100000ull
+#define LOG_CONSOLE_BYTES 64		// what the slow console takes a ms
+#define SERIAL_FRAMES 2000
+#define SERIAL_GAP_NS 200000ull
+#define SERIAL_IDLE_NS 300000000ull
+#define RECONNECT_CYCLES 20
+#define RECONNECT_BACKOFF_CYCLES 5
+#define RECONNECT_AWAY_NS 300000000ull	// how long the device stays gone before a backoff-only return
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- spsc: a million back-to-back commands, none lost or reordered ---- */
+
+static MsgQueue *SpscQueue;
+
+static void *SpscProducer(void *arg)
+{
+	Msg m = { 0 };
+	uint32_t i;
+
+	(void)arg;
+	m.Code = CMD_ENABLER_ACTIVE;
+	m.Player = 1;
+	for(i = 0; i < SPSC_MESSAGES; i++)
+	{
+		m.Seq = i;
+		m.Code = (i & 1) ? CMD_ENABLER_INACTIVE : CMD_ENABLER_ACTIVE;
+		MsgQueueSend(SpscQueue, &m);
+	}
+
+	return NULL;
+}
+
+static int BenchSpsc(void)
+{
+	pthread_t producer;
+	uint64_t start, elapsed;
+	uint32_t expect = 0;
+	unsigned long bad = 0;
+	Msg m;
+
+	SpscQueue = aligned_alloc(64, sizeof(MsgQueue));
+	MsgQueueInit(SpscQueue, -1);
+
+	start = NowNs();
+	pthread_create(&producer, NULL, SpscProducer, NULL);
+	while(expect < SPSC_MESSAGES)
+	{
+		if(!MsgQueuePop(SpscQueue, &m))
+		{
+			sched_yield();
+			continue;
+		}
+		if(m.Seq != expect || m.Code != ((expect & 1) ? CMD_ENABLER_INACTIVE : CMD_ENABLER_ACTIVE))
+			bad++;
+		expect = m.Seq + 1;
+	}
+	pthread_join(producer, NULL);
+	elapsed = NowNs() - start;
+
+	printf("spsc: %u commands in %.1f ms, %.1f Mmsg/s, %lu out of order or lost, %u left in queue\n", SPSC_MESSAGES, elapsed / 1e6, SPSC_MESSAGES / (elapsed / 1e3), bad, MsgQueueDepth(SpscQueue));
+
+	free(SpscQueue);
+	return (bad == 0) ? 0 : 1;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Print min/p50/p99/max of samples (sorts them). */
+static void PrintPercentiles(const char *what, uint64_t *samples, size_t n)
+{
+	if(n == 0)
+		return;
+
+	qsort(samples, n, sizeof(samples[0]), CompareU64);
+	printf("%s: n=%zu min %llu p50 %llu p99 %llu max %llu ns\n", what, n,
+		(unsigned long long)samples[0],
+		(unsigned long long)samples[n / 2],
+		(unsigned long long)samples[n * 99 / 100],
+		(unsigned long long)samples[n - 1]);
+}
+
+static double CpuSeconds(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/* ---- armed: Enabler edge -> reactor in main() -> player thread armed ----
+   Same path as gpio.c: the scanner pokes an eventfd, main()'s reactor
+   turns that into CMD_ENABLER_ACTIVE on the player's queue, and the
+   player thread, asleep on the queue's eventfd, wakes up and takes it. */
+
+typedef struct ArmedBench {
+	int EnablerFd;
+	_Atomic uint64_t EdgeNs;
+	MsgQueue *Cmd;
+	uint64_t *Samples;
+	_Atomic int Armed;
+	Reactor R;
+} ArmedBench;
+
+static void ArmedOnEnabler(int fd, uint32_t events, void *ctx)
+{
+	ArmedBench *ab = (ArmedBench *)ctx;
+	Msg m = { 0 };
+
+	(void)events;
+	ReactorDrain(fd);
+	m.Code = CMD_ENABLER_ACTIVE;
+	m.TimeNs = atomic_load(&ab->EdgeNs);
+	if(m.TimeNs == 0)
+	{
+		ab->R.Stop = true;
+		return;
+	}
+	MsgQueueSend(ab->Cmd, &m);
+}
+
+static void *ArmedPlayer(void *arg)
+{
+	ArmedBench *ab = (ArmedBench *)arg;
+	Msg m;
+	int n = 0;
+
+	while(n < ARMED_EDGES)
+	{
+		ReactorWaitAny(&ab->Cmd->WakeFd, 1, -1);
+		while(MsgQueuePop(ab->Cmd, &m))
+		{
+			ab->Samples[n++] = NowNs() - m.TimeNs;
+			atomic_store(&ab->Armed, 1);
+		}
+	}
+
+	return NULL;
+}
+
+static void *ArmedReactor(void *arg)
+{
+	ArmedBench *ab = (ArmedBench *)arg;
+
+	ReactorRun(&ab->R);
+	return NULL;
+}
+
+static int BenchArmed(void)
+{
+	ArmedBench ab;
+	pthread_t player, reactor;
+	struct timespec gap = { 0, 200000 };
+	struct timespec idle = { 0, 500000000 };
+	double cpu;
+	int i;
+
+	memset(&ab, 0, sizeof(ab));
+	ab.Cmd = aligned_alloc(64, sizeof(MsgQueue));
+	ab.Samples = calloc(ARMED_EDGES, sizeof(uint64_t));
+	MsgQueueInit(ab.Cmd, ReactorEventFd());
+	ab.EnablerFd = ReactorEventFd();
+	ReactorInit(&ab.R);
+	ReactorAdd(&ab.R, ab.EnablerFd, ArmedOnEnabler, &ab);
+
+	pthread_create(&player, NULL, ArmedPlayer, &ab);
+	pthread_create(&reactor, NULL, ArmedReactor, &ab);
+
+	/* nothing happening: both threads should be asleep */
+	cpu = CpuSeconds();
+	nanosleep(&idle, NULL);
+	printf("armed: idle CPU with reactor and player thread waiting: %.2f%%\n", (CpuSeconds() - cpu) / 0.5 * 100.0);
+
+	for(i = 0; i < ARMED_EDGES; i++)
+	{
+		atomic_store(&ab.Armed, 0);
+		atomic_store(&ab.EdgeNs, NowNs());
+		ReactorPoke(ab.EnablerFd);
+		while(!atomic_load(&ab.Armed))
+			nanosleep(&gap, NULL);
+	}
+	pthread_join(player, NULL);
+
+	atomic_store(&ab.EdgeNs, 0);
+	ReactorPoke(ab.EnablerFd);
+	pthread_join(reactor, NULL);
+
+	PrintPercentiles("armed: Enabler edge to player armed", ab.Samples, ARMED_EDGES);
+
+	ReactorClose(&ab.R);
+	free(ab.Samples);
+	free(ab.Cmd);
+	return 0;
+}
+
+/* ---- players: press -> scanner decode -> that player's thread awake ----
+   One sleeping thread per podium, each on its own scanner wake eventfd,
+   like PlayerThread. A press only pokes the pressed player's fd, so the
+   cost of getting the winner running should not grow with the number
+   of podiums. */
+
+typedef struct PlayersBench {
+	Scanner Scan;
+	_Atomic int Pressed;			// player index being pressed, -1 to quit
+	_Atomic uint64_t PressNs;
+	_Atomic int Seen;
+	uint64_t *Samples;
+	uint64_t *DecodeSamples;
+} PlayersBench;
+
+typedef struct PlayersArg {
+	PlayersBench *pb;
+	int Index;
+} PlayersArg;
+
+static void *PlayersPlayer(void *arg)
+{
+	PlayersArg *pa = (PlayersArg *)arg;
+	PlayersBench *pb = pa->pb;
+	int fd = pb->Scan.WakeFd[pa->Index];
+
+	for(;;)
+	{
+		ReactorWaitAny(&fd, 1, -1);
+		ReactorDrain(fd);
+		if(atomic_load(&pb->Pressed) == -1)
+			break;
+		if(atomic_load(&pb->Pressed) != pa->Index || ScannerLev(&pb->Scan, pa->Index) != 0)
+			continue;
+
+		pb->Samples[atomic_load(&pb->Seen)] = NowNs() - atomic_load(&pb->PressNs);
+		atomic_fetch_add(&pb->Seen, 1);
+	}
+
+	return NULL;
+}
+
+static int BenchPlayersN(int count)
+{
+	PlayersBench pb;
+	PlayersArg args[SCAN_MAX_PLAYERS];
+	pthread_t threads[SCAN_MAX_PLAYERS];
+	uint8_t pins[SCAN_MAX_PLAYERS] = { 0 };
+	struct timespec gap = { 0, 100000 };
+	ScanResult res;
+	uint32_t idle, rng = 0x2545f491;
+	uint64_t t0;
+	char what[64];
+	int i, who, failed = 0;
+
+	memset(&pb, 0, sizeof(pb));
+	pb.Samples = calloc(PLAYERS_PRESSES, sizeof(uint64_t));
+	pb.DecodeSamples = calloc(PLAYERS_PRESSES, sizeof(uint64_t));
+	for(i = 0; i < count; i++)
+		pins[i] = 4 + i;
+	ScannerInit(&pb.Scan, pins, count, TIEBREAK_LOWEST, 1);
+	idle = pb.Scan.PlayerMask;
+
+	for(i = 0; i < count; i++)
+	{
+		pb.Scan.WakeFd[i] = ReactorEventFd();
+		args[i].pb = &pb;
+		args[i].Index = i;
+		pthread_create(&threads[i], NULL, PlayersPlayer, &args[i]);
+	}
+
+	for(i = 0; i < PLAYERS_PRESSES; i++)
+	{
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		who = rng % count;
+
+		atomic_store(&pb.Pressed, who);
+		t0 = NowNs();
+		atomic_store(&pb.PressNs, t0);
+		if(ScannerDecode(&pb.Scan, idle & ~(1u << pins[who]), t0, &res) != 1 || res.Order[0] != who)
+			failed = 1;
+		pb.DecodeSamples[i] = NowNs() - t0;
+
+		while(atomic_load(&pb.Seen) == i)
+			nanosleep(&gap, NULL);
+
+		/* let go of the button before the next press */
+		ScannerDecode(&pb.Scan, idle, NowNs(), &res);
+	}
+
+	atomic_store(&pb.Pressed, -1);
+	for(i = 0; i < count; i++)
+	{
+		ReactorPoke(pb.Scan.WakeFd[i]);
+		pthread_join(threads[i], NULL);
+		close(pb.Scan.WakeFd[i]);
+	}
+
+	snprintf(what, sizeof(what), "players: %2d podiums, decode", count);
+	PrintPercentiles(what, pb.DecodeSamples, PLAYERS_PRESSES);
+	snprintf(what, sizeof(what), "players: %2d podiums, press to winner awake", count);
+	PrintPercentiles(what, pb.Samples, PLAYERS_PRESSES);
+	if(failed)
+		printf("players: %d podiums: scanner picked the wrong winner\n", count);
+
+	free(pb.Samples);
+	free(pb.DecodeSamples);
+	return failed;
+}
+
+static int BenchPlayers(void)
+{
+	static const int counts[] = { 3, 4, 8, 12, 16 };
+	size_t i;
+	int failed = 0;
+
+	for(i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+		failed |= BenchPlayersN(counts[i]);
+
+	return failed;
+}
+
+/* ---- lines: -c, each chardev line requested once ----
+   The kernel turns down a second request for a line with EBUSY, and -c
+   falls back to the scanner. With the default pins Player 3's button
+   is the Enabler: main() has to take that line and pass the edges on.
+   Checks the lines are shared out so none is asked for twice, then
+   rings in a real player thread on a shared line, through its queue. */
+
+/* 0 if every pin is requested once, by its player or in lines */
+static int LinesCheck(const char *what, const PlayerPins *pins, int count)
+{
+	PlayerEngine pe;
+	uint8_t others[2] = { ENABLER, OPERATOR_INTERRUPT }, lines[MAX_PLAYERS + 2];
+	int asked[64] = { 0 };
+	int n, i, j, relayed = 0, bad = 0;
+
+	if(PlayerEngineInit(&pe, pins, count) != 0)
+		return 1;
+	n = PlayerEngineShareLines(&pe, others, 2, lines);
+	for(i = 0; i < n; i++)
+		asked[lines[i]]++;
+	for(i = 0; i < count; i++)
+	{
+		if(pe.Players[i].Relayed)
+		{
+			relayed++;
+			for(j = 0; j < n && lines[j] != pins[i].Input; j++)
+				;
+			bad |= j == n;
+		}
+		else
+			asked[pins[i].Input]++;
+	}
+	for(i = 0; i < 64; i++)
+		bad |= asked[i] > 1;
+	bad |= asked[ENABLER] != 1 || asked[OPERATOR_INTERRUPT] != 1;
+
+	printf("lines: %s: %d players, %d on their own line, %d lines main() reads%s\n",
+		what, count, count - relayed, n, bad ? " - a line asked for twice, or not at all" : "");
+	free(pe.Players);
+	return bad;
+}
+
+static int BenchLines(void)
+{
+	static const PlayerPins defaults[3] = {
+		{ INPUT1, P1_LED, PIN_NONE }, { INPUT2, P2_LED, PIN_NONE }, { INPUT3, P3_LED, PIN_NONE },
+	};
+	PlayerPins pins[MAX_PLAYERS];
+	PlayerEngine pe;
+	uint8_t others[2] = { ENABLER, OPERATOR_INTERRUPT }, lines[MAX_PLAYERS + 2];
+	uint64_t *samples = calloc(LINES_PRESSES, sizeof(uint64_t));
+	uint64_t t0;
+	Msg m = { 0 }, resp = { 0 };
+	int i, failed = 0;
+
+	failed |= LinesCheck("default pins", defaults, 3);
+
+	/* sixteen podiums, two on one button and two on the interrupt's (4 + 12 is GPIO 16 too) */
+	for(i = 0; i < MAX_PLAYERS; i++)
+		pins[i] = (PlayerPins){ 4 + i, PIN_NONE, PIN_NONE };
+	pins[5].Input = pins[4].Input;
+	pins[9].Input = OPERATOR_INTERRUPT;
+	failed |= LinesCheck("sixteen podiums", pins, MAX_PLAYERS);
+
+	/* the Enabler's line's edges, passed on by hand as OnInputEdges() does;
+	   P1 and P2 have no scanner here, so they just sleep on edges nobody sends */
+	if(PlayerEngineInit(&pe, defaults, 3) != 0)
+		return 1;
+	PlayerEngineShareLines(&pe, others, 2, lines);
+	if(pe.Players[0].Relayed || !pe.Players[2].Relayed)
+		return 1;
+	pe.Players[0].Relayed = pe.Players[1].Relayed = true;
+	if(PlayerEngineStart(&pe) != 0)
+		return 1;
+
+	for(i = 0; i < LINES_PRESSES && !failed; i++)
+	{
+		ArbiterOpen(&pe.Arb, i + 1);
+		m.Code = CMD_ENABLER_ACTIVE;
+		m.Seq = i + 1;
+		m.TimeNs = NowNs();
+		MsgQueueSend(&pe.Players[2].Cmd, &m);
+
+		m.Code = CMD_INPUT_EDGE;
+		m.Arg = 0;
+		m.TimeNs = t0 = NowNs();
+		MsgQueueSend(&pe.Players[2].Cmd, &m);
+		for(;;)
+		{
+			if(ReactorWaitAny(&pe.RespWakeFd, 1, 1000) <= 0)
+			{
+				printf("lines: a press on a shared line never rang in\n");
+				failed = 1;
+				break;
+			}
+			ReactorDrain(pe.RespWakeFd);
+			while(MsgQueuePop(&pe.Players[2].Resp, &resp) && resp.Code != RESP_COUNTDOWN)
+				;
+			if(resp.Code == RESP_COUNTDOWN)
+				break;
+		}
+		samples[i] = NowNs() - t0;
+		failed |= resp.TimeNs != t0;
+
+		m.Code = CMD_INPUT_EDGE;
+		m.Arg = 1;
+		m.TimeNs = NowNs();
+		MsgQueueSend(&pe.Players[2].Cmd, &m);
+		m.Code = CMD_ENABLER_INACTIVE;
+		m.TimeNs = NowNs();
+		MsgQueueSend(&pe.Players[2].Cmd, &m);
+	}
+
+	/* the player thread runs on till we exit, as in the game */
+	if(!failed)
+		PrintPercentiles("lines: shared line edge passed on to ring-in", samples, LINES_PRESSES);
+	free(samples);
+	return failed;
+}
+
+/* ---- frames: MCP frame parser, split reads and line noise ----
+   Encodes a stream of frames with random garbage between them, feeds it
+   to FrameParse() in random-sized reads, and checks every frame comes
+   out intact and in order. Also drops and repeats frames to check
+   FrameSeqCheck() counts them. */
+
+static uint32_t FramesRng = 0x9e3779b9;
+
+static uint32_t FramesRand(void)
+{
+	FramesRng ^= FramesRng << 13;
+	FramesRng ^= FramesRng >> 17;
+	FramesRng ^= FramesRng << 5;
+	return FramesRng;
+}
+
+static int BenchFrames(void)
+{
+	uint8_t *stream = malloc(FRAMES_COUNT * (FRAME_MAX + 8));
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+	size_t size = 0, chunk, left, n, garbage = 0;
+	const uint8_t *data, *d;
+	FrameParser p;
+	FrameSeq seq = { 0 };
+	Frame f;
+	uint64_t t0, ns;
+	int i, j, got = 0, bad = 0, lost = 0, dups = 0, r;
+
+	for(i = 0; i < FRAMES_COUNT; i++)
+	{
+		/* a few bytes of noise between frames, sometimes a stray sync */
+		if(i > 0)
+		{
+			for(j = FramesRand() % 8; j > 0; j--, garbage++)
+				stream[size++] = (FramesRand() % 16 == 0) ? FRAME_SYNC : FramesRand();
+		}
+
+		r = FramesRand() % (FRAME_MAX_PAYLOAD + 1);
+		for(j = 0; j < r; j++)
+			payload[j] = i + j;
+		size += FrameEncode(stream + size, FRAME_COUNTDOWN_END, i, i * 1000, payload, r);
+	}
+
+	FrameParserInit(&p);
+	t0 = NowNs();
+	for(data = stream, left = size; left > 0; )
+	{
+		chunk = 1 + FramesRand() % 64;
+		if(chunk > left)
+			chunk = left;
+
+		d = data;
+		n = chunk;
+		while(FrameParse(&p, &d, &n, &f))
+		{
+			if(f.Seq != (uint16_t)got || f.Type != FRAME_COUNTDOWN_END || f.TimeUs != (uint32_t)got * 1000)
+				bad++;
+			for(j = 0; j < f.Len; j++)
+			{
+				if(f.Payload[j] != (uint8_t)(got + j))
+				{
+					bad++;
+					break;
+				}
+			}
+			got++;
+		}
+		data += chunk;
+		left -= chunk;
+	}
+	ns = NowNs() - t0;
+
+	printf("frames: %d frames, %zu bytes with %zu bytes of noise: recovered %d, %d bad, %lu CRC failures, %lu bytes skipped\n",
+		FRAMES_COUNT, size, garbage, got, bad, p.BadCrc, p.Skipped);
+	printf("frames: parse %.1f MB/s (%.0f ns/frame)\n", size * 1000.0 / ns, (double)ns / FRAMES_COUNT);
+
+	/* sequence: every 10th frame goes missing, every 7th is sent twice */
+	for(i = 0; i < 1000; i++)
+	{
+		if(i % 10 == 5)
+		{
+			lost++;
+			continue;
+		}
+		FrameSeqCheck(&seq, i);
+		if(i % 7 == 0)
+		{
+			FrameSeqCheck(&seq, i);
+			dups++;
+		}
+	}
+	printf("frames: sequence check: %lu lost (expected %d), %lu duplicates (expected %d)\n", seq.Lost, lost, seq.Dups, dups);
+
+	free(stream);
+	return (got != FRAMES_COUNT || bad != 0 || seq.Lost != (unsigned long)lost || seq.Dups != (unsigned long)dups);
+}
+
+/* ---- countdown: cancel request -> countdown lights off ----
+   The countdown engine runs in a reactor thread like main()'s, on the
+   simulated board, with 2 ms steps so a run doesn't take all day. A
+   second thread plays the MCP: it starts a countdown, waits a random
+   time and then asks for it to be cancelled through an SPSC queue, the
+   same way SerialThread() hands FRAME_COUNTDOWN_END to main(). */
+
+#define COUNTDOWN_START 1
+#define COUNTDOWN_STOP 2
+
+typedef struct CountdownBench {
+	Reactor R;
+	CountdownEngine Engine;
+	Player P;
+	MsgQueue *Cmd;
+	_Atomic int Done;
+	int Cancels;
+	uint64_t *Samples;
+} CountdownBench;
+
+static void CountdownBenchCmd(int fd, uint32_t events, void *ctx)
+{
+	CountdownBench *cb = (CountdownBench *)ctx;
+	Msg m;
+
+	(void)events;
+	ReactorDrain(fd);
+	while(MsgQueuePop(cb->Cmd, &m))
+	{
+		if(m.Code == COUNTDOWN_START)
+			CountdownStart(&cb->Engine, &cb->P, NowNs());
+		else if(m.Code == COUNTDOWN_STOP)
+		{
+			if(CountdownCancel(&cb->Engine, &cb->P, m.TimeNs) > 0)
+				cb->Samples[cb->Cancels++] = NowNs() - m.TimeNs;
+			if(CountdownRunning(&cb->Engine, &cb->P))
+				cb->R.Stop = true;	// cancel didn't take
+		}
+		else
+			cb->R.Stop = true;
+		atomic_store(&cb->Done, 1);
+	}
+}
+
+static void *CountdownBenchReactor(void *arg)
+{
+	CountdownBench *cb = (CountdownBench *)arg;
+
+	ReactorRun(&cb->R);
+	return NULL;
+}
+
+static void CountdownBenchSend(CountdownBench *cb, uint8_t code)
+{
+	struct timespec gap = { 0, 20000 };
+	Msg m = { 0 };
+
+	m.Code = code;
+	atomic_store(&cb->Done, 0);
+	m.TimeNs = NowNs();
+	MsgQueueSend(cb->Cmd, &m);
+	while(!atomic_load(&cb->Done))
+		nanosleep(&gap, NULL);
+}
+
+static int BenchCountdown(void)
+{
+	CountdownBench cb;
+	pthread_t reactor;
+	struct timespec wait;
+	uint64_t stepns = 2000000;
+	int i, quiet, saved, failed = 0;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.Cmd = aligned_alloc(64, sizeof(MsgQueue));
+	cb.Samples = calloc(COUNTDOWN_RUNS, sizeof(uint64_t));
+	MsgQueueInit(cb.Cmd, ReactorEventFd());
+	cb.P.Number = 1;
+	cb.P.Pins.Input = 4;
+	cb.P.Pins.Led = PIN_NONE;
+	cb.P.Pins.Enable = 5;
+
+	GPIOSelectBackend("sim");
+	GPIOInit();
+	ReactorInit(&cb.R);
+	CountdownInit(&cb.Engine, stepns, NULL, NULL);
+	ReactorAdd(&cb.R, cb.Engine.TimerFd, CountdownOnTimer, &cb.Engine);
+	ReactorAdd(&cb.R, cb.Cmd->WakeFd, CountdownBenchCmd, &cb);
+
+	/* the engine chats about every step; keep it out of the results */
+	fflush(stdout);
+	saved = dup(1);
+	quiet = open("/dev/null", O_WRONLY);
+	dup2(quiet, 1);
+
+	pthread_create(&reactor, NULL, CountdownBenchReactor, &cb);
+	for(i = 0; i < COUNTDOWN_RUNS; i++)
+	{
+		CountdownBenchSend(&cb, COUNTDOWN_START);
+
+		/* somewhere in the countdown, now and then after it has run out */
+		wait.tv_sec = 0;
+		wait.tv_nsec = (long)(NowNs() % (stepns * (COUNTDOWN_SECONDS + 1)));
+		nanosleep(&wait, NULL);
+
+		CountdownBenchSend(&cb, COUNTDOWN_STOP);
+	}
+	CountdownBenchSend(&cb, 0);
+	pthread_join(reactor, NULL);
+
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+	close(quiet);
+
+	printf("countdown: %d countdowns, %llu cancelled, %llu ran out, worst step %llu ns late\n", COUNTDOWN_RUNS,
+		(unsigned long long)cb.Engine.Cancelled, (unsigned long long)cb.Engine.Finished, (unsigned long long)cb.Engine.LateMaxNs);
+	PrintPercentiles("countdown: cancel request to lights off", cb.Samples, cb.Cancels);
+
+	if(cb.Engine.Cancelled + cb.Engine.Finished != COUNTDOWN_RUNS)
+		failed = 1;
+	qsort(cb.Samples, cb.Cancels, sizeof(uint64_t), CompareU64);
+	if(cb.Cancels > 0 && cb.Samples[cb.Cancels * 99 / 100] > 1000000)
+	{
+		printf("countdown: p99 cancel latency is over 1 ms\n");
+		failed = 1;
+	}
+
+	CountdownClose(&cb.Engine);
+	ReactorClose(&cb.R);
+	GPIOClose();
+	free(cb.Samples);
+	free(cb.Cmd);
+	return failed;
+}
+
+/* ---- latency: probe cost and histogram accuracy ----
+   Records a spread of known values and checks each percentile the
+   histogram reports is within one bucket (1/16) above the exact one,
+   then times LatHistRecord() itself. */
+
+static int BenchLatency(void)
+{
+	static LatHist h;
+	static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+	uint64_t *exact = calloc(LATENCY_SAMPLES, sizeof(uint64_t));
+	uint64_t t0, ns, got, want;
+	uint32_t rng = 0x1234567;
+	size_t i;
+	int failed = 0;
+
+	LatHistReset(&h);
+	for(i = 0; i < LATENCY_SAMPLES; i++)
+	{
+		/* mostly tens of microseconds with a long tail, like the real thing */
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		exact[i] = 5000 + rng % 50000 + ((rng & 0xff) == 0 ? (rng >> 8) % 5000000 : 0);
+		LatHistRecord(&h, exact[i]);
+	}
+	qsort(exact, LATENCY_SAMPLES, sizeof(uint64_t), CompareU64);
+
+	for(i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+	{
+		want = exact[(size_t)(LATENCY_SAMPLES * pcts[i] / 100.0 + 0.5) - 1];
+		got = LatHistPercentile(&h, pcts[i]);
+		printf("latency: p%g exact %llu ns, histogram %llu ns\n", pcts[i], (unsigned long long)want, (unsigned long long)got);
+		if(got < want || got > want + want / LAT_SUB + 1)
+			failed = 1;
+	}
+
+	LatHistReset(&h);
+	t0 = NowNs();
+	for(i = 0; i < LATENCY_SAMPLES; i++)
+		LatHistRecord(&h, exact[i]);
+	ns = NowNs() - t0;
+	printf("latency: LatHistRecord() %.1f ns per sample\n", (double)ns / LATENCY_SAMPLES);
+
+	free(exact);
+	return failed;
+}
+
+/* ---- trace: event recorder cost and multi-writer integrity ----
+   Four threads hammer one small ring at once, then every slot is
+   checked to hold a complete record from the last lap. Every field of
+   a record comes from one number, so one put together from two
+   writers' fields shows. Then again on a ring of 16, lapped all the
+   time, where a slot may go without but what's published must be
+   whole. */
+
+typedef struct TraceBenchArg {
+	int Id;
+	uint64_t Ns;
+} TraceBenchArg;
+
+static void *TraceBenchWriter(void *arg)
+{
+	TraceBenchArg *ta = (TraceBenchArg *)arg;
+	uint64_t t0 = NowNs();
+	int i;
+
+	for(i = 0; i < TRACE_WRITES; i++)
+		TraceLogAt(((uint64_t)ta->Id << 32) | i, TRACE_NOTE, ta->Id, 0xff, i, ((uint64_t)ta->Id << 32) | i);
+	ta->Ns = NowNs() - t0;
+
+	return NULL;
+}
+
+static int TraceBenchRing(uint64_t records)
+{
+	char path[] = "/tmp/jeopardy-bench-trace-XXXXXX";
+	TraceBenchArg args[TRACE_WRITERS];
+	pthread_t threads[TRACE_WRITERS];
+	TraceHeader *h;
+	TraceRecord *r;
+	uint64_t head, seq, cur, bad = 0, skipped = 0, ns = 0;
+	int i, fd, failed = 0;
+
+	fd = mkstemp(path);
+	if(fd == -1)
+		return 1;
+	close(fd);
+	unlink(path);		// or TraceOpen() keeps it as .prev
+	if(TraceOpen(path, records) != 0)
+		return 1;
+
+	for(i = 0; i < TRACE_WRITERS; i++)
+	{
+		args[i].Id = i + 1;
+		pthread_create(&threads[i], NULL, TraceBenchWriter, &args[i]);
+	}
+	for(i = 0; i < TRACE_WRITERS; i++)
+	{
+		pthread_join(threads[i], NULL);
+		ns += args[i].Ns;
+	}
+
+	h = TraceActive->Header;
+	head = atomic_load(&h->Head);
+	for(seq = head - TraceActive->Capacity; seq < head; seq++)
+	{
+		r = &TraceActive->Records[seq % TraceActive->Capacity];
+		cur = atomic_load(&r->Seq);
+		if(cur != seq + 1)
+			skipped++;
+		if(!(cur & TRACE_SEQ_BUSY) && (r->Type != TRACE_NOTE || r->TimeNs != r->Arg
+			|| (r->Arg >> 32) != r->Player || (uint32_t)r->Arg != r->Value))
+			bad++;
+	}
+
+	printf("trace: %d writers x %d records, ring of %llu: %llu written, %llu torn and %llu not from the last lap; %.1f ns per record per writer\n",
+		TRACE_WRITERS, TRACE_WRITES, (unsigned long long)records, (unsigned long long)head, (unsigned long long)bad,
+		(unsigned long long)skipped, (double)ns / TRACE_WRITERS / TRACE_WRITES);
+	if(head != 1ull + TRACE_WRITERS * TRACE_WRITES || bad != 0 || (records >= 4096 && skipped != 0))
+		failed = 1;
+
+	TraceClose();
+	unlink(path);
+	return failed;
+}
+
+/* A writer preempted in the middle of slot 0, then lapped: the one
+   that comes round must leave the slot alone, not fill it in as well */
+static int TraceBenchLapped(void)
+{
+	char path[] = "/tmp/jeopardy-bench-trace-XXXXXX";
+	TraceRecord *r;
+	int fd, failed;
+
+	fd = mkstemp(path);
+	if(fd == -1)
+		return 1;
+	close(fd);
+	unlink(path);
+	if(TraceOpen(path, 16) != 0)
+		return 1;
+
+	r = &TraceActive->Records[0];
+	atomic_store(&r->Seq, TRACE_SEQ_BUSY | 17);		// claimed for seq 16...
+	r->Arg = 16;						// ...and half filled in
+	atomic_store(&TraceActive->Header->Head, 32);
+	TraceLogAt(32, TRACE_NOTE, 1, 0xff, 32, 32);		// seq 32, slot 0 again
+
+	failed = atomic_load(&r->Seq) != (TRACE_SEQ_BUSY | 17) || r->Arg != 16;
+	printf("trace: lapped a writer still filling its slot: %s\n", failed ? "took the slot over" : "left it alone");
+
+	atomic_store(&r->Seq, 17);
+	TraceClose();
+	unlink(path);
+	return failed;
+}
+
+static int BenchTrace(void)
+{
+	return TraceBenchRing(4096) | TraceBenchRing(16) | TraceBenchLapped();
+}
+
+/* ---- lightbar: one countdown frame, pin by pin against one mask write ----
+   LightbarOld() is ShowCountdown()'s lights as they were, a
+   GPIOWrite() per pin. Times both over the simulated board, counts
+   the writes each needs per frame (on a Pi, one register write each),
+   and from the sim's output log how far apart the first and last
+   light of a frame change. */
+
+static int LightbarOldWrites;
+
+static void LightbarOldWrite(uint8_t pin, uint8_t on)
+{
+	GPIOWrite(pin, on);
+	LightbarOldWrites++;
+}
+
+static void LightbarOld(const Player *p, int second)
+{
+	if(second == 5)
+		LightbarOldWrite(LOCKOUT_ASSERT, HIGH);
+	LightbarOldWrite(p->Pins.Enable, HIGH);
+
+	switch(second)
+	{
+		case 5:
+			LightbarOldWrite(TIME_1, HIGH);
+			LightbarOldWrite(TIME_2, HIGH);
+			LightbarOldWrite(TIME_3, HIGH);
+			LightbarOldWrite(TIME_4, HIGH);
+			LightbarOldWrite(TIME_5, HIGH);
+			break;
+		case 4:
+			LightbarOldWrite(TIME_5, LOW);
+			break;
+		case 3:
+			LightbarOldWrite(TIME_4, LOW);
+			break;
+		case 2:
+			LightbarOldWrite(TIME_3, LOW);
+			break;
+		case 1:
+			LightbarOldWrite(TIME_2, LOW);
+			break;
+		case 0:
+			LightbarOldWrite(TIME_1, LOW);
+			LightbarOldWrite(TIME_4, LOW);
+			LightbarOldWrite(TIME_3, LOW);
+			LightbarOldWrite(TIME_2, LOW);
+			LightbarOldWrite(TIME_5, LOW);
+			break;
+	}
+}
+
+static int LightbarNewWrites;
+
+static void LightbarNew(const Player *p, int second)
+{
+	uint32_t set, clr;
+
+	set = LightbarFrame(p, second, &clr);
+	GPIOWriteMask(set, clr);
+	LightbarNewWrites += (set != 0) + (clr != 0);
+}
+
+/* Worst spread between the first and last change within one frame */
+static uint64_t LightbarRipple(void (*frame)(const Player *, int), const Player *p)
+{
+	const SimEvent *log;
+	size_t from, to, i;
+	uint64_t worst = 0;
+	int second;
+
+	SimReset();
+	for(second = 5; second >= 0; second--)
+	{
+		from = SimOutputLog(&log);
+		frame(p, second);
+		to = SimOutputLog(&log);
+		for(i = from + 1; i < to; i++)
+			if(log[i].TimeNs - log[from].TimeNs > worst)
+				worst = log[i].TimeNs - log[from].TimeNs;
+	}
+
+	return worst;
+}
+
+static int BenchLightbar(void)
+{
+	static Player p;
+	uint64_t t0, oldns, newns, oldripple, newripple;
+	uint32_t set, clr;
+	int i, second, failed = 0;
+
+	p.Number = 1;
+	p.Pins.Enable = P1_ENABLE;
+	GPIOSelectBackend("sim");
+	GPIOInit();
+
+	/* same lights either way at every step */
+	SimReset();
+	for(second = 5; second >= 0; second--)
+	{
+		LightbarOld(&p, second);
+		set = LightbarFrame(&p, second, &clr);
+		if((set & clr) != 0 || (clr & GPIOBit(P1_ENABLE)) != 0)
+			failed = 1;
+		for(i = 0; i < 32; i++)
+			if(((set | clr) >> i) & 1)
+				if(GPIOLev(i) != ((set >> i) & 1))
+					failed = 1;
+	}
+
+	LightbarOldWrites = 0;
+	t0 = NowNs();
+	for(i = 0; i < LIGHTBAR_COUNTDOWNS; i++)
+		for(second = 5; second >= 0; second--)
+			LightbarOld(&p, second);
+	oldns = NowNs() - t0;
+
+	LightbarNewWrites = 0;
+	t0 = NowNs();
+	for(i = 0; i < LIGHTBAR_COUNTDOWNS; i++)
+		for(second = 5; second >= 0; second--)
+			LightbarNew(&p, second);
+	newns = NowNs() - t0;
+
+	oldripple = LightbarRipple(LightbarOld, &p);
+	newripple = LightbarRipple(LightbarNew, &p);
+
+	printf("lightbar: per pin:  %.1f ns per frame, %.2f writes per frame, lights up to %llu ns apart\n",
+		(double)oldns / (LIGHTBAR_COUNTDOWNS * 6), (double)LightbarOldWrites / (LIGHTBAR_COUNTDOWNS * 6),
+		(unsigned long long)oldripple);
+	printf("lightbar: one mask: %.1f ns per frame, %.2f writes per frame, lights up to %llu ns apart\n",
+		(double)newns / (LIGHTBAR_COUNTDOWNS * 6), (double)LightbarNewWrites / (LIGHTBAR_COUNTDOWNS * 6),
+		(unsigned long long)newripple);
+	if(newripple != 0)
+		failed = 1;
+
+	GPIOClose();
+	return failed;
+}
+
+/* ---- debounce: the bit-parallel filter against a counter per pin ----
+   Feeds random bouncy levels on every pin through DebounceFilter() and
+   through the obvious per-pin counter, each pin with its own settle
+   time, and checks they agree on every sample and on the bounce count.
+   Then times both for 1 to 32 inputs: the per-pin loop grows with the
+   inputs, the vertical counters don't. */
+
+#define DEBOUNCE_BENCH_SAMPLES	1000000
+
+typedef struct DebounceRef {
+	uint32_t Stable;
+	int Run[32];
+	int Settle[32];
+	uint64_t Bounces;
+} DebounceRef;
+
+static uint32_t DebounceRefFilter(DebounceRef *r, uint32_t raw, int pins)
+{
+	int i;
+
+	for(i = 0; i < pins; i++)
+	{
+		if(((raw ^ r->Stable) >> i) & 1)
+		{
+			if(++r->Run[i] >= r->Settle[i])
+			{
+				r->Stable ^= 1u << i;
+				r->Run[i] = 0;
+			}
+		}
+		else
+		{
+			if(r->Run[i] > 0)
+				r->Bounces++;
+			r->Run[i] = 0;
+		}
+	}
+
+	return r->Stable;
+}
+
+/* Every pin sits at a level for a while, then bounces for a few
+   samples on its way to the other one */
+static uint32_t DebounceBenchRaw(uint32_t *level, int pins)
+{
+	uint32_t r = FramesRand(), mask = pins == 32 ? ~0u : (1u << pins) - 1;
+	uint32_t noise;
+
+	if((r & 63) == 0)
+		*level ^= FramesRand() & mask;
+	noise = (r & 0x300) ? 0 : FramesRand() & FramesRand() & mask;
+
+	return *level ^ noise;
+}
+
+static int BenchDebounce(void)
+{
+	static uint32_t raw[DEBOUNCE_BENCH_SAMPLES];
+	static Debounce d;
+	static DebounceRef ref;
+	static const int counts[] = { 1, 4, 8, 16, 32 };
+	uint32_t level, sink = 0;
+	uint64_t t0, bitns, pinns;
+	int i, c, pins, failed = 0;
+
+	DebounceInit(&d, 0);
+	memset(&ref, 0, sizeof(ref));
+	for(i = 0; i < 32; i++)
+	{
+		ref.Settle[i] = 1 + (FramesRand() % DEBOUNCE_MAX_SAMPLES);
+		DebounceSetPin(&d, i, ref.Settle[i]);
+		if(DebounceGetPin(&d, i) != ref.Settle[i])
+			failed = 1;
+	}
+
+	level = 0;
+	for(i = 0; i < DEBOUNCE_BENCH_SAMPLES; i++)
+	{
+		raw[i] = DebounceBenchRaw(&level, 32);
+		if(DebounceFilter(&d, raw[i]) != DebounceRefFilter(&ref, raw[i], 32))
+			failed = 1;
+	}
+	printf("debounce: %d samples of 32 bouncy inputs, settle 1-%d samples: %llu bounces, %s\n",
+		DEBOUNCE_BENCH_SAMPLES, DEBOUNCE_MAX_SAMPLES, (unsigned long long)d.Bounces,
+		failed || d.Bounces != ref.Bounces ? "DIFFERENT from the per-pin counters" : "same as the per-pin counters");
+	if(d.Bounces != ref.Bounces)
+		failed = 1;
+
+	for(c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+	{
+		pins = counts[c];
+		level = 0;
+		for(i = 0; i < DEBOUNCE_BENCH_SAMPLES; i++)
+			raw[i] = DebounceBenchRaw(&level, pins);
+
+		DebounceInit(&d, 0);
+		for(i = 0; i < pins; i++)
+			DebounceSetPin(&d, i, 5);
+		t0 = NowNs();
+		for(i = 0; i < DEBOUNCE_BENCH_SAMPLES; i++)
+			sink += DebounceFilter(&d, raw[i]);
+		bitns = NowNs() - t0;
+
+		memset(&ref, 0, sizeof(ref));
+		for(i = 0; i < pins; i++)
+			ref.Settle[i] = 5;
+		t0 = NowNs();
+		for(i = 0; i < DEBOUNCE_BENCH_SAMPLES; i++)
+			sink -= DebounceRefFilter(&ref, raw[i], pins);
+		pinns = NowNs() - t0;
+
+		printf("debounce: %2d inputs: bit-parallel %5.1f ns per sample, per pin %5.1f ns per sample\n",
+			pins, (double)bitns / DEBOUNCE_BENCH_SAMPLES, (double)pinns / DEBOUNCE_BENCH_SAMPLES);
+	}
+	/* both filters saw the same samples, so they must have ended up level */
+	if(sink != 0)
+		failed = 1;
+
+	return failed;
+}
+
+/* ---- wakeup: scanner-style periodic wake-ups under load, default vs -R ----
+   A thread sleeps to a fixed 100 us schedule the way ScannerThread()
+   does, while a couple of threads spin at normal priority, and records
+   how late each wake-up is. Then again in real-time mode. */
+
+static atomic_bool WakeupStop;
+
+static void *WakeupSampler(void *arg)
+{
+	LatHist *h = (LatHist *)arg;
+	uint64_t next = NowNs();
+	int i;
+
+	for(i = 0; i < WAKEUP_SAMPLES; i++)
+	{
+		next += WAKEUP_PERIOD_NS;
+		ClockSleepUntil(next);
+		LatHistRecord(h, NowNs() - next);
+	}
+
+	return NULL;
+}
+
+static void *WakeupLoad(void *arg)
+{
+	volatile uint64_t spin = 0;
+
+	(void)arg;
+	while(!atomic_load_explicit(&WakeupStop, memory_order_relaxed))
+		spin++;
+
+	return NULL;
+}
+
+static int WakeupRun(const char *mode, LatHist *h)
+{
+	pthread_t load[WAKEUP_LOAD], sampler;
+	int i, failed = 0;
+
+	LatHistReset(h);
+	atomic_store(&WakeupStop, false);
+	for(i = 0; i < WAKEUP_LOAD; i++)
+		pthread_create(&load[i], NULL, WakeupLoad, NULL);
+
+	if(RtThreadCreate(&sampler, RT_SCANNER, WakeupSampler, h) != 0)
+		failed = 1;
+	else
+		pthread_join(sampler, NULL);
+
+	atomic_store(&WakeupStop, true);
+	for(i = 0; i < WAKEUP_LOAD; i++)
+		pthread_join(load[i], NULL);
+
+	printf("wakeup: %-8s n=%llu p50 %.1f p99 %.1f p99.9 %.1f max %.1f us late\n", mode,
+		(unsigned long long)atomic_load(&h->Count),
+		LatHistPercentile(h, 50.0) / 1000.0, LatHistPercentile(h, 99.0) / 1000.0,
+		LatHistPercentile(h, 99.9) / 1000.0, atomic_load(&h->MaxNs) / 1000.0);
+
+	return failed;
+}
+
+static int BenchWakeup(void)
+{
+	static LatHist def, rt;
+	int failed;
+
+	failed = WakeupRun("default", &def);
+
+	RtMode = true;
+	RtSetup();
+	failed |= WakeupRun("-R", &rt);
+	munlockall();
+	RtMode = false;
+
+	if(atomic_load(&rt.MaxNs) > 0)
+		printf("wakeup: -R cuts the worst wake-up %.1fx and p99.9 %.1fx\n",
+			(double)atomic_load(&def.MaxNs) / atomic_load(&rt.MaxNs),
+			(double)LatHistPercentile(&def, 99.9) / LatHistPercentile(&rt, 99.9));
+
+	return failed;
+}
+
+/* ---- cancel: operator interrupt to a sleeping wait awake ----
+   A thread sleeps up to a second at a time in CancelSleepUntil() while
+   we raise the interrupt at a random point, and times how long it
+   takes to wake. Then the way InterruptDelay() used to do it, sleeping
+   10 ms and looking, for comparison. */
+
+typedef struct CancelBench {
+	Cancel Source;
+	CancelWait Wait;
+	bool Polled;
+	int Runs;
+	atomic_int Armed;			// run the waiter is about to sleep for
+	atomic_int Done;			// ...and has woken from
+	int Missed;				// slept the whole second
+	uint64_t *Lat;
+} CancelBench;
+
+static void *CancelBenchWaiter(void *arg)
+{
+	CancelBench *cb = (CancelBench *)arg;
+	uint64_t next, until;
+	uint32_t raised;
+	int i;
+
+	for(i = 0; i < cb->Runs; i++)
+	{
+		atomic_store(&cb->Armed, i + 1);
+		until = NowNs() + 1000000000ull;
+		if(cb->Polled)
+		{
+			next = NowNs();
+			while((raised = atomic_load(&cb->Source.Raised)) == cb->Wait.Seen && next < until)
+			{
+				next += CANCEL_POLL_NS;
+				ClockSleepUntil(next);
+			}
+			if(raised == cb->Wait.Seen)
+				cb->Missed++;
+			cb->Wait.Seen = raised;
+		}
+		else if(!CancelSleepUntil(&cb->Wait, until))
+			cb->Missed++;
+
+		cb->Lat[i] = NowNs() - atomic_load(&cb->Source.RaisedNs);
+		atomic_store(&cb->Done, i + 1);
+	}
+
+	return NULL;
+}
+
+static int CancelBenchRun(const char *what, bool polled, int runs, uint64_t *worst)
+{
+	CancelBench cb;
+	struct timespec ts;
+	pthread_t t;
+	uint32_t rng = 0x2545f491;
+	char label[64];
+	int i;
+
+	memset(&cb, 0, sizeof(cb));
+	CancelInit(&cb.Source);
+	if(CancelWaitInit(&cb.Wait, &cb.Source) != 0)
+		return 1;
+	cb.Polled = polled;
+	cb.Runs = runs;
+	cb.Lat = calloc(runs, sizeof(uint64_t));
+	pthread_create(&t, NULL, CancelBenchWaiter, &cb);
+
+	for(i = 0; i < runs; i++)
+	{
+		while(atomic_load(&cb.Armed) != i + 1)
+			sched_yield();
+
+		/* somewhere in the first 2 ms of its sleep */
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		ts.tv_sec = 0;
+		ts.tv_nsec = 100000 + rng % 1900000;
+		nanosleep(&ts, NULL);
+		CancelRaise(&cb.Source, NowNs());
+
+		while(atomic_load(&cb.Done) != i + 1)
+			sched_yield();
+	}
+	pthread_join(t, NULL);
+
+	snprintf(label, sizeof(label), "cancel: %s", what);
+	PrintPercentiles(label, cb.Lat, runs);
+	*worst = cb.Lat[runs - 1];
+	if(cb.Missed)
+		printf("cancel: %s: %d waits slept through the interrupt\n", what, cb.Missed);
+
+	free(cb.Lat);
+	close(cb.Wait.WakeFd);
+	close(cb.Wait.TimerFd);
+	return cb.Missed != 0;
+}
+
+static int BenchCancel(void)
+{
+	uint64_t event, polled;
+	int failed;
+
+	failed = CancelBenchRun("eventfd wake", false, CANCEL_RUNS, &event);
+	failed |= CancelBenchRun("10 ms polling", true, CANCEL_POLLED_RUNS, &polled);
+	if(event > 0)
+		printf("cancel: worst case %.1f us woken against %.1f us polled\n", event / 1000.0, polled / 1000.0);
+
+	return failed;
+}
+
+/* ---- log: a ring-in line, printf() against LogPrintf() ----
+   The console is a pipe read LOG_CONSOLE_BYTES a ms, a slow SSH
+   session or serial console. A line-buffered FILE on it, which is
+   what printf() was, blocks once the pipe fills; LogPrintf() hands the
+   line to the logger thread and doesn't. Times each call, and counts
+   the lines that reach the console so none go missing uncounted. */
+
+typedef struct LogConsole {
+	int Fd;
+	uint64_t Lines;				// ring-in lines seen
+} LogConsole;
+
+static void *LogConsoleReader(void *arg)
+{
+	LogConsole *lc = (LogConsole *)arg;
+	struct timespec ts = { 0, 1000000 };
+	char buf[LOG_CONSOLE_BYTES], line[160];
+	size_t len = 0;
+	ssize_t got, i;
+
+	while((got = read(lc->Fd, buf, sizeof(buf))) > 0)
+	{
+		for(i = 0; i < got; i++)
+		{
+			if(buf[i] != '\n')
+			{
+				if(len < sizeof(line) - 1)
+					line[len++] = buf[i];
+				continue;
+			}
+			line[len] = '\0';
+			if(strstr(line, " rang in at ") != NULL)
+				lc->Lines++;
+			len = 0;
+		}
+		nanosleep(&ts, NULL);
+	}
+
+	return NULL;
+}
+
+static int LogBenchRun(const char *what, bool logger, uint64_t *lat, uint64_t *seen, uint64_t *dropped)
+{
+	LogConsole lc;
+	pthread_t t;
+	FILE *console;
+	uint64_t start, next, limited;
+	int fds[2], i;
+
+	if(pipe(fds) != 0)
+		return 1;
+	lc.Fd = fds[0];
+	lc.Lines = 0;
+	console = fdopen(fds[1], "w");
+	setvbuf(console, NULL, _IOLBF, 0);
+	pthread_create(&t, NULL, LogConsoleReader, &lc);
+
+	if(logger)
+		LogStart(console, LOG_INFO, 0);
+
+	next = NowNs();
+	for(i = 0; i < LOG_LINES; i++)
+	{
+		next += LOG_GAP_NS;
+		ClockSleepUntil(next);
+		start = NowNs();
+		if(logger)
+			LogPrintf(LOG_INFO, "PlayerThread(): P%d rang in at %llu.%06llu\n", i % 4 + 1,
+				(unsigned long long)(start / 1000000000ull), (unsigned long long)(start % 1000000000ull / 1000));
+		else
+			fprintf(console, "PlayerThread(): P%d rang in at %llu.%06llu\n", i % 4 + 1,
+				(unsigned long long)(start / 1000000000ull), (unsigned long long)(start % 1000000000ull / 1000));
+		lat[i] = NowNs() - start;
+	}
+
+	if(logger)
+		LogStop();
+	fclose(console);
+	pthread_join(t, NULL);
+	close(fds[0]);
+
+	*dropped = 0;
+	if(logger)
+		LogLost(dropped, &limited);
+	*seen = lc.Lines;
+
+	PrintPercentiles(what, lat, LOG_LINES);
+	return 0;
+}
+
+static int BenchLog(void)
+{
+	uint64_t *lat = calloc(LOG_LINES, sizeof(uint64_t));
+	uint64_t seen, dropped, printfmax, logp50;
+	int failed;
+
+	failed = LogBenchRun("log: printf() to a slow console", false, lat, &seen, &dropped);
+	printfmax = lat[LOG_LINES - 1];
+	failed |= LogBenchRun("log: LogPrintf()", true, lat, &seen, &dropped);
+	logp50 = lat[LOG_LINES / 2];
+
+	printf("log: %llu lines reached the console, %llu dropped with the ring full; worst call %.1f us blocked against %.1f us\n",
+		(unsigned long long)seen, (unsigned long long)dropped,
+		printfmax / 1000.0, lat[LOG_LINES - 1] / 1000.0);
+
+	/* every line is either written or counted, and a ring-in line
+	   costs no more than formatting it */
+	if(seen + dropped != LOG_LINES || logp50 > 20000)
+		failed = 1;
+
+	free(lat);
+	return failed;
+}
+
+/* ---- serial: MCP bytes in through a pty, poll() and the receive ring ----
+   The MCP's end is a pty master; frames go in split at random points,
+   as a UART hands them over, a frame every SERIAL_GAP_NS. A reader
+   does what SerialThread() does, poll() then SerRingRead() and
+   SerRingParse(), and times each frame from its last byte written to
+   parsed. Then both it and the old loop, read() on a non-blocking fd
+   over and over, sit idle and we see how much CPU each burns. */
+
+typedef struct SerialBench {
+	int Fd;					// pty slave, our /dev/ttyS0
+	int StopFd;
+	_Atomic uint64_t SentNs[SERIAL_FRAMES];
+	uint64_t Lat[SERIAL_FRAMES];
+	int Got;
+	SerRing Rx;
+	FrameParser Parser;
+} SerialBench;
+
+static void *SerialBenchReader(void *arg)
+{
+	SerialBench *sb = (SerialBench *)arg;
+	struct pollfd wait[2] = { { sb->Fd, POLLIN, 0 }, { sb->StopFd, POLLIN, 0 } };
+	uint64_t arrived;
+	Frame f;
+
+	while(1)
+	{
+		if(poll(wait, 2, -1) < 0)
+			continue;
+		if(wait[1].revents & POLLIN)
+			return NULL;
+		if(SerRingRead(&sb->Rx, sb->Fd, NowNs()) < 0)
+			return NULL;
+		while(SerRingParse(&sb->Rx, &sb->Parser, &f, &arrived))
+		{
+			if(f.Seq < SERIAL_FRAMES && sb->Got < SERIAL_FRAMES)
+				sb->Lat[sb->Got++] = NowNs() - atomic_load(&sb->SentNs[f.Seq]);
+		}
+	}
+}
+
+static void *SerialBenchSpinner(void *arg)
+{
+	SerialBench *sb = (SerialBench *)arg;
+	uint8_t buf[255];
+	uint64_t stop;
+
+	/* SerialThread() as it was */
+	while(1)
+	{
+		if(read(sb->Fd, buf, sizeof(buf)) <= 0 && read(sb->StopFd, &stop, sizeof(stop)) == sizeof(stop))
+			return NULL;
+	}
+}
+
+/* How much of a core t burns over SERIAL_IDLE_NS with nothing coming in */
+static double SerialBenchIdle(pthread_t t)
+{
+	clockid_t cpu;
+	struct timespec a, b, ts = { 0, SERIAL_IDLE_NS };
+
+	pthread_getcpuclockid(t, &cpu);
+	clock_gettime(cpu, &a);
+	nanosleep(&ts, NULL);
+	clock_gettime(cpu, &b);
+
+	return ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / SERIAL_IDLE_NS;
+}
+
+static int SerialBenchOpen(int *master, int *slave)
+{
+	struct termios tio;
+
+	*master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(*master < 0 || grantpt(*master) != 0 || unlockpt(*master) != 0)
+		return -1;
+	*slave = open(ptsname(*master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(*slave < 0)
+		return -1;
+
+	/* bytes through untouched, as on the UART */
+	tcgetattr(*slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(*slave, TCSANOW, &tio);
+	return 0;
+}
+
+static int BenchSerial(void)
+{
+	SerialBench *sb = calloc(1, sizeof(SerialBench));
+	uint8_t frame[FRAME_MAX], player;
+	uint64_t next;
+	uint32_t rng = 0x9e3779b9;
+	size_t size, at, chunk;
+	double polled, spun;
+	pthread_t t;
+	int master, i, failed = 0;
+
+	if(sb == NULL || SerialBenchOpen(&master, &sb->Fd) != 0)
+	{
+		printf("serial: can't open a pty\n");
+		return 1;
+	}
+	sb->StopFd = ReactorEventFd();
+	SerRingInit(&sb->Rx);
+	FrameParserInit(&sb->Parser);
+	pthread_create(&t, NULL, SerialBenchReader, sb);
+
+	next = NowNs();
+	for(i = 0; i < SERIAL_FRAMES; i++)
+	{
+		player = i % 3 + 1;
+		size = FrameEncode(frame, FRAME_COUNTDOWN_END, i, (uint32_t)(NowNs() / 1000), &player, 1);
+
+		next += SERIAL_GAP_NS;
+		ClockSleepUntil(next);
+		for(at = 0; at < size; at += chunk)
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 17;
+			rng ^= rng << 5;
+			chunk = 1 + rng % (size - at);
+			if(at + chunk == size)
+				atomic_store(&sb->SentNs[i], NowNs());
+			(void)!write(master, frame + at, chunk);
+		}
+	}
+
+	/* let the last frames through, then nothing */
+	next += 10 * SERIAL_GAP_NS;
+	ClockSleepUntil(next);
+	polled = SerialBenchIdle(t);
+	ReactorPoke(sb->StopFd);
+	pthread_join(t, NULL);
+	ReactorDrain(sb->StopFd);
+
+	PrintPercentiles("serial: last byte written -> frame parsed", sb->Lat, sb->Got);
+	printf("serial: %d of %d frames, %lu bad CRC, %lu bytes skipped, %lu bytes in %lu reads\n",
+		sb->Got, SERIAL_FRAMES, sb->Parser.BadCrc, sb->Parser.Skipped, sb->Rx.Bytes, sb->Rx.Reads);
+	if(sb->Got != SERIAL_FRAMES || sb->Parser.BadCrc != 0 || sb->Parser.Skipped != 0)
+		failed = 1;
+
+	pthread_create(&t, NULL, SerialBenchSpinner, sb);
+	spun = SerialBenchIdle(t);
+	ReactorPoke(sb->StopFd);
+	pthread_join(t, NULL);
+
+	printf("serial: idle, poll() uses %.2f%% of a core, the old read() spin %.2f%%\n", polled * 100.0, spun * 100.0);
+	if(polled > 0.01)
+		failed = 1;
+
+	close(master);
+	close(sb->Fd);
+	close(sb->StopFd);
+	free(sb);
+	return failed;
+}
+
+/* ---- reconnect: the MCP's serial device going away and coming back ----
+   A pty stands in for a USB serial adapter: its slave is put in place
+   under a name of our own, the way udev makes /dev/ttyUSB0, and the
+   link is left to find it. We time the device appearing to the MCP
+   end hearing "SReady" from us, and the master closing to the link
+   noticing. Then the same without the inotify watch, only the retry
+   backoff, and how much CPU the link burns waiting. */
+
+typedef struct LinkBench {
+	SerLink Link;
+	int StopFd;
+	_Atomic unsigned long Drops;
+} LinkBench;
+
+static void *LinkBenchThread(void *arg)
+{
+	LinkBench *lb = (LinkBench *)arg;
+	struct pollfd wait[2];
+	uint8_t buf[64];
+	ssize_t got;
+
+	wait[1].fd = lb->StopFd;
+	wait[1].events = POLLIN;
+	while(1)
+	{
+		wait[0].fd = SerLinkPollFd(&lb->Link);
+		wait[0].events = POLLIN;
+		wait[0].revents = 0;
+		if(poll(wait, 2, SerLinkTimeout(&lb->Link)) < 0)
+			continue;
+		if(wait[1].revents & POLLIN)
+			return NULL;
+
+		/* what SerialThread() does, less the frames */
+		if(!SerLinkUp(&lb->Link))
+		{
+			if(SerLinkService(&lb->Link))
+				(void)!write(lb->Link.Fd, "SReady\r\n", 8);
+			continue;
+		}
+		if(!(wait[0].revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+		got = read(lb->Link.Fd, buf, sizeof(buf));
+		if(got == 0 || (got < 0 && errno != EAGAIN))
+		{
+			SerLinkDrop(&lb->Link);
+			atomic_fetch_add(&lb->Drops, 1);
+		}
+	}
+}
+
+/* A new pty slave under path; returns the master */
+static int LinkBenchPlug(const char *path, uint64_t *pluggedns)
+{
+	char tmp[96];
+	int master;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		return -1;
+
+	/* in place all at once, as udev does it */
+	snprintf(tmp, sizeof(tmp), "%s.new", path);
+	unlink(tmp);
+	if(symlink(ptsname(master), tmp) != 0)
+		return -1;
+	*pluggedns = NowNs();
+	rename(tmp, path);
+	return master;
+}
+
+/* Read from the MCP's end until we've said hello */
+static bool LinkBenchHeard(int master)
+{
+	char buf[64];
+	size_t have = 0;
+	ssize_t got;
+
+	while(have < sizeof(buf) - 1 && (got = read(master, buf + have, sizeof(buf) - 1 - have)) > 0)
+	{
+		have += got;
+		buf[have] = '\0';
+		if(strstr(buf, "SReady") != NULL)
+			return true;
+	}
+
+	return false;
+}
+
+static int LinkBenchRun(const char *what, const char *path, bool watch, int cycles, uint64_t awayns, uint64_t *upns, uint64_t *downns)
+{
+	LinkBench lb;
+	pthread_t t;
+	struct timespec ts;
+	uint64_t plugged, pulled;
+	unsigned long drops;
+	char label[96];
+	int master, i, failed = 0;
+
+	SerLinkInit(&lb.Link, path);
+	if(!watch && lb.Link.WatchFd >= 0)
+	{
+		close(lb.Link.WatchFd);
+		lb.Link.WatchFd = -1;
+	}
+	lb.StopFd = ReactorEventFd();
+	atomic_init(&lb.Drops, 0);
+	pthread_create(&t, NULL, LinkBenchThread, &lb);
+
+	for(i = 0; i < cycles; i++)
+	{
+		/* gone for a while first, so the backoff has grown */
+		ts.tv_sec = awayns / 1000000000ull;
+		ts.tv_nsec = awayns % 1000000000ull;
+		nanosleep(&ts, NULL);
+
+		master = LinkBenchPlug(path, &plugged);
+		if(master < 0 || !LinkBenchHeard(master))
+		{
+			failed = 1;
+			break;
+		}
+		upns[i] = NowNs() - plugged;
+
+		/* pulled out */
+		drops = atomic_load(&lb.Drops);
+		unlink(path);
+		pulled = NowNs();
+		close(master);
+		while(atomic_load(&lb.Drops) == drops && NowNs() - pulled < 1000000000ull)
+			sched_yield();
+		if(atomic_load(&lb.Drops) == drops)
+		{
+			failed = 1;
+			break;
+		}
+		downns[i] = NowNs() - pulled;
+	}
+
+	ReactorPoke(lb.StopFd);
+	pthread_join(t, NULL);
+	SerLinkClose(&lb.Link);
+	close(lb.StopFd);
+
+	if(failed)
+	{
+		printf("reconnect: %s: the link didn't come back in cycle %d\n", what, i + 1);
+		return 1;
+	}
+	snprintf(label, sizeof(label), "reconnect: %s: device back -> MCP hears us", what);
+	PrintPercentiles(label, upns, cycles);
+	snprintf(label, sizeof(label), "reconnect: %s: device gone -> link down", what);
+	PrintPercentiles(label, downns, cycles);
+	return 0;
+}
+
+static int BenchReconnect(void)
+{
+	char dir[] = "/tmp/jeopardy-bench-link-XXXXXX", path[64];
+	uint64_t up[RECONNECT_CYCLES], down[RECONNECT_CYCLES];
+	LinkBench lb;
+	pthread_t t;
+	double idle;
+	int failed;
+
+	if(mkdtemp(dir) == NULL)
+		return 1;
+	snprintf(path, sizeof(path), "%s/ttyMCP", dir);
+
+	failed = LinkBenchRun("inotify", path, true, RECONNECT_CYCLES, SERIAL_GAP_NS * 100, up, down);
+	failed |= LinkBenchRun("backoff only", path, false, RECONNECT_BACKOFF_CYCLES, RECONNECT_AWAY_NS, up, down);
+
+	/* nothing there at all */
+	SerLinkInit(&lb.Link, path);
+	lb.StopFd = ReactorEventFd();
+	atomic_init(&lb.Drops, 0);
+	pthread_create(&t, NULL, LinkBenchThread, &lb);
+	idle = SerialBenchIdle(t);
+	ReactorPoke(lb.StopFd);
+	pthread_join(t, NULL);
+	printf("reconnect: waiting for a device that isn't there uses %.2f%% of a core\n", idle * 100.0);
+	SerLinkClose(&lb.Link);
+	close(lb.StopFd);
+	if(idle > 0.01)
+		failed = 1;
+
+	rmdir(dir);
+	return failed;
+}
+
+/* ---- outbound: one wakeup's worth of messages for the MCP ----
+   What SerialThread() might have in hand at once: time-outs from
+   main() (one of them twice), answers to what the MCP just sent, and
+   last of all a ring-in. Sent a write() each in the order they came,
+   as it used to, against the queue: one write() with the ring-in
+   first and the repeat merged. Written through a pty, with a thread
+   draining the other end; what matters on the wire is how many bytes
+   go ahead of the ring-in. */
+
+#define OUTBOUND_WAKEUPS	20000
+
+typedef struct OutboundMsg {
+	uint8_t Type;
+	uint8_t Player;
+} OutboundMsg;
+
+static const OutboundMsg OutboundWakeup[] = {
+	{ FRAME_TIMED_OUT, 1 },
+	{ FRAME_TIMED_OUT, 2 },
+	{ FRAME_PAIR_ACK, 0 },
+	{ FRAME_TIMED_OUT, 2 },
+	{ FRAME_PONG, 0 },
+	{ FRAME_RINGIN, 3 }
+};
+
+#define OUTBOUND_MSGS	(sizeof(OutboundWakeup) / sizeof(OutboundWakeup[0]))
+
+static void *OutboundBenchDrain(void *arg)
+{
+	SerialBench *sb = (SerialBench *)arg;
+	struct pollfd wait[2] = { { sb->Fd, POLLIN, 0 }, { sb->StopFd, POLLIN, 0 } };
+	uint8_t buf[4096];
+
+	while(1)
+	{
+		if(poll(wait, 2, -1) < 0)
+			continue;
+		if(wait[1].revents & POLLIN)
+			return NULL;
+		while(read(sb->Fd, buf, sizeof(buf)) > 0)
+			;
+	}
+}
+
+/* Bytes in buf (n) ahead of the first ring-in frame */
+static size_t OutboundAhead(const uint8_t *buf, size_t n)
+{
+	FrameParser p;
+	const uint8_t *at = buf;
+	size_t left = n;
+	Frame f;
+
+	FrameParserInit(&p);
+	while(FrameParse(&p, &at, &left, &f))
+		if(f.Type == FRAME_RINGIN)
+			return (n - left) - (FRAME_HEADER + f.Len + FRAME_CRC);
+	return n;
+}
+
+/* 0 if SerOutSent() only hands back a ring-in once all of it has gone */
+static int OutboundBackedUp(SerOut *o)
+{
+	uint8_t payload[6] = { 1 }, buf[4096];
+	uint16_t seq = 0;
+	int fds[2], bad = 0;
+	size_t size;
+
+	if(pipe(fds) != 0)
+		return 1;
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	while(write(fds[1], buf, 1) > 0)
+		;
+
+	SerOutInit(o);
+	SerOutPush(o, FRAME_RINGIN, payload, 6, NowNs(), NowNs());
+	SerOutEncode(o, true, &seq, 0);
+	size = o->Have;
+	bad |= SerOutWrite(o, fds[1]) != 0 || SerOutSent(o, NULL, 0) != 0;
+
+	while(read(fds[0], buf, sizeof(buf)) > 0)
+		;
+	bad |= SerOutWrite(o, fds[1]) != (ssize_t)size || SerOutSent(o, NULL, 0) != 1;
+
+	close(fds[0]);
+	close(fds[1]);
+	return bad;
+}
+
+static int BenchOutbound(void)
+{
+	SerialBench *sb = calloc(1, sizeof(SerialBench));
+	SerOut *o = calloc(1, sizeof(SerOut));
+	uint8_t frame[FRAME_MAX], payload[6] = { 0 }, all[OUTBOUND_MSGS * FRAME_MAX];
+	uint64_t start, oldns, newns;
+	unsigned long oldwrites = 0;
+	size_t size, len = 0, oldahead, newahead = 0;
+	uint16_t seq = 0;
+	pthread_t t;
+	int master, i, failed = 0;
+	size_t m;
+
+	if(sb == NULL || o == NULL || SerialBenchOpen(&master, &sb->Fd) != 0)
+	{
+		printf("outbound: can't open a pty\n");
+		return 1;
+	}
+	sb->StopFd = ReactorEventFd();
+	pthread_create(&t, NULL, OutboundBenchDrain, sb);
+
+	/* a write() each, in the order they came */
+	start = NowNs();
+	for(i = 0; i < OUTBOUND_WAKEUPS; i++)
+	{
+		for(m = 0; m < OUTBOUND_MSGS; m++)
+		{
+			payload[0] = OutboundWakeup[m].Player;
+			size = FrameEncode(frame, OutboundWakeup[m].Type, seq++, (uint32_t)(NowNs() / 1000), payload,
+				OutboundWakeup[m].Type == FRAME_RINGIN ? 6 : OutboundWakeup[m].Player ? 1 : 0);
+			if(i == 0)
+			{
+				memcpy(all + len, frame, size);
+				len += size;
+			}
+			while(write(master, frame, size) < 0 && errno == EAGAIN)
+				sched_yield();
+			oldwrites++;
+		}
+	}
+	oldns = NowNs() - start;
+	oldahead = OutboundAhead(all, len);
+
+	/* queued, then one write() */
+	SerOutInit(o);
+	start = NowNs();
+	for(i = 0; i < OUTBOUND_WAKEUPS; i++)
+	{
+		for(m = 0; m < OUTBOUND_MSGS; m++)
+		{
+			payload[0] = OutboundWakeup[m].Player;
+			SerOutPush(o, OutboundWakeup[m].Type, payload,
+				OutboundWakeup[m].Type == FRAME_RINGIN ? 6 : OutboundWakeup[m].Player ? 1 : 0, start, 0);
+		}
+		SerOutEncode(o, true, &seq, (uint32_t)(NowNs() / 1000));
+		if(i == 0)
+			newahead = OutboundAhead(o->Buf, o->Have);
+		while(SerOutPending(o))
+			if(SerOutWrite(o, master) == 0)
+				sched_yield();
+		SerOutSent(o, NULL, 0);
+	}
+	newns = NowNs() - start;
+
+	ReactorPoke(sb->StopFd);
+	pthread_join(t, NULL);
+
+	printf("outbound: a write() each: %.2f writes, %.0f ns a wakeup, %zu bytes ahead of the ring-in (%.1f ms at 9600, %.2f ms at 115200)\n",
+		(double)oldwrites / OUTBOUND_WAKEUPS, (double)oldns / OUTBOUND_WAKEUPS, oldahead, oldahead * 10e3 / 9600, oldahead * 10e3 / 115200);
+	printf("outbound: queued: %.2f writes, %.0f ns a wakeup, %zu bytes ahead of the ring-in, %lu merged, queue %d deep at most\n",
+		(double)o->Writes / OUTBOUND_WAKEUPS, (double)newns / OUTBOUND_WAKEUPS, newahead, o->Merged, o->MaxDepth);
+	if(newahead != 0 || o->Writes > OUTBOUND_WAKEUPS * 11 / 10 || o->Merged != OUTBOUND_WAKEUPS)
+		failed = 1;
+
+	/* a ring-in counts as sent once the port has taken its last byte,
+	   not when it was encoded: into a full pipe, then an empty one */
+	if(OutboundBackedUp(o) != 0)
+	{
+		printf("outbound: a ring-in the port hadn't taken all of was counted as sent\n");
+		failed = 1;
+	}
+
+	close(master);
+	close(sb->Fd);
+	close(sb->StopFd);
+	free(o);
+	free(sb);
+	return failed;
+}
+
+/* ---- arbiter: sixteen player threads racing for one ring-in ----
+   Each round every thread claims at once, let go off a barrier, with a
+   press a few ns after the Enabler (so plenty of them tie) and a tie
+   place. main() then seals the round as GameDecide() would. Checks
+   there is exactly one winner a round, that it's the earliest claim
+   and that it was told it was leading, and that nothing gets in after
+   the seal. The same race under a pthread mutex for comparison. */
+
+#define ARBITER_PLAYERS	16
+#define ARBITER_ROUNDS	5000
+
+typedef struct ArbiterBench {
+	Arbiter Arb;
+	bool Locked;				// the mutex run
+	pthread_mutex_t Lock;
+	uint64_t LockBest;			// the mutex run's best claim, as arbiter key bits
+	pthread_barrier_t Go, Done;
+	uint64_t Press[ARBITER_ROUNDS][ARBITER_PLAYERS];
+	uint8_t Rank[ARBITER_ROUNDS][ARBITER_PLAYERS];
+	bool Leading[ARBITER_ROUNDS][ARBITER_PLAYERS];
+	uint64_t ClaimNs[ARBITER_PLAYERS];
+	uint64_t ClaimMaxNs[ARBITER_PLAYERS];
+} ArbiterBench;
+
+typedef struct ArbiterArg {
+	ArbiterBench *ab;
+	int Index;
+} ArbiterArg;
+
+static uint64_t ArbiterBenchKey(uint64_t press, int rank, int player)
+{
+	return press << ARB_PRESS_SHIFT | (uint64_t)(rank ? rank : ARB_RANK_NONE) << ARB_RANK_SHIFT | (uint64_t)player;
+}
+
+static void *ArbiterBenchPlayer(void *arg)
+{
+	ArbiterArg *aa = (ArbiterArg *)arg;
+	ArbiterBench *ab = aa->ab;
+	int i = aa->Index, r;
+	uint64_t t0, ns, key;
+	bool lead;
+
+	for(r = 0; r < ARBITER_ROUNDS; r++)
+	{
+		pthread_barrier_wait(&ab->Go);
+		t0 = NowNs();
+		if(ab->Locked)
+		{
+			key = ArbiterBenchKey(ab->Press[r][i], ab->Rank[r][i], i + 1);
+			pthread_mutex_lock(&ab->Lock);
+			lead = key < ab->LockBest;
+			if(lead)
+				ab->LockBest = key;
+			pthread_mutex_unlock(&ab->Lock);
+		}
+		else
+			lead = ArbiterClaim(&ab->Arb, r + 1, ab->Press[r][i], ab->Rank[r][i], i + 1) == ARB_LEADING;
+		ns = NowNs() - t0;
+
+		ab->Leading[r][i] = lead;
+		ab->ClaimNs[i] += ns;
+		if(ns > ab->ClaimMaxNs[i])
+			ab->ClaimMaxNs[i] = ns;
+		pthread_barrier_wait(&ab->Done);
+	}
+
+	return NULL;
+}
+
+/* One run of every round; the number of rounds that went wrong */
+static int ArbiterBenchRun(ArbiterBench *ab, bool locked, uint64_t *meanns, uint64_t *maxns)
+{
+	ArbiterArg args[ARBITER_PLAYERS];
+	pthread_t threads[ARBITER_PLAYERS];
+	uint64_t best, w, sum = 0;
+	int i, r, first, bad = 0;
+
+	ab->Locked = locked;
+	memset(ab->ClaimNs, 0, sizeof(ab->ClaimNs));
+	memset(ab->ClaimMaxNs, 0, sizeof(ab->ClaimMaxNs));
+	pthread_barrier_init(&ab->Go, NULL, ARBITER_PLAYERS + 1);
+	pthread_barrier_init(&ab->Done, NULL, ARBITER_PLAYERS + 1);
+	for(i = 0; i < ARBITER_PLAYERS; i++)
+	{
+		args[i].ab = ab;
+		args[i].Index = i;
+		pthread_create(&threads[i], NULL, ArbiterBenchPlayer, &args[i]);
+	}
+
+	for(r = 0; r < ARBITER_ROUNDS; r++)
+	{
+		ArbiterOpen(&ab->Arb, r + 1);
+		ab->LockBest = UINT64_MAX;
+		pthread_barrier_wait(&ab->Go);
+		pthread_barrier_wait(&ab->Done);
+
+		first = 0;
+		best = UINT64_MAX;
+		for(i = 0; i < ARBITER_PLAYERS; i++)
+		{
+			if(ArbiterBenchKey(ab->Press[r][i], ab->Rank[r][i], i + 1) < best)
+			{
+				best = ArbiterBenchKey(ab->Press[r][i], ab->Rank[r][i], i + 1);
+				first = i;
+			}
+		}
+
+		if(locked)
+			w = ab->LockBest;
+		else if(!ArbiterSeal(&ab->Arb, r + 1, &w)
+			|| ArbiterClaim(&ab->Arb, r + 1, 0, 1, 1) != ARB_BEATEN
+			|| ArbiterClaim(&ab->Arb, r, 0, 1, 1) != ARB_CLOSED)
+			w = 0;
+		if(ArbPlayer(w) != first + 1 || (w & ARB_KEY_MASK) != best || !ab->Leading[r][first])
+			bad++;
+	}
+
+	for(i = 0; i < ARBITER_PLAYERS; i++)
+	{
+		pthread_join(threads[i], NULL);
+		sum += ab->ClaimNs[i];
+		if(ab->ClaimMaxNs[i] > *maxns)
+			*maxns = ab->ClaimMaxNs[i];
+	}
+	*meanns = sum / (ARBITER_ROUNDS * ARBITER_PLAYERS);
+	pthread_barrier_destroy(&ab->Go);
+	pthread_barrier_destroy(&ab->Done);
+	return bad;
+}
+
+static int BenchArbiter(void)
+{
+	ArbiterBench *ab = calloc(1, sizeof(ArbiterBench));
+	uint64_t casmean, casmax = 0, lockmean, lockmax = 0;
+	uint32_t rng = 0x6a09e667;
+	int i, r, casbad, lockbad;
+
+	if(ab == NULL)
+		return 1;
+	ArbiterInit(&ab->Arb);
+	pthread_mutex_init(&ab->Lock, NULL);
+	for(r = 0; r < ARBITER_ROUNDS; r++)
+	{
+		for(i = 0; i < ARBITER_PLAYERS; i++)
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 17;
+			rng ^= rng << 5;
+			ab->Press[r][i] = rng % 16;
+			ab->Rank[r][i] = (rng >> 8) % (ARBITER_PLAYERS + 1);
+		}
+	}
+
+	casbad = ArbiterBenchRun(ab, false, &casmean, &casmax);
+	lockbad = ArbiterBenchRun(ab, true, &lockmean, &lockmax);
+
+	printf("arbiter: %d threads, %d rounds: compare-and-swap: %d rounds without exactly one rightful winner; claim mean %llu ns, max %llu ns, %u retries\n",
+		ARBITER_PLAYERS, ARBITER_ROUNDS, casbad, (unsigned long long)casmean, (unsigned long long)casmax,
+		(unsigned)atomic_load(&ab->Arb.Retries));
+	printf("arbiter: %d threads, %d rounds: pthread mutex: %d rounds wrong; claim mean %llu ns, max %llu ns\n",
+		ARBITER_PLAYERS, ARBITER_ROUNDS, lockbad, (unsigned long long)lockmean, (unsigned long long)lockmax);
+
+	pthread_mutex_destroy(&ab->Lock);
+	free(ab);
+	return casbad != 0 || lockbad != 0;
+}
+
+static const struct {
+	const char *Name;
+	int (*Run)(void);
+	const char *Description;
+} Benches[] = {
+	{ "spsc", BenchSpsc, "SPSC command queue, 1M back-to-back messages" },
+	{ "armed", BenchArmed, "Enabler edge to player thread armed through the reactor" },
+	{ "players", BenchPlayers, "press to winning player thread awake, 3 to 16 podiums" },
+	{ "lines", BenchLines, "-c: each chardev line requested once, and a button on the Enabler's heard through main()" },
+	{ "frames", BenchFrames, "MCP frame parser: split reads, line noise, lost and repeated frames" },
+	{ "countdown", BenchCountdown, "countdown cancel latency from an MCP request, and step timing" },
+	{ "latency", BenchLatency, "latency histogram percentiles against exact ones, and probe cost" },
+	{ "trace", BenchTrace, "event trace record cost with four threads writing at once" },
+	{ "lightbar", BenchLightbar, "countdown lightbar frame: a write per pin against one set/clear mask" },
+	{ "debounce", BenchDebounce, "bit-parallel input debounce against a counter per pin, 1 to 32 inputs" },
+	{ "cancel", BenchCancel, "operator interrupt to a sleeping wait awake, eventfd against 10 ms polling" },
+	{ "serial", BenchSerial, "MCP frames in through a pty to parsed, and idle CPU, poll() against the old read() spin" },
+	{ "reconnect", BenchReconnect, "MCP serial device pulled and plugged back in, through a pty: inotify against backoff" },
+	{ "outbound", BenchOutbound, "one wakeup's messages to the MCP: a write() each in arrival order against the queue" },
+	{ "arbiter", BenchArbiter, "sixteen player threads claiming one ring-in: compare-and-swap against a mutex" },
+	{ "log", BenchLog, "one ring-in line to a slow console, printf() against the logger thread" },
+	{ "wakeup", BenchWakeup, "scanner wake-up lateness under load, default scheduling vs real-time mode" },
+};
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+	int a, failed = 0, ran;
+
+	for(i = 0; i < sizeof(Benches) / sizeof(Benches[0]); i++)
+	{
+		ran = (argc < 2);
+		for(a = 1; a < argc; a++)
+			if(strcmp(argv[a], Benches[i].Name) == 0)
+				ran = 1;
+		if(!ran)
+			continue;
+
+		printf("== %s: %s\n", Benches[i].Name, Benches[i].Description);
+		if(Benches[i].Run() != 0)
+		{
+			printf("== %s: FAILED\n", Benches[i].Name);
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/* Filename: cancel.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Wait cancellation. See cancel.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "clock.h"
+#include "reactor.h"
+#include "latency.h"
+#include "cancel.h"
+
+void CancelInit(Cancel *c)
+{
+	memset(c, 0, sizeof(*c));
+}
+
+int CancelListen(Cancel *c)
+{
+	int fd;
+
+	if(c->Listeners >= CANCEL_MAX_LISTENERS)
+		return -1;
+	fd = ReactorEventFd();
+	if(fd >= 0)
+		c->Fds[c->Listeners++] = fd;
+
+	return fd;
+}
+
+void CancelRaise(Cancel *c, uint64_t edgens)
+{
+	int i;
+
+	/* the time goes out before the count, so whoever sees the new count
+	   sees the edge that made it */
+	atomic_store_explicit(&c->RaisedNs, edgens, memory_order_relaxed);
+	atomic_fetch_add_explicit(&c->Raised, 1, memory_order_release);
+	for(i = 0; i < c->Listeners; i++)
+		ReactorPoke(c->Fds[i]);
+}
+
+int CancelWaitInit(CancelWait *w, Cancel *c)
+{
+	w->Source = c;
+	w->Seen = atomic_load(&c->Raised);
+	w->WakeFd = CancelListen(c);
+	w->TimerFd = ReactorTimerFd();
+
+	return (w->WakeFd < 0 || w->TimerFd < 0) ? -1 : 0;
+}
+
+bool CancelSleepUntil(CancelWait *w, uint64_t deadlinens)
+{
+	const int fds[2] = { w->WakeFd, w->TimerFd };
+	uint32_t raised;
+
+	/* one blocking wait on both, however long the sleep: no polling */
+	ReactorArmTimerAt(w->TimerFd, deadlinens);
+	while((raised = atomic_load_explicit(&w->Source->Raised, memory_order_acquire)) == w->Seen
+		&& ClockNow() < deadlinens)
+		ReactorWaitAny(fds, 2, -1);
+	ReactorArmTimerAt(w->TimerFd, 0);
+
+	if(raised == w->Seen)
+		return false;
+
+	w->Seen = raised;
+	LatSince(LAT_CANCEL, atomic_load_explicit(&w->Source->RaisedNs, memory_order_relaxed));
+	return true;
+}
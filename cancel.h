@@ -0,0 +1,59 @@
+/* Filename: cancel.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: One way to cut every pending wait short. The operator
+   interrupt used to be a pin InterruptDelay() read every 10 ms (when
+   it read it at all); now whoever sees the edge calls CancelRaise(),
+   which pokes an eventfd for each listener straight away: main()'s
+   reactor, to put out the countdowns and lift the penalties, and any
+   thread asleep in CancelSleepUntil(), like the self test.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef CANCEL_H
+#define CANCEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define CANCEL_MAX_LISTENERS 8
+
+typedef struct Cancel {
+	int Fds[CANCEL_MAX_LISTENERS];		// eventfds poked on every raise
+	int Listeners;
+	_Atomic uint32_t Raised;		// times raised so far
+	_Atomic uint64_t RaisedNs;		// game clock time of the last raise's edge
+} Cancel;
+
+/* A thread's own way to sleep on a Cancel */
+typedef struct CancelWait {
+	Cancel *Source;
+	int WakeFd;				// from CancelListen()
+	int TimerFd;				// the deadline, on the game clock
+	uint32_t Seen;				// Source->Raised as of the last wait
+} CancelWait;
+
+void CancelInit(Cancel *c);
+
+/* A new eventfd poked on every raise, for a reactor or ReactorWaitAny().
+   Take every listener before the threads that raise are started.
+   Returns -1 when they're all taken. */
+int CancelListen(Cancel *c);
+
+/* Cut everything short; edgens is when it was asked for */
+void CancelRaise(Cancel *c, uint64_t edgens);
+
+int CancelWaitInit(CancelWait *w, Cancel *c);
+
+/* Sleep on the game clock until deadlinens, unless c is raised first
+   (or was raised since the last wait). Returns true if cut short. */
+bool CancelSleepUntil(CancelWait *w, uint64_t deadlinens);
+
+#endif
@@ -0,0 +1,243 @@
+/* Filename: clock.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Real and virtual game clocks. See clock.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "clock.h"
+
+bool ClockVirtual = false;
+_Atomic uint64_t ClockVirtualNs = 0;
+
+typedef struct ClockTimer {
+	int Fd;					// eventfd handed out by ClockTimerFd()
+	uint64_t DeadlineNs;			// 0 when disarmed
+	uint64_t IntervalNs;
+} ClockTimer;
+
+static pthread_mutex_t ClockLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ClockMoved = PTHREAD_COND_INITIALIZER;
+static ClockTimer Timers[CLOCK_MAX_TIMERS];
+static int TimerCount = 0;
+static uint64_t Sleepers[CLOCK_MAX_SLEEPERS];	// wake-up time, 0 once it has come
+static bool SleeperBusy[CLOCK_MAX_SLEEPERS];	// slot still owned by its thread
+static int SleeperCount = 0;
+
+void ClockUseVirtual(uint64_t startns)
+{
+	atomic_store(&ClockVirtualNs, startns);
+	ClockVirtual = true;
+}
+
+const char *ClockName(void)
+{
+	return ClockVirtual ? "virtual" : "real";
+}
+
+void ClockSleepUntil(uint64_t ns)
+{
+	struct timespec ts;
+	int i;
+
+	if(!ClockVirtual)
+	{
+		ts.tv_sec = ns / 1000000000ull;
+		ts.tv_nsec = ns % 1000000000ull;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+		return;
+	}
+
+	pthread_mutex_lock(&ClockLock);
+	for(i = 0; i < CLOCK_MAX_SLEEPERS && SleeperBusy[i]; i++)
+		;
+	if(i == CLOCK_MAX_SLEEPERS)
+	{
+		/* more sleepers than slots: no deadline for ClockAdvance() to stop at */
+		pthread_mutex_unlock(&ClockLock);
+		while(ClockNow() < ns)
+			sched_yield();
+		return;
+	}
+
+	if(ns > ClockNow())
+	{
+		Sleepers[i] = ns;
+		SleeperBusy[i] = true;
+		SleeperCount++;
+		while(Sleepers[i] != 0)
+			pthread_cond_wait(&ClockMoved, &ClockLock);
+		SleeperBusy[i] = false;
+		SleeperCount--;
+	}
+	pthread_mutex_unlock(&ClockLock);
+}
+
+static ClockTimer *FindTimer(int fd)
+{
+	int i;
+
+	for(i = 0; i < TimerCount; i++)
+		if(Timers[i].Fd == fd)
+			return &Timers[i];
+
+	return NULL;
+}
+
+static void Fire(int fd)
+{
+	uint64_t one = 1;
+
+	(void)!write(fd, &one, sizeof(one));
+}
+
+int ClockTimerFd(void)
+{
+	int fd;
+
+	pthread_mutex_lock(&ClockLock);
+	if(TimerCount == CLOCK_MAX_TIMERS)
+	{
+		pthread_mutex_unlock(&ClockLock);
+		printf("ClockTimerFd(): out of virtual timers (%d)\n", CLOCK_MAX_TIMERS);
+		return -1;
+	}
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd != -1)
+	{
+		Timers[TimerCount].Fd = fd;
+		Timers[TimerCount].DeadlineNs = 0;
+		Timers[TimerCount].IntervalNs = 0;
+		TimerCount++;
+	}
+	pthread_mutex_unlock(&ClockLock);
+
+	return fd;
+}
+
+static int ArmTimer(int fd, uint64_t deadline_ns, uint64_t interval_ns)
+{
+	ClockTimer *t;
+
+	pthread_mutex_lock(&ClockLock);
+	t = FindTimer(fd);
+	if(t == NULL)
+	{
+		pthread_mutex_unlock(&ClockLock);
+		errno = EINVAL;
+		return -1;
+	}
+
+	t->DeadlineNs = deadline_ns;
+	t->IntervalNs = interval_ns;
+
+	/* same as a timerfd: a deadline already past goes off straight away */
+	if(deadline_ns != 0 && deadline_ns <= ClockNow())
+	{
+		Fire(fd);
+		t->DeadlineNs = interval_ns ? ClockNow() + interval_ns : 0;
+	}
+	pthread_mutex_unlock(&ClockLock);
+
+	return 0;
+}
+
+int ClockArmTimer(int fd, uint64_t first_ns, uint64_t interval_ns)
+{
+	/* first_ns of 0 disarms the timer */
+	return ArmTimer(fd, first_ns ? ClockNow() + first_ns : 0, interval_ns);
+}
+
+int ClockArmTimerAt(int fd, uint64_t deadline_ns)
+{
+	return ArmTimer(fd, deadline_ns, 0);
+}
+
+/* Earliest deadline, with ClockLock held */
+static uint64_t NextDeadline(void)
+{
+	uint64_t next = 0;
+	int i;
+
+	for(i = 0; i < TimerCount; i++)
+		if(Timers[i].DeadlineNs != 0 && (next == 0 || Timers[i].DeadlineNs < next))
+			next = Timers[i].DeadlineNs;
+	for(i = 0; i < CLOCK_MAX_SLEEPERS; i++)
+		if(Sleepers[i] != 0 && (next == 0 || Sleepers[i] < next))
+			next = Sleepers[i];
+
+	return next;
+}
+
+void ClockAdvance(uint64_t ns)
+{
+	uint64_t next, now;
+	int i;
+
+	if(!ClockVirtual)
+		return;
+
+	pthread_mutex_lock(&ClockLock);
+	while((next = NextDeadline()) != 0 && next <= ns)
+	{
+		/* stop at each deadline in turn, so a periodic timer goes off
+		   once per period however far we jump */
+		now = ClockNow();
+		if(next > now)
+			atomic_store_explicit(&ClockVirtualNs, next, memory_order_release);
+		now = ClockNow();
+
+		for(i = 0; i < TimerCount; i++)
+		{
+			if(Timers[i].DeadlineNs == 0 || Timers[i].DeadlineNs > now)
+				continue;
+			Fire(Timers[i].Fd);
+			Timers[i].DeadlineNs = Timers[i].IntervalNs ? Timers[i].DeadlineNs + Timers[i].IntervalNs : 0;
+		}
+		for(i = 0; i < CLOCK_MAX_SLEEPERS; i++)
+			if(Sleepers[i] != 0 && Sleepers[i] <= now)
+				Sleepers[i] = 0;
+		pthread_cond_broadcast(&ClockMoved);
+	}
+
+	if(ns > ClockNow())
+		atomic_store_explicit(&ClockVirtualNs, ns, memory_order_release);
+	pthread_mutex_unlock(&ClockLock);
+}
+
+uint64_t ClockNextDeadline(void)
+{
+	uint64_t next;
+
+	pthread_mutex_lock(&ClockLock);
+	next = NextDeadline();
+	pthread_mutex_unlock(&ClockLock);
+
+	return next;
+}
+
+int ClockSleepers(void)
+{
+	int n;
+
+	pthread_mutex_lock(&ClockLock);
+	n = SleeperCount;
+	pthread_mutex_unlock(&ClockLock);
+
+	return n;
+}
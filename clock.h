@@ -0,0 +1,80 @@
+/* Filename: clock.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Timestamps, sleeps and timers. Everything is
+   CLOCK_MONOTONIC nanoseconds, the same clock the GPIO chardev stamps
+   edges with.
+
+   Game code reads the time with ClockNow() and waits with
+   ClockSleepUntil() or a reactor timer, never the system calls
+   directly, so the whole game can be run on a virtual clock instead.
+   The virtual clock stands still until ClockAdvance() moves it, and
+   then jumps straight to each deadline on the way, firing timers and
+   waking sleepers in order: the simulator plays a full game's worth of
+   countdowns and penalties in milliseconds.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define CLOCK_MAX_TIMERS	16
+#define CLOCK_MAX_SLEEPERS	32
+
+/* The real clock, for measuring the program itself */
+static inline uint64_t MonotonicNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Set by ClockUseVirtual(), before any thread or timer is started */
+extern bool ClockVirtual;
+extern _Atomic uint64_t ClockVirtualNs;
+
+/* The game's clock */
+static inline uint64_t ClockNow(void)
+{
+	if(ClockVirtual)
+		return atomic_load_explicit(&ClockVirtualNs, memory_order_acquire);
+
+	return MonotonicNs();
+}
+
+/* Switch to the virtual clock, starting at startns */
+void ClockUseVirtual(uint64_t startns);
+const char *ClockName(void);
+
+/* Block until ClockNow() reaches ns */
+void ClockSleepUntil(uint64_t ns);
+
+/* Virtual timers, behind ReactorTimerFd() and friends: an eventfd the
+   clock pokes once per expiry, the same count a timerfd reads back. */
+int ClockTimerFd(void);
+int ClockArmTimer(int fd, uint64_t first_ns, uint64_t interval_ns);
+int ClockArmTimerAt(int fd, uint64_t deadline_ns);
+
+/* Virtual clock only. Move time forward to ns, stopping at every armed
+   timer and sleeper deadline on the way. */
+void ClockAdvance(uint64_t ns);
+
+/* Earliest armed timer or sleeper deadline, 0 if there is none */
+uint64_t ClockNextDeadline(void);
+
+/* Threads blocked in ClockSleepUntil() right now */
+int ClockSleepers(void);
+
+#endif
@@ -0,0 +1,173 @@
+/* Filename: countdown.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Timer-driven player countdowns. See countdown.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pins.h"
+#include "countdown.h"
+#include "reactor.h"
+#include "clock.h"
+
+int CountdownInit(CountdownEngine *ce, uint64_t stepns, void (*expired)(Player *p, void *ctx), void *ctx)
+{
+	memset(ce, 0, sizeof(*ce));
+	ce->StepNs = stepns ? stepns : COUNTDOWN_STEP_NS;
+	ce->Expired = expired;
+	ce->Ctx = ctx;
+
+	ce->TimerFd = ReactorTimerFd();
+	if(ce->TimerFd == -1)
+	{
+		printf("CountdownInit(): can't create countdown timer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+void CountdownClose(CountdownEngine *ce)
+{
+	CountdownCancel(ce, NULL, 0);
+	if(ce->TimerFd >= 0)
+		close(ce->TimerFd);
+	ce->TimerFd = -1;
+}
+
+/* Arm the timer for whichever countdown steps next */
+static void CountdownRearm(CountdownEngine *ce)
+{
+	uint64_t next = 0;
+	int i;
+
+	for(i = 0; i < MAX_PLAYERS; i++)
+	{
+		if(ce->Slots[i].Player != NULL && (next == 0 || ce->Slots[i].NextNs < next))
+			next = ce->Slots[i].NextNs;
+	}
+
+	ReactorArmTimerAt(ce->TimerFd, next);
+}
+
+/* The TIME_x lights are one bar shared by every podium, so only put
+   them out if nobody else is still counting on them */
+static void CountdownClear(CountdownEngine *ce, Countdown *c)
+{
+	Player *p = c->Player;
+	int i;
+
+	c->Player = NULL;
+	for(i = 0; i < MAX_PLAYERS; i++)
+	{
+		if(ce->Slots[i].Player != NULL)
+		{
+			if(p->Pins.Enable != PIN_NONE)
+				GPIOWrite(p->Pins.Enable, LOW);
+			return;
+		}
+	}
+
+	ClearCountdownLights(p);
+}
+
+void CountdownStart(CountdownEngine *ce, Player *p, uint64_t nowns)
+{
+	Countdown *c = &ce->Slots[p->Number - 1];
+
+	c->Player = p;
+	c->Second = COUNTDOWN_SECONDS;
+	c->NextNs = nowns + ce->StepNs;
+	ce->Started++;
+
+	ShowCountdown(p, c->Second);
+	CountdownRearm(ce);
+}
+
+int CountdownCancel(CountdownEngine *ce, Player *p, uint64_t requestns)
+{
+	uint64_t ns;
+	int i, stopped = 0;
+
+	for(i = 0; i < MAX_PLAYERS; i++)
+	{
+		if(ce->Slots[i].Player == NULL || (p != NULL && ce->Slots[i].Player != p))
+			continue;
+
+		printf("CountdownCancel(): stopping Player %d's countdown at %d\n", ce->Slots[i].Player->Number, ce->Slots[i].Second);
+		CountdownClear(ce, &ce->Slots[i]);
+		ce->Cancelled++;
+		stopped++;
+	}
+
+	if(stopped == 0)
+		return 0;
+
+	if(requestns != 0)
+	{
+		ns = ClockNow() - requestns;
+		ce->CancelTimed++;
+		ce->CancelSumNs += ns;
+		if(ns > ce->CancelMaxNs)
+			ce->CancelMaxNs = ns;
+	}
+
+	CountdownRearm(ce);
+	return stopped;
+}
+
+bool CountdownRunning(CountdownEngine *ce, Player *p)
+{
+	return ce->Slots[p->Number - 1].Player == p;
+}
+
+void CountdownOnTimer(int fd, uint32_t events, void *ctx)
+{
+	CountdownEngine *ce = (CountdownEngine *)ctx;
+	Countdown *c;
+	Player *p;
+	uint64_t now;
+	int i;
+
+	(void)events;
+	ReactorDrain(fd);
+	now = ClockNow();
+
+	for(i = 0; i < MAX_PLAYERS; i++)
+	{
+		c = &ce->Slots[i];
+
+		/* catch up if we were held up by more than a step */
+		while(c->Player != NULL && c->NextNs <= now)
+		{
+			if(now - c->NextNs > ce->LateMaxNs)
+				ce->LateMaxNs = now - c->NextNs;
+
+			c->Second--;
+			ShowCountdown(c->Player, c->Second);
+			if(c->Second > 0)
+			{
+				c->NextNs += ce->StepNs;
+				continue;
+			}
+
+			p = c->Player;
+			CountdownClear(ce, c);
+			ce->Finished++;
+			if(ce->Expired)
+				ce->Expired(p, ce->Ctx);
+		}
+	}
+
+	CountdownRearm(ce);
+}
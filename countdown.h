@@ -0,0 +1,73 @@
+/* Filename: countdown.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Timer-driven player countdowns. A countdown used to be
+   ShowCountdown()/InterruptDelay(1000) pairs inside the player thread,
+   which stopped reading its button for five seconds and couldn't be
+   stopped by the MCP. Now every running countdown is a deadline in one
+   table, stepped from a single timerfd in main()'s reactor, and
+   CountdownCancel() puts the lights out straight away.
+
+   Everything here runs on main()'s thread; nothing is locked.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef COUNTDOWN_H
+#define COUNTDOWN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "player.h"
+
+#define COUNTDOWN_SECONDS 5
+#define COUNTDOWN_STEP_NS 1000000000ull
+
+typedef struct Countdown {
+	Player *Player;				// NULL when this slot isn't counting
+	int Second;				// what the lightbar shows now, COUNTDOWN_SECONDS down to 0
+	uint64_t NextNs;			// when to show Second - 1
+} Countdown;
+
+typedef struct CountdownEngine {
+	int TimerFd;				// armed for the earliest NextNs, hand it to the reactor
+	uint64_t StepNs;
+	Countdown Slots[MAX_PLAYERS];		// indexed by player number - 1
+
+	/* called when a countdown runs out, after its lights are off */
+	void (*Expired)(Player *p, void *ctx);
+	void *Ctx;
+
+	uint64_t Started;
+	uint64_t Finished;
+	uint64_t Cancelled;
+	uint64_t CancelTimed;			// cancels that came with a request time
+	uint64_t CancelSumNs;			// cancel request -> lights off
+	uint64_t CancelMaxNs;
+	uint64_t LateMaxNs;			// worst step behind its deadline
+} CountdownEngine;
+
+int CountdownInit(CountdownEngine *ce, uint64_t stepns, void (*expired)(Player *p, void *ctx), void *ctx);
+void CountdownClose(CountdownEngine *ce);
+
+/* Light the whole bar for p and start stepping it down. Restarts p's
+   countdown if one is already running. */
+void CountdownStart(CountdownEngine *ce, Player *p, uint64_t nowns);
+
+/* Stop p's countdown (every countdown if p is NULL) and clear its
+   lights. requestns is when the cancel was asked for, for the latency
+   figures; 0 if unknown. Returns the number of countdowns stopped. */
+int CountdownCancel(CountdownEngine *ce, Player *p, uint64_t requestns);
+
+bool CountdownRunning(CountdownEngine *ce, Player *p);
+
+/* Reactor handler for TimerFd, ctx is the engine */
+void CountdownOnTimer(int fd, uint32_t events, void *ctx);
+
+#endif
@@ -0,0 +1,129 @@
+/* Filename: debounce.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Debounce setup. See debounce.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debounce.h"
+
+void DebounceInit(Debounce *d, uint32_t idle)
+{
+	memset(d, 0, sizeof(*d));
+	d->Stable = idle;
+}
+
+void DebounceSetPin(Debounce *d, uint8_t pin, int samples)
+{
+	uint32_t bit = 1u << pin;
+	int k;
+
+	if(pin >= 32)
+		return;
+	if(samples < 1)
+		samples = 1;
+	if(samples > DEBOUNCE_MAX_SAMPLES)
+		samples = DEBOUNCE_MAX_SAMPLES;
+
+	/* the count runs down to zero and flips on the sample after, so a
+	   settle of n samples loads n - 1 */
+	for(k = 0; k < DEBOUNCE_BITS; k++)
+	{
+		if(((samples - 1) >> k) & 1)
+			d->Reload[k] |= bit;
+		else
+			d->Reload[k] &= ~bit;
+		d->Count[k] = (d->Count[k] & ~bit) | (d->Reload[k] & bit);
+	}
+}
+
+int DebounceGetPin(const Debounce *d, uint8_t pin)
+{
+	int k, samples = 0;
+
+	if(pin >= 32)
+		return 1;
+	for(k = 0; k < DEBOUNCE_BITS; k++)
+		samples |= ((d->Reload[k] >> pin) & 1) << k;
+
+	return samples + 1;
+}
+
+/* Settle time in samples, rounded up */
+static int DebounceSamples(uint64_t usec, uint64_t intervalns)
+{
+	uint64_t samples = (usec * 1000ull + intervalns - 1) / intervalns;
+
+	if(samples > DEBOUNCE_MAX_SAMPLES)
+	{
+		printf("DebounceParse(): %llu us is more than %d samples, using %llu us\n",
+			(unsigned long long)usec, DEBOUNCE_MAX_SAMPLES,
+			(unsigned long long)(DEBOUNCE_MAX_SAMPLES * intervalns / 1000));
+		samples = DEBOUNCE_MAX_SAMPLES;
+	}
+
+	return samples ? (int)samples : 1;
+}
+
+int DebounceParse(Debounce *d, const char *spec, uint32_t mask, uint64_t intervalns)
+{
+	char *copy, *item, *save = NULL, *eq, *end;
+	unsigned long pin;
+	uint64_t usec;
+	int i, failed = 0;
+
+	if(intervalns == 0)
+	{
+		printf("DebounceParse(): the scanner has no sample interval (-u 0), not debouncing\n");
+		return 0;
+	}
+
+	copy = strdup(spec);
+	for(item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+	{
+		eq = strchr(item, '=');
+		if(eq == NULL)
+		{
+			usec = strtoull(item, &end, 0);
+			if(*end != '\0')
+			{
+				failed = -1;
+				break;
+			}
+			for(i = 0; i < 32; i++)
+				if(mask & (1u << i))
+					DebounceSetPin(d, i, DebounceSamples(usec, intervalns));
+			continue;
+		}
+
+		*eq = '\0';
+		pin = strtoul(item, &end, 0);
+		if(*end != '\0' || pin >= 32)
+		{
+			failed = -1;
+			break;
+		}
+		usec = strtoull(eq + 1, &end, 0);
+		if(*end != '\0')
+		{
+			failed = -1;
+			break;
+		}
+		DebounceSetPin(d, pin, DebounceSamples(usec, intervalns));
+	}
+	free(copy);
+
+	if(failed)
+		printf("DebounceParse(): can't make sense of '%s' (usec for every input, then any gpio=usec)\n", spec);
+	return failed;
+}
@@ -0,0 +1,89 @@
+/* Filename: debounce.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Bit-parallel debounce for a whole GPIO bank. A pin's
+   debounced level only changes once its raw level has read the other
+   way for its settle time, so many samples in a row; any bounce back
+   in between starts the count over. Each pin's counter is kept
+   "vertically", one bit of it in each of DEBOUNCE_BITS words, so all
+   32 pins are filtered together in a couple of dozen instructions per
+   sample, however many inputs there are.
+
+   Every pin shifts by the same settle time, so presses keep their
+   order as long as the podiums share one setting.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+
+#define DEBOUNCE_BITS		5
+#define DEBOUNCE_MAX_SAMPLES	(1 << DEBOUNCE_BITS)	// 3.2 ms at the default 100 us scan
+
+typedef struct Debounce {
+	uint32_t Stable;			// the debounced bank
+	uint32_t Count[DEBOUNCE_BITS];		// samples still to go, less one; bit n of each is GPIO n's
+	uint32_t Reload[DEBOUNCE_BITS];		// each pin's settle in samples, less one, same layout
+	uint32_t Pending;			// pins read the other way last sample
+	uint64_t Bounces;			// times a pin went back before it settled
+} Debounce;
+
+/* Start with the bank at idle and every pin passed straight through */
+void DebounceInit(Debounce *d, uint32_t idle);
+
+/* pin's raw level must hold samples samples in a row (1 to
+   DEBOUNCE_MAX_SAMPLES, 1 being no filtering) before it counts */
+void DebounceSetPin(Debounce *d, uint8_t pin, int samples);
+int DebounceGetPin(const Debounce *d, uint8_t pin);
+
+/* "usec" for every pin in mask, then any "pin=usec" overrides, comma
+   separated, at a sample every intervalns. Returns -1 on a bad spec. */
+int DebounceParse(Debounce *d, const char *spec, uint32_t mask, uint64_t intervalns);
+
+/* Feed one raw sample, get the debounced bank back */
+static inline uint32_t DebounceFilter(Debounce *d, uint32_t raw)
+{
+	uint32_t diff = raw ^ d->Stable;
+	uint32_t zero, flip, dec, reload, borrow, old;
+	int k;
+
+	/* a pin whose count has run out and still reads the other way flips */
+	zero = 0;
+	for(k = 0; k < DEBOUNCE_BITS; k++)
+		zero |= d->Count[k];
+	zero = ~zero;
+	flip = diff & zero;
+	d->Stable ^= flip;
+
+	/* the rest of the pins reading the other way count down one... */
+	dec = diff & ~zero;
+	borrow = dec;
+	for(k = 0; k < DEBOUNCE_BITS; k++)
+	{
+		old = d->Count[k];
+		d->Count[k] = old ^ borrow;
+		borrow &= ~old;
+	}
+
+	/* ...and those that agree with the debounced bank (again), or just
+	   flipped, start over at their settle time */
+	reload = ~diff | flip;
+	for(k = 0; k < DEBOUNCE_BITS; k++)
+		d->Count[k] = (d->Count[k] & ~reload) | (d->Reload[k] & reload);
+
+	if(d->Pending & ~diff)
+		d->Bounces += __builtin_popcount(d->Pending & ~diff);
+	d->Pending = diff & ~flip;
+
+	return d->Stable;
+}
+
+#endif
@@ -0,0 +1,327 @@
+/* Filename: game.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Round logic. See game.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pins.h"
+#include "clock.h"
+#include "game.h"
+#include "latency.h"
+#include "trace.h"
+
+static void GameOnExpired(Player *p, void *ctx)
+{
+	Game *g = (Game *)ctx;
+	Msg m = { 0 };
+
+	printf("main(): Player %d timed out\n", p->Number);
+
+	if(g->Out == NULL)
+		return;
+	m.Code = RESP_TIMED_OUT;
+	m.Player = p->Number;
+	m.TimeNs = ClockNow();
+	MsgQueueSend(g->Out, &m);	// the MCP is waiting on this one, so never drop it
+}
+
+int GameInit(Game *g, PlayerEngine *pe, MsgQueue *out, uint64_t stepns)
+{
+	memset(g, 0, sizeof(*g));
+	g->Engine = pe;
+	g->Out = out;
+	g->Lockout = -1;
+	g->PenaltyMs = PENALTY_DEFAULT_MS;
+	g->ArbTimerFd = ReactorTimerFd();
+	if(g->ArbTimerFd < 0)
+		return -1;
+
+	return CountdownInit(&g->Countdowns, stepns, GameOnExpired, g);
+}
+
+void GameClose(Game *g)
+{
+	CountdownClose(&g->Countdowns);
+	if(g->ArbTimerFd >= 0)
+		close(g->ArbTimerFd);
+	g->ArbTimerFd = -1;
+}
+
+int GameAttach(Game *g, Reactor *r)
+{
+	if(ReactorAdd(r, g->Engine->RespWakeFd, GameOnResp, g) != 0)
+		return -1;
+	if(ReactorAdd(r, g->ArbTimerFd, GameOnArbTimer, g) != 0)
+		return -1;
+	return ReactorAdd(r, g->Countdowns.TimerFd, CountdownOnTimer, &g->Countdowns);
+}
+
+void GameSetPenalty(Game *g, int ms)
+{
+	if(ms < 0)
+		ms = 0;
+	if(ms > UINT16_MAX)
+		ms = UINT16_MAX;
+	g->PenaltyMs = ms;
+}
+
+void GameEnabler(Game *g, int lockout, uint64_t edgens)
+{
+	/* Only tell the player threads when the Enabler actually changes */
+	if(lockout == g->Lockout)
+		return;
+	g->Lockout = lockout;
+	TraceLogAt(edgens, TRACE_ENABLER, 0, ENABLER, lockout, 0);
+
+	g->EnablerMsg.TimeNs = edgens;
+	g->EnablerMsg.Seq++;
+	g->EnablerMsg.Arg = g->PenaltyMs;
+
+	switch(lockout)
+	{
+		case 0: //Enabler Switch is Active (player showtime!)
+			/* a new round: nobody has the ring-in yet */
+			g->Rounds++;
+			g->Winner = 0;
+			g->WinnerPressNs = 0;
+			g->EnabledNs = edgens;
+			g->Round = g->EnablerMsg.Seq;
+			g->HeldNs = 0;
+			ReactorArmTimerAt(g->ArbTimerFd, 0);
+
+			/* open the arbiter before anyone hears the round is on */
+			ArbiterOpen(&g->Engine->Arb, g->Round);
+
+			g->EnablerMsg.Code = CMD_ENABLER_ACTIVE;
+			PlayerEngineBroadcast(g->Engine, &g->EnablerMsg);
+			break;
+		case 1: //Enabler Switch is Inactive (penalize early ring-in)
+			//send the lockout cmd to the player threads
+			//and put out any countdown the host didn't wait for
+			CountdownCancel(&g->Countdowns, NULL, edgens);
+			g->EnablerMsg.Code = CMD_ENABLER_INACTIVE;
+			PlayerEngineBroadcast(g->Engine, &g->EnablerMsg);
+			break;
+		default:
+			break;
+	}
+}
+
+void GameCountdownEnd(Game *g, int player, uint64_t requestns)
+{
+	if(player >= 1 && player <= g->Engine->Count)
+		CountdownCancel(&g->Countdowns, &g->Engine->Players[player - 1], requestns);
+}
+
+void GameInterrupt(Game *g, uint64_t edgens)
+{
+	Msg m = { 0 };
+	int n;
+
+	g->Interrupts++;
+	n = CountdownCancel(&g->Countdowns, NULL, edgens);
+	if(n > 0)
+	{
+		g->Interrupted += n;
+		LatSince(LAT_CANCEL, edgens);
+	}
+
+	m.Code = CMD_OPERATOR_INTERRUPT;
+	m.TimeNs = edgens;
+	m.Seq = g->EnablerMsg.Seq;
+	PlayerEngineBroadcast(g->Engine, &m);
+}
+
+/* claim won the round: light its countdown and lock everyone else out */
+static void GameAward(Game *g, const Msg *claim, int claims)
+{
+	Player *p = &g->Engine->Players[claim->Player - 1];
+	Msg m = { 0 };
+	int i;
+
+	LatSince(LAT_ARBITRATION, claim->TimeNs);
+	g->Winner = claim->Player;
+	g->WinnerPressNs = claim->TimeNs;
+	g->Decided++;
+	if(claims > 1)
+		g->Contested++;
+
+	p->ProbeNs = claim->TimeNs;
+	CountdownStart(&g->Countdowns, p, ClockNow());
+
+	m.TimeNs = claim->TimeNs;
+	m.Seq = g->EnablerMsg.Seq;
+	for(i = 0; i < g->Engine->Count; i++)
+	{
+		m.Code = (i == claim->Player - 1) ? CMD_RINGIN_WON : CMD_LOCKED_OUT;
+		MsgQueueSend(&g->Engine->Players[i].Cmd, &m);
+	}
+
+	/* the MCP hears the one ring-in that won, not every press that tried */
+	if(g->Out != NULL)
+	{
+		m.Code = RESP_RANG_IN;
+		m.Player = claim->Player;
+		m.Arg = claim->Arg;
+		m.TimeNs = claim->TimeNs;
+		m.Seq = claim->Seq;
+		MsgQueueSend(g->Out, &m);	// it's the only one it gets, so wait for room
+	}
+
+	if(g->Awarded != NULL)
+		g->Awarded(p, claim, claims, g->Ctx);
+}
+
+/* Has player j judged every press it made from the Enabler up to
+   pressns? Until it has, it might still beat the claim we hold. */
+static bool GameCaughtUp(Game *g, int j, uint64_t pressns)
+{
+	Player *p = &g->Engine->Players[j];
+	ScanPress sp;
+	uint64_t judged;
+
+	if(p->Scan == NULL)
+		return true;	// edge events: no snapshot to look at, go with the claims in hand
+
+	/* the claim we hold was made after its player read the bank, and
+	   we read it off the arbiter since, so any press in the same or an
+	   earlier snapshot is in here too */
+	judged = atomic_load_explicit(&p->JudgedNs, memory_order_acquire);
+	ScannerPress(p->Scan, j, &sp);
+
+	if(sp.PressNs >= g->EnabledNs && sp.PressNs <= pressns && sp.PressNs > judged)
+		return false;
+	if(sp.PrevPressNs >= g->EnabledNs && sp.PrevPressNs <= pressns && sp.PrevPressNs > judged)
+		return false;
+	return true;
+}
+
+/* Seal the arbiter on the best claim and award it, once every other
+   player thread has judged anything it pressed before that. With force,
+   whoever is behind by now has had GAME_ARB_WAIT_MS and loses out. */
+static void GameDecide(Game *g, bool force)
+{
+	Arbiter *a = &g->Engine->Arb;
+	uint64_t w = ArbiterPeek(a);
+	Msg claim = { 0 };
+	int j;
+
+	if(g->Winner != 0 || ArbRound(w) != (uint16_t)g->Round || ArbSealed(w) || ArbPlayer(w) == 0)
+		return;
+
+	for(j = 0; j < g->Engine->Count && !force; j++)
+	{
+		if(j == ArbPlayer(w) - 1 || GameCaughtUp(g, j, g->EnabledNs + ArbPressNs(w)))
+			continue;
+
+		/* its thread pokes us once it has judged the press */
+		if(g->HeldNs == 0)
+		{
+			g->Held++;
+			g->HeldNs = ClockNow();
+			ReactorArmTimerAt(g->ArbTimerFd, g->HeldNs + GAME_ARB_WAIT_MS * 1000000ull);
+		}
+		return;
+	}
+
+	if(force)
+		g->HeldOut++;
+	if(g->HeldNs != 0)
+		ReactorArmTimerAt(g->ArbTimerFd, 0);
+	g->HeldNs = 0;
+
+	/* a claim can still beat the one we looked at up to the seal */
+	if(!ArbiterSeal(a, g->Round, &w))
+		return;
+
+	claim.Code = RESP_COUNTDOWN;
+	claim.Player = ArbPlayer(w);
+	claim.Arg = ArbRank(w);
+	claim.TimeNs = g->EnabledNs + ArbPressNs(w);
+	claim.Seq = g->Round;
+	GameAward(g, &claim, atomic_load_explicit(&a->Claims, memory_order_relaxed));
+}
+
+void GameOnArbTimer(int fd, uint32_t events, void *ctx)
+{
+	Game *g = (Game *)ctx;
+
+	ReactorDrain(fd);
+	if(g->HeldNs != 0)
+		GameDecide(g, true);
+}
+
+void GameOnResp(int fd, uint32_t events, void *ctx)
+{
+	Game *g = (Game *)ctx;
+	Msg resp;
+	int i;
+
+	/* Drain anything the player threads told us; they all share one eventfd */
+	ReactorDrain(fd);
+	for(i = 0; i < g->Engine->Count; i++)
+	{
+		while(MsgQueuePop(&g->Engine->Players[i].Resp, &resp))
+		{
+			TraceLog(TRACE_RESP, resp.Player, 0xff, resp.Code, resp.TimeNs);
+			/* the arbiter has the claims; one that led there and then
+			   lost to an earlier press is all that's left to count */
+			if(resp.Code == RESP_COUNTDOWN && g->Winner != 0 && resp.Player != g->Winner)
+				g->LateClaims++;
+
+			if(resp.Code == RESP_PENALIZED)
+				g->Penalized++;
+		}
+	}
+
+	GameDecide(g, false);
+}
+
+void GameReport(Game *g, FILE *out)
+{
+	CountdownEngine *ce = &g->Countdowns;
+
+	if(g->Rounds > 0)
+	{
+		fprintf(out, "main(): Rounds: %llu played, %llu won, %llu with more than one claim; %llu late claims, %llu pressed before the winner; %llu presses penalized\n",
+			(unsigned long long)g->Rounds,
+			(unsigned long long)g->Decided,
+			(unsigned long long)g->Contested,
+			(unsigned long long)g->LateClaims,
+			(unsigned long long)atomic_load(&g->Engine->Arb.Overtaken),
+			(unsigned long long)g->Penalized);
+		fprintf(out, "main(): Arbiter: %llu CAS retries; %llu decisions held for a slower thread, %llu gave up after %d ms\n",
+			(unsigned long long)atomic_load(&g->Engine->Arb.Retries),
+			(unsigned long long)g->Held,
+			(unsigned long long)g->HeldOut, GAME_ARB_WAIT_MS);
+	}
+
+	if(g->Interrupts > 0)
+		fprintf(out, "main(): Operator interrupts: %llu, %llu countdowns put out\n",
+			(unsigned long long)g->Interrupts,
+			(unsigned long long)g->Interrupted);
+
+	if(ce->Started == 0)
+		return;
+
+	fprintf(out, "main(): Countdowns: %llu started, %llu ran out, %llu cancelled; worst step %llu ns late\n",
+		(unsigned long long)ce->Started,
+		(unsigned long long)ce->Finished,
+		(unsigned long long)ce->Cancelled,
+		(unsigned long long)ce->LateMaxNs);
+	if(ce->CancelTimed > 0)
+		fprintf(out, "main(): Countdown cancel latency: mean %llu ns, max %llu ns\n",
+			(unsigned long long)(ce->CancelSumNs / ce->CancelTimed),
+			(unsigned long long)ce->CancelMaxNs);
+}
@@ -0,0 +1,97 @@
+/* Filename: game.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Round logic: what main() does with the Enabler, the
+   player threads' claims and the countdowns. The player threads judge
+   their own presses (early, penalized, locked out) and race for the
+   ring-in on the engine's arbiter (arbiter.h); this seals the winner
+   once nobody who pressed earlier can still be on their way, lights
+   its countdown and tells everyone else they're locked out until the
+   Enabler comes round again.
+
+   It is kept apart from main() so the simulator (ringsim.c) can drive
+   exactly the same code without the serial port or real buttons.
+   Everything here runs on the thread that runs the reactor.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "msgqueue.h"
+#include "reactor.h"
+#include "player.h"
+#include "countdown.h"
+
+#define GAME_ARB_WAIT_MS 20	// longest we hold a claim for a thread yet to judge an earlier press; more than ENABLER_WAIT_MS
+
+typedef struct Game {
+	PlayerEngine *Engine;
+	CountdownEngine Countdowns;
+	MsgQueue *Out;				// the winner's RESP_RANG_IN, RESP_TIMED_OUT for the MCP, or NULL
+
+	int Lockout;				// Enabler level, -1 until we've seen it
+	Msg EnablerMsg;
+	uint32_t Round;				// the arbiter's round, EnablerMsg.Seq when it went active
+	uint64_t EnabledNs;			// when the Enabler last went active
+	int ArbTimerFd;				// bounds the wait in GameDecide()...
+	uint64_t HeldNs;			// ...which started then, 0 if we aren't waiting
+	int Winner;				// 1-based player holding this round's ring-in, 0 for none
+	uint64_t WinnerPressNs;
+	int PenaltyMs;				// early ring-in lockout handed out with the next Enabler edge
+
+	/* called once a round's ring-in is decided, after the countdown has started */
+	void (*Awarded)(Player *p, const Msg *claim, int claims, void *ctx);
+	void *Ctx;
+
+	uint64_t Rounds;			// times the Enabler went active
+	uint64_t Decided;			// rounds somebody won
+	uint64_t Contested;			// decided with more than one claim in hand
+	uint64_t LateClaims;			// claims that led on the arbiter but didn't get the ring-in
+	uint64_t Held;				// decisions that waited on a player thread to catch up
+	uint64_t HeldOut;			// ...and gave up waiting
+	uint64_t Penalized;			// presses ignored inside an early ring-in penalty
+	uint64_t Interrupts;			// operator interrupts
+	uint64_t Interrupted;			// countdowns they put out
+} Game;
+
+int GameInit(Game *g, PlayerEngine *pe, MsgQueue *out, uint64_t stepns);
+void GameClose(Game *g);
+
+/* Hand the player responses and the countdown timer to r */
+int GameAttach(Game *g, Reactor *r);
+
+/* The Enabler is now at level lockout (0 active, 1 inactive) as of
+   edgens. Repeats of the current level are ignored. */
+void GameEnabler(Game *g, int lockout, uint64_t edgens);
+
+/* Early ring-in penalty in ms from the next Enabler edge on; rounds
+   already under way keep theirs */
+void GameSetPenalty(Game *g, int ms);
+
+/* The operator hit the interrupt at edgens: put out every countdown and
+   end any penalty that was running then */
+void GameInterrupt(Game *g, uint64_t edgens);
+
+/* The MCP (or host) is done with player's countdown */
+void GameCountdownEnd(Game *g, int player, uint64_t requestns);
+
+/* Reactor handler for Engine->RespWakeFd, ctx is the game */
+void GameOnResp(int fd, uint32_t events, void *ctx);
+
+/* Reactor handler for ArbTimerFd, ctx is the game */
+void GameOnArbTimer(int fd, uint32_t events, void *ctx);
+
+/* Round and countdown counters, main()'s usual "main(): ..." lines */
+void GameReport(Game *g, FILE *out);
+
+#endif
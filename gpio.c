@@ -19,6 +19,70 @@
    Running:
    * Since this program uses GPIO pins, you must run the
      program as root.
+   * Options:
+       -g bcm2835|sim	GPIO backend (default bcm2835, or sim on a SIM=1 build)
+       -i script	sim: scripted input edges, "<time_us> <gpio> <level>" per line
+       -o file		sim: write the recorded output log here on exit
+       -c /dev/gpiochipN	read player buttons as kernel-timestamped edge
+			events from the GPIO character device instead of
+			polling them (works with the gpio-sim module too)
+       -t policy	how to order presses that land in the same input
+			snapshot: lowest (default), rotate, random[:seed]
+       -u usec		input scanner sample interval, default 100; 0 spins
+			flat out (only sensible with a core to itself)
+       -d spec		scanner debounce: how long an input must hold a new
+			level before it counts, "usec" for every input then
+			any "gpio=usec" overrides, e.g. -d 500,22=2000 for a
+			bouncy Enabler. Default 500; 0 turns it off. Rounded
+			up to whole samples, at most 32 of them.
+       -m map		player pin map, one "input[:led[:enable]]" per podium
+			separated by commas, BCM GPIO numbers. 3 to 16 podiums.
+			Default is the three podiums in pins.h.
+       -r file[:n]	event trace file, default jeopardy.trace with room
+			for 65536 events; "none" turns it off. The last
+			one is kept as file.prev. Read it with jeopardy-trace.
+       -s ms		self test: how long each group of lights stays on,
+			every podium's LED together, then (B+) the lightbars
+			with every countdown enable. Default 200; 0 skips it.
+			The operator interrupt cuts it short.
+       -p ms		early ring-in penalty: a player who rings in before
+			the Enabler is live has presses ignored until this
+			long after the early one. Default 250; the MCP can
+			change it between rounds with FRAME_PENALTY.
+       -l level[:n]	how much the player, scanner and serial threads say:
+			error, warn, info (ring-ins, penalties, what goes to
+			and from the MCP) or debug (everything, the default).
+			They hand their lines to a logger thread instead of
+			printing, so a slow console can't hold up a ring-in.
+			Below warn each thread gets n lines a second (default
+			200, 0 for no limit); what's dropped is counted.
+       -S dev		serial device the MCP is on, default /dev/ttyS0. If
+			it isn't there, or goes away, we carry on and open it
+			again the moment it's back (a USB adapter plugged in,
+			say) and pair with the MCP afresh.
+       -b baud		the fastest rate to offer the MCP, up to 1000000;
+			default 9600. The link opens at 9600 and, at the
+			first framed pairing, moves to the fastest rate the
+			MCP agrees to that passes SERLINK_PINGS round trips,
+			stepping down through the standard rates until one
+			does. The round trip is logged at info and reported
+			on exit.
+       -R		real-time mode: SCHED_FIFO priorities, the input
+			scanner pinned to a CPU of its own, memory locked and
+			thread stacks faulted in up front. Compare the
+			"scanner wake-up late" line in the latency report
+			with and without it.
+   * kill -USR1 <pid> prints the per-stage latency histograms (press to
+     thread, arbitration, LOCKOUT_ASSERT, P*_ENABLE, serial write,
+     Enabler to armed, how late the input scanner wakes, operator
+     interrupt to countdowns out, MCP bytes in to handled, and a
+     message for the MCP queued to sent). They are also printed every 30 s while in use
+     and on exit.
+
+   Off-Pi builds:
+   * make SIM=1 builds against the simulated board in gpiosim.c and
+     doesn't need the bcm2835 library, so the ring-in logic can be run
+     and timed on any Linux box.
 
    Have fun!
 */
@@ -36,7 +100,6 @@
    support@beige-box.com
 */
 
-#include <bcm2835.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -47,103 +110,255 @@
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
-#include <termios.h>
+#include <time.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+
+#include "gpioio.h"
+#include "pins.h"
+#include "clock.h"
+#include "gpiosim.h"
+#include "gpiocdev.h"
+#include "scanner.h"
+#include "msgqueue.h"
+#include "reactor.h"
+#include "player.h"
+#include "serproto.h"
+#include "countdown.h"
+#include "game.h"
+#include "latency.h"
+#include "trace.h"
+#include "rt.h"
+#include "ready.h"
+#include "cancel.h"
+#include "log.h"
+#include "serlink.h"
+#include "serout.h"
 
 #define ROOT_UID 0		// Change this define to match your root UID if CheckIfRoot() says you have a root UID mismatch.
-#define MODEL_BPLUS		// Define this as MODEL_AB or MODEL_BPLUS depending on your Pi model.
-
-#define MS_DIVISOR 10		// Play with this and see if this makes a difference to InterruptDelay() precision.
-
-#ifdef PI_MODEL
-	#error Must define a Pi type as MODEL_AB (26-pin) or MODEL_BPLUS (40-pin)
-#endif
-#ifdef MODEL_AB //map the pin assignments to the 26-pin Model A/B Pi
-	#define INPUT1 		RPI_GPIO_P1_07			//Pin 4
-	#define INPUT2 		RPI_GPIO_P1_11			//Pin 17
-	#define INPUT3 		RPI_V2_GPIO_P1_13		//Pin 27 (Rev2)
-	//#define INPUT3 	RPI_GPIO_P1_13			//Pin 21 (Rev1)
-	#define INPUT4 		RPI_GPIO_P1_15			//Pin 22
-	#define P1_LED 		RPI_GPIO_P1_12			//Pin 18
-	#define P2_LED 		RPI_GPIO_P1_16			//Pin 23
-	#define P3_LED 		RPI_GPIO_P1_18			//Pin 24
-//	#define P4_LED 		RPI_GPIO_P1_22			//Pin 25
-	#define LOCKOUT_ASSERT	RPI_GPIO_P1_11			//Pin 11 (SCLK)
-#endif
-#ifdef MODEL_BPLUS //map the pin assignments to the 40-pin Model B+ (and all later revisions)
-	#define INPUT1		RPI_BPLUS_GPIO_J8_11		//Pin 11 (GPIO 17)
-	#define INPUT2		RPI_BPLUS_GPIO_J8_13		//Pin 13 (GPIO 27)
-	#define INPUT3		RPI_BPLUS_GPIO_J8_15		//Pin 15 (GPIO 22)
-//	#define INPUT4		RPI_BPLUS_GPIO_J8_7		//Pin 7  (GPIO 4)
-	#define P1_LED		RPI_BPLUS_GPIO_J8_29		//Pin 29 (GPIO 5)
-	#define P2_LED		RPI_BPLUS_GPIO_J8_31		//Pin 31 (GPIO 6)
-	#define P3_LED		RPI_BPLUS_GPIO_J8_33		//Pin 33 (GPIO 13)
-//	#define P4_LED		RPI_BPLUS_GPIO_J8_37		//Pin 37 (GPIO 26)
-	#define LOCKOUT_ASSERT	RPI_BPLUS_GPIO_J8_32		//Pin 32 (GPIO 12)
-
-	//Define the countdown timer lights
-	#define P1_ENABLE	RPI_BPLUS_GPIO_J8_07		//Pin 7  (GPIO 4)
-	#define P2_ENABLE	RPI_BPLUS_GPIO_J8_05		//Pin 5  (GPIO 3)
-	#define P3_ENABLE	RPI_BPLUS_GPIO_J8_03		//Pin 3  (GPIO 2)
-	#define TIME_1		RPI_BPLUS_GPIO_J8_19		//Pin 19 (GPIO 10 / MOSI)
-	#define TIME_2		RPI_BPLUS_GPIO_J8_23		//Pin 23 (GPIO 11 / CLK)
-	#define TIME_3		RPI_BPLUS_GPIO_J8_21		//Pin 21 (GPIO 9 / MISO)
-	#define TIME_4		RPI_BPLUS_GPIO_J8_35		//Pin 35 (GPIO 19)
-	#define TIME_5		RPI_BPLUS_GPIO_J8_37		//Pin 37 (GPIO 26)
-#endif
-
-
-//Used in Mk.II. Pin assignments changed in Mk.III.
-/*#define INPUT1 RPI_GPIO_P1_16                   //Pin 23
-#define INPUT2 RPI_GPIO_P1_11                   //Pin 17
-#define INPUT3 RPI_GPIO_P1_18                   //Pin 24
-#define ENABLER RPI_GPIO_P1_12                  //Pin 18
-#define ENABLER_LED RPI_GPIO_P1_07              //Pin 4
-#define P1_LED RPI_GPIO_P1_15                   //Pin 22
-#define P2_LED RPI_GPIO_P1_22                   //Pin 25
-#define P3_LED RPI_V2_GPIO_P1_13                //Pin 27 (Rev2) */
-/*#define P3_LED RPI_GPIO_P1_13*/               //Pin 21 (Rev1)
-//#define OPERATOR_INTERRUPT RPI_V2_GPIO_P1_05    //Pin SCL (GPIO 3, Rev2)
-/*#define OPERATOR_INTERRUPT RPI_GPIO_P1_05*/   //Pin SCL? (GPIO 1, Rev1)
+#define READY_TIMEOUT_MS 2000	// how long main() waits on the other threads before starting without them
+
+#define SER_TUNE_ASK_MS		250	// how long the MCP gets to answer FRAME_BAUD
+#define SER_TUNE_PING_MS	100	// ...and each FRAME_PING; 27 ms of it is wire at 9600
+
+typedef enum SerTuneState {
+	TUNE_IDLE,		// not paired in frames since the port came up
+	TUNE_ASKED,		// sent FRAME_BAUD, waiting for FRAME_BAUD_ACK
+	TUNE_PINGING,		// timing round trips at the port's rate
+	TUNE_REVERTING,		// a rate didn't work; waiting out the MCP's going back to the base rate
+	TUNE_DONE
+} SerTuneState;
+
+/* Working out how fast the MCP can go, and how long a round trip takes */
+typedef struct SerTune {
+	SerTuneState State;
+	int Try;			// the rate to ask for next
+	uint64_t DeadlineNs;
+	int Pings;			// answered so far
+	uint64_t SentNs;
+	uint64_t RttNs[SERLINK_PINGS];
+	unsigned long Garbage;		// Parser.Skipped + BadCrc when last looked
+	uint64_t RttP50Ns;		// the result, 0 if the MCP doesn't answer pings
+	unsigned long Failed;		// rates that didn't work
+} SerTune;
 
 typedef struct SerData {
-        int StatusByte;
+	MsgQueue In;		// MCP -> main(), Code is the FrameType; wakes main()'s reactor
+	MsgQueue Out;		// main() -> MCP, RESP_RANG_IN/RESP_TIMED_OUT to pass on
+	FrameParser Parser;
+	SerRing Rx;		// what the MCP sent, until it's parsed
+	SerLink Link;		// the port, reopened whenever it comes back
+	SerOut Tx;		// what's going to the MCP, out in one write() per wakeup
+	FrameSeq RxSeq;
+	uint16_t TxSeq;
+	SerTune Tune;
 } SerData;
 
-typedef struct P1Data {
-	int P1Cmd;
-	int P1Resp;
-} P1Data;
-
-typedef struct P2Data {
-	int P2Byte;
-} P2Data;
+/* State main()'s reactor handlers share */
+typedef struct MainData {
+	Game *Game;
+	SerData *Ser;
+	int EnablerFd;		// the scanner's watch eventfd, or -1
+	int InterruptFd;	// our Cancel listener
+	int EdgeFd;		// chardev line request for the Enabler, the operator interrupt and any button on either, or -1
+	uint32_t InterruptsSeen;
+	uint64_t LastLatTotal;
+	uint64_t LastCountdowns;
+} MainData;
 
-typedef struct P3Data {
-	int P3Byte;
-} P3Data;
-
-int ShowCountdown(int Player, int Second);
-int GetPlayerRingin(int PlayerInput, RPiGPIOPin playerLED);
 int TTLOpen();
 int TTLClose();
 int TTLRead();
 int TTLWrite();
 
-void ClearCountdownLights(int player);
-
 void *SerialThread(void *thread);
-void *Player1Thread(void *thread);
-void *Player2Thread(void *thread);
-void *Player3Thread(void *thread);
+static void SerialSend(SerData *ser, uint8_t type, const void *payload, uint8_t len);
+static void SerialFlush(SerData *ser);
+static void SerialSendMsg(SerData *ser, const Msg *m);
+static void SerialHandleFrame(SerData *ser, const Frame *f, uint64_t arrivedns);
+static void SerialHello(SerData *ser);
+static void SerialTuneStart(SerData *ser);
+static void SerialTuneFrame(SerData *ser, const Frame *f, uint64_t arrivedns);
+static void SerialTuneService(SerData *ser, uint64_t now);
+static int SerialTuneTimeout(const SerData *ser);
+void *ScannerThread(void *thread);
+
+void OnEnabler(int fd, uint32_t events, void *ctx);
+void OnInterrupt(int fd, uint32_t events, void *ctx);
+void OnInputEdges(int fd, uint32_t events, void *ctx);
+void OnSerial(int fd, uint32_t events, void *ctx);
+void OnStatsTimer(int fd, uint32_t events, void *ctx);
+void OnSignal(int fd, uint32_t events, void *ctx);
+void ReportCountdowns(MainData *md);
 
-void InterruptDelay(int milliseconds, bool selftest);
 void CheckIfRoot();
 void CleanupAndClose();
 
-int main()
+static const char *SimOutputPath = NULL;
+static const char *InputChip = NULL;
+static const char *TracePath = "jeopardy.trace";
+static const char *SerialPath = SERLINK_DEFAULT_PATH;	// the MCP, -S
+static int SerialMaxBaud = SERLINK_BASE_BAUD;		// the fastest we'll ask it for, -b
+static uint64_t TraceRecords = TRACE_DEFAULT_RECORDS;
+
+/* Polled inputs are all read from one GPLEV0 snapshot by ScannerThread() */
+static Scanner Scan;
+static TieBreak ScanPolicy = TIEBREAK_LOWEST;
+static uint32_t ScanSeed = 1;
+static uint64_t ScanIntervalNs = 100000;
+static const char *DebounceSpec = "500";	// settle time in us for every input, then any gpio=usec
+
+/* Every thread main() starts reports in here before the game starts */
+static ReadyBarrier Startup;
+static int SelfTestMs = 200;		// how long each group of lights stays on in the self test
+
+/* The operator interrupt cuts every pending wait short */
+static Cancel Operator;
+
+static int PenaltyMs = PENALTY_DEFAULT_MS;	// early ring-in penalty, until the MCP says otherwise
+
+static LogLevel ConsoleLevel = LOG_DEBUG;	// what the player and serial threads print, -l
+static int ConsoleRate = LOG_DEFAULT_RATE;
+
+/* One row per podium. Override with -m for more (or different) podiums. */
+#ifdef MODEL_BPLUS
+static PlayerPins PinMap[MAX_PLAYERS] = {
+	{ INPUT1, P1_LED, P1_ENABLE },
+	{ INPUT2, P2_LED, P2_ENABLE },
+	{ INPUT3, P3_LED, P3_ENABLE },
+};
+#else
+static PlayerPins PinMap[MAX_PLAYERS] = {
+	{ INPUT1, P1_LED, PIN_NONE },
+	{ INPUT2, P2_LED, PIN_NONE },
+	{ INPUT3, P3_LED, PIN_NONE },
+};
+#endif
+static int PlayerCount = 3;
+static PlayerEngine Engine;
+static Game Round;
+
+static MainData *MainPtr = NULL;	// for CleanupAndClose()
+static int SignalFd = -1;		// ^C and SIGUSR1, read in main()'s reactor
+
+#define STATS_INTERVAL_NS 30000000000ull	// how often main() reports latency while the game is running
+
+int main(int argc, char *argv[])
 {
-	/* Hook ^C */
-	signal(SIGINT, CleanupAndClose);
+	int opt;
+
+	while((opt = getopt(argc, argv, "g:i:o:c:t:u:d:m:r:s:p:l:S:b:R")) != -1)
+	{
+		switch(opt)
+		{
+			case 'g':
+				if(GPIOSelectBackend(optarg) != 0)
+					return 1;
+				break;
+			case 'i':
+				if(SimLoadScript(optarg) < 0)
+					return 1;
+				break;
+			case 'o':
+				SimOutputPath = optarg;
+				break;
+			case 'c':
+				InputChip = optarg;
+				break;
+			case 't':
+				if(ScannerParsePolicy(optarg, &ScanPolicy, &ScanSeed) != 0)
+					return 1;
+				break;
+			case 'u':
+				ScanIntervalNs = strtoull(optarg, NULL, 0) * 1000ull;
+				break;
+			case 'd':
+				DebounceSpec = optarg;
+				break;
+			case 'm':
+				PlayerCount = PlayerParsePinMap(optarg, PinMap, MAX_PLAYERS);
+				if(PlayerCount < MIN_PLAYERS)
+					return 1;
+				break;
+			case 'r':
+				TracePath = optarg;
+				if(strchr(optarg, ':') != NULL)
+				{
+					TracePath = strndup(optarg, strchr(optarg, ':') - optarg);
+					TraceRecords = strtoull(strchr(optarg, ':') + 1, NULL, 0);
+				}
+				if(strcmp(TracePath, "none") == 0)
+					TracePath = NULL;
+				break;
+			case 's':
+				SelfTestMs = atoi(optarg);
+				break;
+			case 'p':
+				PenaltyMs = atoi(optarg);
+				break;
+			case 'l':
+				if(LogParse(optarg, &ConsoleLevel, &ConsoleRate) != 0)
+					return 1;
+				break;
+			case 'S':
+				SerialPath = optarg;
+				break;
+			case 'b':
+				SerialMaxBaud = atoi(optarg);
+				if(!SerLinkBaudSupported(SerialMaxBaud))
+				{
+					printf("main(): can't run the MCP link at %s baud; 9600, 19200, 38400, 57600, 115200, 230400, 460800, 500000, 921600 or 1000000\n", optarg);
+					return 1;
+				}
+				break;
+			case 'R':
+				RtMode = true;
+				break;
+			default:
+				printf("usage: %s [-g bcm2835|sim] [-i sim-script] [-o sim-output-log] [-c /dev/gpiochipN] [-t lowest|rotate|random[:seed]] [-u scan-usec] [-d usec[,gpio=usec...]] [-m in:led:enable,...] [-r trace-file[:records]|none] [-s self-test-ms] [-p penalty-ms] [-l error|warn|info|debug[:lines-per-sec]] [-S serial-device] [-b max-baud] [-R]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	/* ^C and SIGUSR1 are read through a signalfd in the reactor, so the
+	   cleanup runs on main() and not in a handler on whichever thread the
+	   signal landed. Block them before any thread (the logger's first)
+	   is started; a ^C during the self test waits for the reactor. */
+	sigset_t Signals;
+
+	sigemptyset(&Signals);
+	sigaddset(&Signals, SIGINT);
+	sigaddset(&Signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &Signals, NULL);
+	SignalFd = signalfd(-1, &Signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	/* the threads print through the logger from here on, main() stays on printf() */
+	if(LogStart(stdout, ConsoleLevel, ConsoleRate) != 0)
+		printf("main(): couldn't start the logger thread, the player and serial threads will be quiet\n");
+
+	/* Start the event trace before anything moves, so it has the self test too */
+	if(TracePath != NULL && TraceOpen(TracePath, TraceRecords) != 0)
+		printf("main(): carrying on without an event trace\n");
 
 	/* Clear screen and display startup text */
 	printf("\033[H\033[J");
@@ -156,216 +371,433 @@ int main()
 	printf("main(): Compiled for 40-pin Model B+. Countdown timer is enabled.\n");
 #endif
 
-        uint8_t lockout, value1, value2, value3;
-        int P1Lockout, P2Lockout, P3Lockout;
+	uint64_t StartNs = MonotonicNs();
+	uint32_t LedMask, BarMask;
 
 	pthread_t ser;
-	SerData *DataReadPtr = malloc(sizeof(SerData));
-	SerData DataRead;
+	SerData *DataReadPtr = aligned_alloc(64, sizeof(SerData));
+
+	pthread_t scan;
+	uint8_t ScanPins[MAX_PLAYERS];
+	bool UseScanner;
+	int i;
 
-	pthread_t p1;
-	P1Data *P1ReadPtr = malloc(sizeof(P1Data));
-	P1Data P1DataRead;
+	Reactor reactor;
+	MainData md;
+	CancelWait SelfTest;
+	int StatsTimerFd;
 
 	/* Check if current UID is the ROOT_UID */
 	CheckIfRoot();
 
+	/* -R: lock memory and share out the CPUs before any thread starts */
+	RtSetup();
+
+	printf("main(): Using GPIO backend %s\n", GPIO->Name);
+
+	if(PlayerEngineInit(&Engine, PinMap, PlayerCount) != 0)
+		return 1;
+
 	/* if we fail to init gpio, terminate */
-        if(!bcm2835_init())
+        if(!GPIOInit())
                 return 1;
 
-	InterruptDelay(750, true);
-
         /* Set up the GPIO pins for input */
 	printf("main(): Setting up GPIO input... ");
 
-	bcm2835_gpio_fsel(INPUT1, BCM2835_GPIO_FSEL_INPT);
-        bcm2835_gpio_set_pud(INPUT1, BCM2835_GPIO_PUD_UP);
-	printf("INPUT1 ");
+	for(i = 0; i < Engine.Count; i++)
+	{
+		GPIOFSel(PinMap[i].Input, BCM2835_GPIO_FSEL_INPT);
+		GPIOSetPud(PinMap[i].Input, BCM2835_GPIO_PUD_UP);
+		printf("INPUT%d ", i + 1);
+	}
 
-        bcm2835_gpio_fsel(INPUT2, BCM2835_GPIO_FSEL_INPT);
-        bcm2835_gpio_set_pud(INPUT2, BCM2835_GPIO_PUD_UP);
-	printf("INPUT2 ");
+	GPIOFSel(ENABLER, BCM2835_GPIO_FSEL_INPT);
+	GPIOSetPud(ENABLER, BCM2835_GPIO_PUD_UP);
+	printf("ENABLER ");
 
-        bcm2835_gpio_fsel(INPUT3, BCM2835_GPIO_FSEL_INPT);
-        bcm2835_gpio_set_pud(INPUT3, BCM2835_GPIO_PUD_UP);
-	printf("INPUT3 ");
+	GPIOFSel(OPERATOR_INTERRUPT, BCM2835_GPIO_FSEL_INPT);
+	GPIOSetPud(OPERATOR_INTERRUPT, BCM2835_GPIO_PUD_UP);
+	printf("OPERATOR_INTERRUPT ");
 
 	printf("- OK\n");
 
-        /* Set up the GPIO pins for LED output &
-           perform a self-test of all LEDs */
-	printf("main(): Setting up GPIO Outputs... ");
+	for(i = 0; i < Engine.Count; i++)
+	{
+		if(PinMap[i].Input == ENABLER)
+			printf("main(): NOTE: Player %d's button is also the Enabler\n", i + 1);
+	}
 
-	printf("P1_LED ");
-        bcm2835_gpio_fsel(P1_LED, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P1_LED, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P1_LED, LOW);
+	/* Set up the GPIO pins for output. The self test lights them once
+	   every thread is on its way up; see below. */
+	printf("main(): Setting up GPIO Outputs... ");
 
-	printf("P2_LED ");
-	bcm2835_gpio_fsel(P2_LED, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P2_LED, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P2_LED, LOW);
+	LedMask = 0;
+	for(i = 0; i < Engine.Count; i++)
+	{
+		if(PinMap[i].Led == PIN_NONE)
+			continue;
 
-	printf("P3_LED ");
-        bcm2835_gpio_fsel(P3_LED, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P3_LED, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P3_LED, LOW);
+		printf("P%d_LED ", i + 1);
+		GPIOFSel(PinMap[i].Led, BCM2835_GPIO_FSEL_OUTP);
+		LedMask |= GPIOBit(PinMap[i].Led);
+	}
 
 	printf("LOCKOUT_ASSERT ");
-	bcm2835_gpio_fsel(LOCKOUT_ASSERT, BCM2835_GPIO_FSEL_OUTP);
-	InterruptDelay(750, true);
+	GPIOFSel(LOCKOUT_ASSERT, BCM2835_GPIO_FSEL_OUTP);
+
+	BarMask = 0;
+#ifdef MODEL_BPLUS
+	printf("TIME_X ");
+	GPIOFSel(TIME_1, BCM2835_GPIO_FSEL_OUTP);
+	GPIOFSel(TIME_2, BCM2835_GPIO_FSEL_OUTP);
+	GPIOFSel(TIME_3, BCM2835_GPIO_FSEL_OUTP);
+	GPIOFSel(TIME_4, BCM2835_GPIO_FSEL_OUTP);
+	GPIOFSel(TIME_5, BCM2835_GPIO_FSEL_OUTP);
+	BarMask = GPIOBit(TIME_1) | GPIOBit(TIME_2) | GPIOBit(TIME_3) | GPIOBit(TIME_4) | GPIOBit(TIME_5);
+
+	for(i = 0; i < Engine.Count; i++)
+	{
+		if(PinMap[i].Enable == PIN_NONE)
+			continue;
+
+		printf("P%d_ENABLE ", i + 1);
+		GPIOFSel(PinMap[i].Enable, BCM2835_GPIO_FSEL_OUTP);
+		BarMask |= GPIOBit(PinMap[i].Enable);
+	}
+#endif
 
 	printf("- OK\n");
 
-	printf("main(): Start test of player countdowns timers... ");
+	if(ReactorInit(&reactor) != 0)
+		return 1;
+	if(GameInit(&Round, &Engine, &DataReadPtr->Out, COUNTDOWN_STEP_NS) != 0)
+		return 1;
+	GameSetPenalty(&Round, PenaltyMs);
 
-	printf("TIME_X ");
-	bcm2835_gpio_fsel(TIME_1, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_fsel(TIME_2, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_fsel(TIME_3, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_fsel(TIME_4, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_fsel(TIME_5, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(TIME_1, HIGH);
-	bcm2835_gpio_write(TIME_2, HIGH);
-	bcm2835_gpio_write(TIME_3, HIGH);
-	bcm2835_gpio_write(TIME_4, HIGH);
-	bcm2835_gpio_write(TIME_5, HIGH);
-
-	printf("P1_ENABLE ");
-	bcm2835_gpio_fsel(P1_ENABLE, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P1_ENABLE, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P1_ENABLE, LOW);
-
-	printf("P2_ENABLE ");
-	bcm2835_gpio_fsel(P2_ENABLE, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P2_ENABLE, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P2_ENABLE, LOW);
-
-	printf("P3_ENABLE ");
-	bcm2835_gpio_fsel(P3_ENABLE, BCM2835_GPIO_FSEL_OUTP);
-	bcm2835_gpio_write(P3_ENABLE, HIGH);
-	InterruptDelay(750, true);
-	bcm2835_gpio_write(P3_ENABLE, LOW);
-
-	bcm2835_gpio_write(TIME_1, LOW);
-	bcm2835_gpio_write(TIME_2, LOW);
-	bcm2835_gpio_write(TIME_3, LOW);
-	bcm2835_gpio_write(TIME_4, LOW);
-	bcm2835_gpio_write(TIME_5, LOW);
-
-	printf("- OK\n\n");
+	memset(&md, 0, sizeof(md));
+	md.Game = &Round;
+	md.Ser = DataReadPtr;
+	md.EnablerFd = -1;
+	md.EdgeFd = -1;
+	MainPtr = &md;
+
+	/* everyone who waits on the operator interrupt signs up before
+	   anything that can raise it is started */
+	CancelInit(&Operator);
+	md.InterruptFd = CancelListen(&Operator);
+	CancelWaitInit(&SelfTest, &Operator);
 
+	/* each thread is counted as it's started and checks in once it's up */
+	ReadyInit(&Startup, 0);
 
 	printf("main(): Starting serial port thread...\n");
-	pthread_create(&ser, NULL, SerialThread, DataReadPtr);
+	memset(DataReadPtr, 0, sizeof(SerData));
+	MsgQueueInit(&DataReadPtr->In, ReactorEventFd());
+	MsgQueueInit(&DataReadPtr->Out, ReactorEventFd());
+	FrameParserInit(&DataReadPtr->Parser);
+	SerRingInit(&DataReadPtr->Rx);
+	DataReadPtr->Link.Fd = -1;
+	ReadyExpect(&Startup, 1);
+	RtThreadCreate(&ser, RT_SERIAL, SerialThread, DataReadPtr);
+
+	UseScanner = true;
+	if(InputChip != NULL)
+	{
+		uint8_t mainpins[2] = { ENABLER, OPERATOR_INTERRUPT }, lines[MAX_PLAYERS + 2];
+		int count;
 
-	printf("main(): Starting Player 1 input thread...\n");
-	pthread_create(&p1, NULL, Player1Thread, P1ReadPtr);
+		/* a line can only be requested once: main() takes the Enabler's,
+		   the operator interrupt's and any a podium shares with them */
+		count = PlayerEngineShareLines(&Engine, mainpins, 2, lines);
 
-	printf("main(): Waiting for other threads to complete spawning...\n");
-	InterruptDelay(5000, true);
+		printf("main(): Requesting edge events for %d players, the Enabler and the operator interrupt from %s... ", Engine.Count, InputChip);
+		UseScanner = false;
+		for(i = 0; i < Engine.Count; i++)
+		{
+			if(Engine.Players[i].Relayed)
+				continue;
+			Engine.Players[i].InputFd = CdevOpen(InputChip, &PinMap[i].Input, 1);
+			if(Engine.Players[i].InputFd == -1)
+				UseScanner = true;
+		}
+		md.EdgeFd = CdevOpen(InputChip, lines, count);
+		if(md.EdgeFd == -1)
+			UseScanner = true;
 
-	printf("main(): Sanity check: Read StatusByte from SerialThread, should be 1337: %d\n", DataReadPtr->StatusByte);
-	printf("main(): Sanity check: Read P1Cmd from Player1Thread, should be 1337: %d\n", P1ReadPtr->P1Cmd);
-	printf("main(): Sanity check: Read P1Resp from Player1Thread, should be 420: %d\n", P1ReadPtr->P1Resp);
+		if(UseScanner)
+		{
+			printf("main(): falling back to the input scanner\n");
+			for(i = 0; i < Engine.Count; i++)
+			{
+				CdevClose(Engine.Players[i].InputFd);
+				Engine.Players[i].InputFd = -1;
+				Engine.Players[i].Relayed = false;
+			}
+			CdevClose(md.EdgeFd);
+			md.EdgeFd = -1;
+		}
+		else
+		{
+			printf("- OK\n");
+			for(i = 0; i < Engine.Count; i++)
+				if(Engine.Players[i].Relayed)
+					printf("main(): Player %d's button shares a line, main() passes its edges on\n", i + 1);
+		}
+	}
+
+	if(UseScanner)
+	{
+		printf("main(): Starting input scanner thread...\n");
+		for(i = 0; i < Engine.Count; i++)
+			ScanPins[i] = PinMap[i].Input;
+		ScannerInit(&Scan, ScanPins, Engine.Count, ScanPolicy, ScanSeed);
+
+		/* The scanner wakes the player threads and main() when their bits change */
+		for(i = 0; i < Engine.Count; i++)
+		{
+			Engine.Players[i].Scan = &Scan;
+			Engine.Players[i].WakeFd = ReactorEventFd();
+			Scan.WakeFd[i] = Engine.Players[i].WakeFd;
+		}
+		md.EnablerFd = ReactorEventFd();
+		ScannerWatch(&Scan, ENABLER, md.EnablerFd);
+
+		/* the scanner raises the operator interrupt itself, the snapshot
+		   it sees the switch go down in */
+		ScannerCancelOn(&Scan, OPERATOR_INTERRUPT, &Operator);
+
+		/* contact bounce is filtered out before anyone sees a press */
+		if(DebounceParse(&Scan.Filter, DebounceSpec, Scan.PlayerMask | Scan.WatchMask | Scan.CancelMask, ScanIntervalNs) != 0)
+			return 1;
+		for(i = 0; i < Engine.Count; i++)
+			printf("main(): Player %d's input settles in %d samples\n", i + 1, DebounceGetPin(&Scan.Filter, PinMap[i].Input));
+		printf("main(): The Enabler settles in %d samples\n", DebounceGetPin(&Scan.Filter, ENABLER));
+		printf("main(): The operator interrupt settles in %d samples\n", DebounceGetPin(&Scan.Filter, OPERATOR_INTERRUPT));
+
+		ReadyExpect(&Startup, 1);
+		RtThreadCreate(&scan, RT_SCANNER, ScannerThread, &Scan);
+	}
+
+	printf("main(): Starting %d player input threads...\n", Engine.Count);
+	for(i = 0; i < Engine.Count; i++)
+		Engine.Players[i].Started = &Startup;
+	ReadyExpect(&Startup, Engine.Count);
+	if(PlayerEngineStart(&Engine) != 0)
+		return 1;
+
+	/* The self test runs while the threads come up: every podium LED at
+	   once, then every lightbar and countdown enable at once. The
+	   operator interrupt skips the rest of it (polled inputs only; edge
+	   events are read by the reactor, which isn't running yet). */
+	if(SelfTestMs > 0)
+	{
+		printf("main(): Self test: podium LEDs, %d ms\n", SelfTestMs);
+		GPIOWriteMask(LedMask, 0);
+		i = InterruptDelay(&SelfTest, SelfTestMs);
+		GPIOWriteMask(0, LedMask);
+
+		if(BarMask != 0 && !i)
+		{
+			printf("main(): Self test: countdown lightbars and enables, %d ms\n", SelfTestMs);
+			GPIOWriteMask(BarMask, 0);
+			InterruptDelay(&SelfTest, SelfTestMs);
+			GPIOWriteMask(0, BarMask);
+		}
+	}
+
+	printf("main(): Waiting for the other threads to report ready...\n");
+	if(ReadyWait(&Startup, READY_TIMEOUT_MS) > 0)
+	{
+		for(i = 0; i < Engine.Count; i++)
+			if(atomic_load(&Engine.Players[i].Ready) == 0)
+				printf("main(): Player %d's thread never reported ready\n", i + 1);
+	}
+	printf("main(): Up in %llu ms\n", (unsigned long long)((MonotonicNs() - StartNs) / 1000000));
 
 	printf("\amain(): !!! MAKE SURE YOU TEST PLAYER INPUTS BEFORE STARTING GAME !!!\n\nmain(): Good luck - here we go, into the Jeopardy round...\n\n");
 
-	printf("main(): debug: using interval %d as divisor for InterruptDelay(). Change MS_DIVISOR to change sampling rate.\n\n", MS_DIVISOR); 
+	/* Everything from here on is event driven: main() sleeps in the reactor
+	   until the Enabler moves, a player thread or the MCP has something for
+	   us, or the stats timer fires. */
+	StatsTimerFd = ReactorTimerFd();
+	ReactorArmTimer(StatsTimerFd, STATS_INTERVAL_NS, STATS_INTERVAL_NS);
 
-	while(1)
-        {
-                /* Set these variables to 0 so we start fresh
-                   every time the Enabler switch is turned on */
-                P1Lockout = 0;
-                P2Lockout = 0;
-                P3Lockout = 0;
+	if(md.EdgeFd >= 0)
+		ReactorAdd(&reactor, md.EdgeFd, OnInputEdges, &md);
+	else
+		ReactorAdd(&reactor, md.EnablerFd, OnEnabler, &md);
+	ReactorAdd(&reactor, md.InterruptFd, OnInterrupt, &md);
+	GameAttach(&Round, &reactor);
+	ReactorAdd(&reactor, DataReadPtr->In.WakeFd, OnSerial, &md);
+	ReactorAdd(&reactor, StatsTimerFd, OnStatsTimer, &md);
+	ReactorAdd(&reactor, SignalFd, OnSignal, &reactor);
 
-                lockout = bcm2835_gpio_lev(INPUT3); //temporarily use player 3's input test button while I test this program
+	/* pick up whatever the Enabler is set to right now */
+	OnEnabler(md.EnablerFd, 0, &md);
 
-//		printf("main(): lockout current status: %d\n", lockout);
+	RtApplySelf(RT_MAIN);
 
-		switch(lockout)
-		{
-			case 0: //Enabler Switch is Active (player showtime!)
-				bcm2835_gpio_write(P3_LED, HIGH);
+	ReactorRun(&reactor);
 
-				//InterruptDelay(250, false); //software debounce
-				//if(lockout == 0)
-				//{
-					P1ReadPtr->P1Cmd = 3;
+	/* ^C (or the reactor giving up): the other threads run on till we
+	   exit, so DataReadPtr stays put */
+	CleanupAndClose();
+	ReactorClose(&reactor);
+	return 0;
+}
 
-				//	if(P1ReadPtr->P1Resp == 1) //Player 1 thread reported ring-in!
-				//	{
-						//P1ReadPtr->P1Cmd = 5; //Tell Player 1 thread that it's safe to start ringing in now
-				//	}
-				//}
+void OnEnabler(int fd, uint32_t events, void *ctx)
+{
+	MainData *md = (MainData *)ctx;
+	uint8_t lockout;
+	uint64_t EdgeNs;
 
-				break;
-			case 1: //Enabler Switch is Inactive (penalize early ring-in)
-				bcm2835_gpio_write(P3_LED, LOW);
+	if(md->EdgeFd >= 0)
+	{
+		/* edges come through OnInputEdges(); this is the level at startup */
+		lockout = md->Game->Lockout == -1 ? GPIOLev(ENABLER) : md->Game->Lockout;
+		EdgeNs = ClockNow();
+	}
+	else
+	{
+		ReactorDrain(fd);
+		lockout = ScannerPinLev(&Scan, ENABLER);
+		EdgeNs = ScannerWatchNs(&Scan);
+		if(EdgeNs == 0)
+			EdgeNs = ClockNow();
+	}
 
-				//also, send the lockout cmd to the player threads
-				P1ReadPtr->P1Cmd = 4;
+	GameEnabler(md->Game, lockout, EdgeNs);
+}
 
-				//check to see if the player rang-in early, if so penalize them
-				//if(P1ReadPtr->P1Resp == 1)
-				//{
-					//P1ReadPtr->P1Cmd == 2;
-				//}
+void OnInterrupt(int fd, uint32_t events, void *ctx)
+{
+	MainData *md = (MainData *)ctx;
+	uint32_t raised;
 
+	/* raised already, and every wait woken, by the scanner or
+	   OnInputEdges() */
+	ReactorDrain(fd);
 
+	raised = atomic_load(&Operator.Raised);
+	if(raised == md->InterruptsSeen)
+		return;
+	md->InterruptsSeen = raised;
 
-				break;
-			default:
-				break;
-		}
+	printf("main(): Operator interrupt - putting out the countdowns and lifting penalties\n");
+	GameInterrupt(md->Game, atomic_load(&Operator.RaisedNs));
+}
 
+/* Edge events on the lines main() requested: the Enabler, the operator
+   interrupt, and any podium's button on one of them, passed on to its
+   thread as it would have read them itself */
+void OnInputEdges(int fd, uint32_t events, void *ctx)
+{
+	MainData *md = (MainData *)ctx;
+	PlayerEngine *pe = md->Game->Engine;
+	InputEdge edges[16];
+	Msg m = { 0 };
+	uint8_t lockout = 0;
+	uint64_t EdgeNs = 0;
+	int n, i, j;
+
+	m.Code = CMD_INPUT_EDGE;
+	while((n = CdevWaitEdges(fd, -1, 0, edges, 16)) > 0)
+	{
+		for(i = 0; i < n; i++)
+		{
+			TraceLogAt(edges[i].TimeNs, TRACE_EDGE, 0, edges[i].Pin, edges[i].Level, 0);
+			for(j = 0; j < pe->Count; j++)
+			{
+				if(!pe->Players[j].Relayed || pe->Players[j].Pins.Input != edges[i].Pin)
+					continue;
+				m.Player = j + 1;
+				m.Arg = edges[i].Level;
+				m.Seq = edges[i].Seqno;
+				m.TimeNs = edges[i].TimeNs;
+				MsgQueueSend(&pe->Players[j].Cmd, &m);
+			}
 
-                //bcm2835_gpio_write(ENABLER_LED, LOW);
+			/* the Enabler takes the level after the last edge in the batch */
+			if(edges[i].Pin == ENABLER)
+			{
+				lockout = edges[i].Level;
+				EdgeNs = edges[i].TimeNs;
+			}
+			if(edges[i].Pin == OPERATOR_INTERRUPT && edges[i].Level == 0)
+				CancelRaise(&Operator, edges[i].TimeNs);
+		}
+	}
 
-		/* bcm2835 returns 1 when digital input is not triggered,
-		   so this code will execute when the Enabler is inactive */
-		//while(lockout)
-		//{
-			/* In this block we'll punish players for ringing in too early with a 1/4 second
-			   early ring-in penalty. */
+	if(EdgeNs != 0)
+		GameEnabler(md->Game, lockout, EdgeNs);
+	OnInterrupt(md->InterruptFd, events, md);
+}
 
-			//P1ReadPtr->P1Byte = 4;
-		//	if(P1ReadPtr->P1Byte == 1)
-		//	{
-				// Enforce early ring-in penalty
-		//		P1ReadPtr->P1Byte == 2;
-		//	}
+void OnSerial(int fd, uint32_t events, void *ctx)
+{
+	MainData *md = (MainData *)ctx;
+	Msg in;
 
-			//bcm2835_gpio_write(P3_LED, LOW);
+	ReactorDrain(fd);
+	while(MsgQueuePop(&md->Ser->In, &in))
+	{
+		switch(in.Code)
+		{
+			case FRAME_COUNTDOWN_END:
+				printf("main(): MCP ended Player %d's countdown\n", in.Player);
+				GameCountdownEnd(md->Game, in.Player, in.TimeNs);
+				break;
+			case FRAME_PENALTY:
+				printf("main(): early ring-in penalty is %d ms from the next Enabler edge\n", in.Arg);
+				GameSetPenalty(md->Game, in.Arg);
+				break;
+			case FRAME_PAIR_REQ:
+				printf("main(): paired with MCP\n");
+				break;
+			default:
+				break;
+		}
+	}
+}
 
-		//}
+void OnStatsTimer(int fd, uint32_t events, void *ctx)
+{
+	MainData *md = (MainData *)ctx;
 
-                /* bcm2835 returns 0 when a digital input is triggered,
-		   so this code gets executed when the Enabler is active */
-                //while(!lockout)
-                //{
-                        //value3 = bcm2835_gpio_lev(INPUT3);
-			/* Write the new code to handle multithreaded player input here. */
+	ReactorDrain(fd);
 
-			//P1ReadPtr->P1Byte = 3;
+	/* stay quiet unless something has been timed since the last report */
+	if(LatTotal() != md->LastLatTotal)
+	{
+		md->LastLatTotal = LatTotal();
+		LatDump(stdout);
+	}
+	if(md->Game->Countdowns.Started != md->LastCountdowns)
+		ReportCountdowns(md);
+}
 
-		//	bcm2835_gpio_write(P3_LED, HIGH);
-                //}
-        }
+void OnSignal(int fd, uint32_t events, void *ctx)
+{
+	Reactor *r = (Reactor *)ctx;
+	struct signalfd_siginfo si;
 
-	printf("main(): freeing pointer to SerialThread->DataReadPtr\n");
-	free(DataReadPtr);
+	while(read(fd, &si, sizeof(si)) == sizeof(si))
+	{
+		/* ^C ends the reactor loop, and main() cleans up after it */
+		if(si.ssi_signo == SIGINT)
+			r->Stop = true;
+		/* kill -USR1 <pid> dumps the latency histograms */
+		else if(si.ssi_signo == SIGUSR1)
+			LatDump(stdout);
+	}
+}
 
-        bcm2835_close();
-        return 0;
+void ReportCountdowns(MainData *md)
+{
+	md->LastCountdowns = md->Game->Countdowns.Started;
+	GameReport(md->Game, stdout);
 }
 
 int TTLOpen()
@@ -398,489 +830,462 @@ int TTLRead()
 	return 0;
 }
 
-int ShowCountdown(int Player, int Second)
+void *SerialThread(void *thread)
 {
-	/* This function supersedes GetPlayerRingIn() as it's more generalized to enable the multi-thread expansion.
-	   Still does pretty much the same thing though; sets the appropriate player LED(s) high to show a countdown feature.*/
+	SerData *statbyte=(SerData *)thread;
+	SerLink *link = &statbyte->Link;
+
+	int i, spans;
+	struct pollfd wait[2];
+	const uint8_t *span[2];
+	size_t spanlen[2];
+	ssize_t got;
+	uint64_t woke, arrived;
+	unsigned long dropped = 0;
+	Frame frame;
+	Msg out;
+
+	LogPrintf(LOG_DEBUG, "SerialThread(): Hello from our serial thread!\n");
+
+	/* If it isn't there we carry on without it and pick it up when it
+	   turns up, rather than give up on the MCP for the whole show */
+	SerLinkInit(link, SerialPath);
+	SerOutInit(&statbyte->Tx);
+	if(SerLinkOpen(link))
+	{
+		LogPrintf(LOG_DEBUG, "SerialThread(): Opened %s at %dBPS 8N1 - OK\n", SerialPath, link->Baud);
+		SerialHello(statbyte);
+	}
+	else
+		LogPrintf(LOG_ERROR, "SerialThread(): failed to open %s - error %d %s; waiting for it to turn up\n",
+			SerialPath, link->LastErrno, strerror(link->LastErrno));
 
-#ifdef MODEL_AB
-	/* I might drop support for the old 26-pin devices... */
-#endif
-#ifdef MODEL_BPLUS
-	printf("ShowCountdown(): Showing countdown for Player %d, Second %d\n", Player, Second);
+	LogPrintf(LOG_DEBUG, "SerialThread(): All serial setup complete, entering data loop\n");
+	LogPrintf(LOG_DEBUG, "SerialThread(): TODO!!!!!!!!! Give me a way to exit this loop and kill the thread gracefully\n");
+	ReadyArrive(&Startup, "SerialThread", SerLinkUp(link));
+
+	/* sleep until the MCP sends something, main() has something for it,
+	   or (while the port's gone) it might be back */
+	wait[1].fd = statbyte->Out.WakeFd;
+	wait[1].events = POLLIN;
 
-	switch(Player)
+	while(1)
 	{
-		case 1:
-			bcm2835_gpio_write(P1_ENABLE, HIGH);
-			break;
-		case 2:
-			bcm2835_gpio_write(P2_ENABLE, HIGH);
-			break;
-		case 3:
-			bcm2835_gpio_write(P3_ENABLE, HIGH);
-			break;
-		default:
-			printf("ShowCountdown(): WARNING: Tried to enable unknown Player %d\n", Player);
-			break;
+		/* first send anything main() has queued for the MCP, along with
+		   our answers to what it sent last time round, in one write()... */
+		while(MsgQueuePop(&statbyte->Out, &out))
+		{
+			if(SerLinkUp(link))
+				SerialSendMsg(statbyte, &out);
+			else if(dropped++ == 0)
+				LogPrintf(LOG_WARN, "SerialThread(): no MCP link, dropping what main() sends it until it's back\n");
+		}
+		if(SerLinkUp(link))
+			SerialFlush(statbyte);
+
+		wait[0].fd = SerLinkPollFd(link);
+		wait[0].events = POLLIN | (SerLinkUp(link) && SerOutPending(&statbyte->Tx) ? POLLOUT : 0);
+		wait[0].revents = 0;
+		if(poll(wait, 2, SerLinkUp(link) ? SerialTuneTimeout(statbyte) : SerLinkTimeout(link)) < 0)
+			continue;
+		woke = ClockNow();
+		if(wait[1].revents & POLLIN)
+			ReactorDrain(wait[1].fd);
+		if(SerLinkUp(link))
+			SerialTuneService(statbyte, woke);
+
+		if(!SerLinkUp(link))
+		{
+			if(SerLinkService(link))
+			{
+				LogPrintf(LOG_WARN, "SerialThread(): %s back after %llu ms, %lu messages for the MCP dropped; pairing again\n",
+					SerialPath, (unsigned long long)link->LastDownMs, dropped);
+				dropped = 0;
+				SerialHello(statbyte);
+			}
+			continue;
+		}
+		if(!(wait[0].revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+
+		/* ...then everything the MCP has sent, parsed in place in the ring */
+		got = SerRingRead(&statbyte->Rx, link->Fd, woke);
+		if(got < 0 || (got == 0 && (wait[0].revents & (POLLHUP | POLLERR))))
+		{
+			LogPrintf(LOG_ERROR, "SerialThread(): lost %s - %s, waiting for it to come back\n", SerialPath, got < 0 && errno != 0 ? strerror(errno) : "hung up");
+			SerLinkDrop(link);
+			SerOutDiscard(&statbyte->Tx);
+			continue;
+		}
+		spans = SerRingLast(&statbyte->Rx, got, span, spanlen);
+		for(i = 0; i < spans && got > 0; i++)
+			TraceBytes(TRACE_SERIAL_RX, span[i], spanlen[i]);
+
+		while(SerRingParse(&statbyte->Rx, &statbyte->Parser, &frame, &arrived))
+			SerialHandleFrame(statbyte, &frame, arrived);
+
+		/* noise above the base rate: mid-ping it's a rate that doesn't
+		   work, otherwise the MCP has most likely restarted at 9600 */
+		if(statbyte->Parser.Skipped + statbyte->Parser.BadCrc != statbyte->Tune.Garbage)
+		{
+			statbyte->Tune.Garbage = statbyte->Parser.Skipped + statbyte->Parser.BadCrc;
+			if(link->Baud != SERLINK_BASE_BAUD && statbyte->Tune.State == TUNE_PINGING)
+				statbyte->Tune.DeadlineNs = woke;
+			else if(link->Baud != SERLINK_BASE_BAUD)
+			{
+				LogPrintf(LOG_WARN, "SerialThread(): garbage from MCP at %d baud, back to %d and pairing again\n", link->Baud, SERLINK_BASE_BAUD);
+				SerLinkSetBaud(link, SERLINK_BASE_BAUD);
+				SerialHello(statbyte);
+			}
+			SerialTuneService(statbyte, woke);
+		}
 	}
+}
+
+/* A fresh link: whatever was half-read is gone and the MCP may have
+   restarted, so start over and tell it we're here in both protocols,
+   the way it asks to pair */
+static void SerialHello(SerData *ser)
+{
+	FrameParserInit(&ser->Parser);
+	SerRingInit(&ser->Rx);
+	FrameSeqReset(&ser->RxSeq);
+	ser->Tune.State = TUNE_IDLE;
+	ser->Tune.Garbage = 0;
+
+	/* nothing still waiting was meant for this MCP */
+	SerOutDiscard(&ser->Tx);
+	SerialSend(ser, FRAME_READY, NULL, 0);
+}
+
+/* Queue a message for the MCP; it goes out with the rest at the next
+   SerialFlush(), or now if that's what it takes to make room */
+static bool SerialQueue(SerData *ser, uint8_t type, const void *payload, uint8_t len, uint64_t startns)
+{
+	if(SerOutPush(&ser->Tx, type, payload, len, ClockNow(), startns))
+		return true;
+
+	SerialFlush(ser);
+	if(SerOutPush(&ser->Tx, type, payload, len, ClockNow(), startns))
+		return true;
+
+	ser->Tx.Dropped++;
+	return false;
+}
 
-	switch(Second)
+static void SerialSend(SerData *ser, uint8_t type, const void *payload, uint8_t len)
+{
+	if(!SerialQueue(ser, type, payload, len, 0))
+		LogPrintf(LOG_WARN, "SerialThread(): MCP isn't taking what we send, frame type 0x%02x dropped\n", type);
+}
+
+/* Everything queued for the MCP in one write(), as frames or, until it
+   shows it speaks them, the old single bytes */
+static void SerialFlush(SerData *ser)
+{
+	SerOutMsg done[SEROUT_FLIGHT];
+	SerOut *o = &ser->Tx;
+	size_t from;
+	ssize_t got;
+	uint64_t now;
+	int i, n;
+
+	SerOutEncode(o, ser->Parser.Framed, &ser->TxSeq, (uint32_t)(ClockNow() / 1000));
+	from = o->Sent;
+	got = SerOutWrite(o, ser->Link.Fd);
+	if(got > 0)
+		TraceBytes(TRACE_SERIAL_TX, o->Buf + from, got);
+
+	/* only what's gone all the way: a message the port took part of,
+	   or none of, is timed on the wakeup that finishes it */
+	n = SerOutSent(o, done, SEROUT_FLIGHT);
+	now = ClockNow();
+	for(i = 0; i < n; i++)
 	{
-		case 5:
-			bcm2835_gpio_write(TIME_1, HIGH);
-			bcm2835_gpio_write(TIME_2, HIGH);
-			bcm2835_gpio_write(TIME_3, HIGH);
-			bcm2835_gpio_write(TIME_4, HIGH);
-			bcm2835_gpio_write(TIME_5, HIGH);
-			break;
-		case 4:
-			bcm2835_gpio_write(TIME_5, LOW);
-			break;
-		case 3:
-			bcm2835_gpio_write(TIME_4, LOW);
-			break;
-		case 2:
-			bcm2835_gpio_write(TIME_3, LOW);
-			break;
-		case 1:
-			bcm2835_gpio_write(TIME_2, LOW);
-			break;
-		case 0:
-			bcm2835_gpio_write(TIME_1, LOW);
-			bcm2835_gpio_write(TIME_4, LOW);
-			bcm2835_gpio_write(TIME_3, LOW);
-			bcm2835_gpio_write(TIME_2, LOW);
-			bcm2835_gpio_write(TIME_5, LOW);
-			break;
-		default:
-			printf("ShowCountdown(): Unknown Second %d\n", Second);
-			break;
+		LatRecord(LAT_SERIAL_TX, now - done[i].QueuedNs);
+		if(done[i].StartNs != 0)
+			LatRecord(LAT_SERIAL, now - done[i].StartNs);
 	}
-#endif
 }
 
-int GetPlayerRingin(int PlayerInput, RPiGPIOPin playerLED)
+static void SerialSendMsg(SerData *ser, const Msg *m)
 {
-        /* Return value of 1 is stored in the lockout ints in main()
-           so we can lock a player out until the Enabler is turned on
-           again */
-	printf("GetPlayerRingin(): Player %d rung in\n", PlayerInput);
-
-#ifdef MODEL_AB
-	/* Use the old single-LED indicator logic for 26-pin devices. */
-	bcm2835_gpio_write(LOCKOUT_ASSERT, HIGH);
-	bcm2835_gpio_write(playerLED, HIGH);
-	InterruptDelay(5000, false);
-	bcm2835_gpio_write(LOCKOUT_ASSERT, LOW);
-	bcm2835_gpio_write(playerLED, LOW);
-#endif
-#ifdef MODEL_BPLUS
-	/* Use the new multi-LED logic for 40-pin devices. */
+	uint8_t payload[6];
+	uint32_t pressus;
 
-	/* Check to see which player rang in and set their countdown
-	   enable relay appropriately. */
-	switch(PlayerInput)
+	switch(m->Code)
 	{
-		case 1:
-			bcm2835_gpio_write(P1_ENABLE, HIGH);
+		case RESP_RANG_IN:
+			LogPrintf(LOG_INFO, "SerialThread(): sending Player %d ring-in to MCP\n", m->Player);
+			pressus = (uint32_t)(m->TimeNs / 1000);
+			payload[0] = m->Player;
+			payload[1] = m->Arg;
+			payload[2] = pressus & 0xff;
+			payload[3] = (pressus >> 8) & 0xff;
+			payload[4] = (pressus >> 16) & 0xff;
+			payload[5] = pressus >> 24;
+			if(!SerialQueue(ser, FRAME_RINGIN, payload, 6, m->TimeNs))
+				LogPrintf(LOG_ERROR, "SerialThread(): MCP isn't taking what we send, Player %d ring-in dropped\n", m->Player);
 			break;
-		case 2:
-			bcm2835_gpio_write(P2_ENABLE, HIGH);
-			break;
-		case 3:
-			bcm2835_gpio_write(P3_ENABLE, HIGH);
+		case RESP_TIMED_OUT:
+			LogPrintf(LOG_INFO, "SerialThread(): sending Player %d time expired to MCP\n", m->Player);
+			payload[0] = m->Player;
+			SerialSend(ser, FRAME_TIMED_OUT, payload, 1);
 			break;
 		default:
-			printf("GetPlayerRingin(): WARNING: Tried to set unknown PlayerInput %d HIGH\n", PlayerInput);
 			break;
 	}
+}
 
-	/* Now turn on the countdown LEDs and start the countdown! */
-	bcm2835_gpio_write(TIME_1, HIGH);
-	bcm2835_gpio_write(TIME_2, HIGH);
-	bcm2835_gpio_write(TIME_3, HIGH);
-	bcm2835_gpio_write(TIME_4, HIGH);
-	bcm2835_gpio_write(TIME_5, HIGH);	/* O O O O O O O O O */
-	InterruptDelay(1000, false);
-
-	bcm2835_gpio_write(TIME_5, LOW);	/* - O O O O O O O - */
-	InterruptDelay(1000, false);
-
-	bcm2835_gpio_write(TIME_4, LOW);	/* - - O O O O O - - */
-	InterruptDelay(1000, false);
+static void SerialHandleFrame(SerData *ser, const Frame *f, uint64_t arrivedns)
+{
+	Msg in = { 0 };
+	int lost = 0;
 
-	bcm2835_gpio_write(TIME_3, LOW);	/* - - - O O O - - - */
-	InterruptDelay(1000, false);
+	if(f->Version != 0)
+	{
+		/* pairing restarts the MCP's numbering, so don't call it a gap */
+		if(f->Type == FRAME_PAIR_REQ)
+			FrameSeqReset(&ser->RxSeq);
 
-	bcm2835_gpio_write(TIME_2, LOW);	/* - - - - O - - - - */
-	InterruptDelay(1000, false);
+		lost = FrameSeqCheck(&ser->RxSeq, f->Seq);
+		if(lost < 0)
+		{
+			LogPrintf(LOG_DEBUG, "SerialThread(): dropping duplicate frame seq %u from MCP\n", f->Seq);
+			return;
+		}
+		if(lost > 0)
+			LogPrintf(LOG_WARN, "SerialThread(): lost %d frame(s) from MCP before seq %u\n", lost, f->Seq);
+	}
 
-	bcm2835_gpio_write(TIME_1, LOW);	/* - - - - - - - - - */
-	InterruptDelay(1000, false);
+	in.Code = f->Type;
+	in.Seq = f->Seq;
+	in.Arg = lost;
+	in.TimeNs = arrivedns;		// so main()'s latencies start when the MCP's bytes did
 
-	/* Switch one more time to make sure you disable the player enable */
-	switch(PlayerInput)
+	switch(f->Type)
 	{
-		case 1:
-			bcm2835_gpio_write(P1_ENABLE, LOW);
+		case FRAME_PAIR_REQ:
+			LogPrintf(LOG_INFO, "SerialThread(): received pairing request from MCP (%s), sending ack\n", f->Version ? "framed" : "single byte");
+			SerialSend(ser, FRAME_PAIR_ACK, NULL, 0);
+			if(f->Version != 0)
+				SerialTuneStart(ser);
 			break;
-		case 2:
-			bcm2835_gpio_write(P2_ENABLE, LOW);
+		case FRAME_COUNTDOWN_END: // Player correct/incorrect lightbar term request
+			if(f->Len < 1)
+				return;
+			in.Player = f->Payload[0];
+			LogPrintf(LOG_INFO, "SerialThread(): received Player %d lightbar term request, killing countdown\n", in.Player);
 			break;
-		case 3:
-			bcm2835_gpio_write(P3_ENABLE, LOW);
+		case FRAME_PENALTY:
+			if(f->Len < 2)
+				return;
+			in.Arg = f->Payload[0] | (f->Payload[1] << 8);
 			break;
+		case FRAME_BAUD_ACK:
+		case FRAME_PONG:
+			SerialTuneFrame(ser, f, arrivedns);
+			return;
 		default:
-			printf("GetPlayerRingin(): WARNING: Tried to set unknown PlayerInput %d LOW\n", PlayerInput);
-			break;
+			LogPrintf(LOG_WARN, "SerialThread(): ignoring unknown frame type 0x%02x from MCP\n", f->Type);
+			return;
 	}
-#endif
 
-	printf("GetPlayerRingin(): Player %d Time expired!\n", PlayerInput);
-
-	return 0;
+	MsgQueueSend(&ser->In, &in);
+	LatSince(LAT_SERIAL_RX, arrivedns);
 }
 
-void ClearCountdownLights(int player)
+static void SerialTuneAsk(SerData *ser, uint64_t now)
 {
+	SerTune *t = &ser->Tune;
+	uint8_t payload[4];
+	int i;
+
+	if(t->Try <= ser->Link.Baud)
+	{
+		/* nothing faster to ask for; just time it */
+		t->State = TUNE_PINGING;
+		t->Pings = 0;
+		t->SentNs = now;
+		t->DeadlineNs = now + SER_TUNE_PING_MS * 1000000ull;
+		payload[0] = 0;
+		SerialSend(ser, FRAME_PING, payload, 1);
+		return;
+	}
 
+	for(i = 0; i < 4; i++)
+		payload[i] = (t->Try >> (8 * i)) & 0xff;
+	SerialSend(ser, FRAME_BAUD, payload, 4);
+	t->State = TUNE_ASKED;
+	t->DeadlineNs = now + SER_TUNE_ASK_MS * 1000000ull;
 }
 
-void *SerialThread(void *thread)
+/* The first framed pairing since the port came up: find the fastest
+   rate that works, as serproto.h describes */
+static void SerialTuneStart(SerData *ser)
 {
-	SerData *statbyte=(SerData *)thread;
-
-	statbyte->StatusByte = 1337;
-	int LastStatusByte = 0;
-
-	int countval = 10;
-
-	int fd;
-	char buf[255];
-	char *bufptr;
+	if(ser->Tune.State != TUNE_IDLE)
+		return;
 
-	bufptr = buf;
+	ser->Tune.Try = SerialMaxBaud;
+	ser->Tune.Garbage = ser->Parser.Skipped + ser->Parser.BadCrc;
+	SerialTuneAsk(ser, ClockNow());
+}
 
-	char DataToSend[2];
-	char DataToCompare[2];
-	int RetValue;
+static int CompareNs(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
 
-	struct termios options;
+	return (x > y) - (x < y);
+}
 
-	printf("SerialThread(): Hello from our serial thread!\n");
+static void SerialTuneFrame(SerData *ser, const Frame *f, uint64_t arrivedns)
+{
+	SerTune *t = &ser->Tune;
+	SerLink *link = &ser->Link;
+	uint8_t payload[4];
+	int rate, i;
 
-	printf("SerialThread(): Attempting to open /dev/ttyS0...");
-	fd = open("/dev/ttyS0", O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
-	if(fd == -1)
+	if(f->Type == FRAME_BAUD_ACK && t->State == TUNE_ASKED)
 	{
-		printf("SerialThread(): failed to open /dev/ttyS0 - error %d %s\n", errno, strerror(errno));
-		printf("SerialThread(): thread will now go into infinite loop\n");
-
-		while(1) { }
+		rate = f->Len < 4 ? 0 : f->Payload[0] | (f->Payload[1] << 8) | (f->Payload[2] << 16) | ((uint32_t)f->Payload[3] << 24);
+		if(rate == 0 || rate > t->Try || !SerLinkBaudSupported(rate))
+			LogPrintf(LOG_INFO, "SerialThread(): MCP stays at %d baud\n", link->Baud);
+		else if(SerLinkSetBaud(link, rate) != 0)
+			LogPrintf(LOG_WARN, "SerialThread(): couldn't set %s to %d baud - error %d %s\n", SerialPath, rate, errno, strerror(errno));
+		else
+			LogPrintf(LOG_DEBUG, "SerialThread(): MCP switching to %d baud, timing it\n", rate);
+
+		/* ping at whatever we've ended up at */
+		t->Try = link->Baud;
+		SerialTuneAsk(ser, arrivedns);
+		return;
 	}
-	else
-	{
-		printf(" - OK\n");
-		fcntl(fd, F_SETFL, 0 | O_NONBLOCK);
-
-		printf("SerialThread(): Setting TTY options\n");
-		tcgetattr(fd, &options);
-
-		printf("SerialThread(): Setting 9600BPS... ");
-		cfsetispeed(&options, B9600);
-		cfsetospeed(&options, B9600);
-		printf("- OK\n");
-
-		printf("SerialThread(): Setting 8N1 plus misc TTY options... ");
-		options.c_cflag &= ~PARENB;
-		options.c_cflag &= ~CSTOPB;
-		options.c_cflag &= ~CSIZE;
-		options.c_cflag |= CS8;
-		options.c_cflag &= ~CRTSCTS;
-		options.c_cc[VMIN] = 1;
-		options.c_cc[VTIME] = 5;
-		options.c_cflag |= CREAD | CLOCAL;
-		options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-		printf("- OK\n");
-
-		write(fd, "SReady\r\n", 8);
-		memset(buf, 0, sizeof(buf));
-
-		printf("SerialThread(): All serial setup complete, entering data loop\n");
-		printf("SerialThread(): TODO!!!!!!!!! Give me a way to exit this loop and kill the thread gracefully\n");
 
-		while(1)
-		{
-			//printf("SerialThread(): starting if(read)\n");
-
-			read(fd, bufptr, buf + sizeof(buf) - bufptr - 1); //just slam data into the buffer, who cares if the data or device is ready?
+	if(f->Type != FRAME_PONG || t->State != TUNE_PINGING || f->Len < 1 || f->Payload[0] != t->Pings)
+		return;
 
-			bufptr = buf;
+	t->RttNs[t->Pings++] = arrivedns - t->SentNs;
+	if(t->Pings < SERLINK_PINGS)
+	{
+		t->SentNs = ClockNow();
+		t->DeadlineNs = t->SentNs + SER_TUNE_PING_MS * 1000000ull;
+		payload[0] = t->Pings;
+		SerialSend(ser, FRAME_PING, payload, 1);
+		return;
+	}
 
-			strcpy(DataToCompare, buf);
-			RetValue = strcmp(DataToCompare, buf);
+	/* every one came back: tell the MCP to keep this rate */
+	if(link->Baud != SERLINK_BASE_BAUD)
+	{
+		for(i = 0; i < 4; i++)
+			payload[i] = (link->Baud >> (8 * i)) & 0xff;
+		SerialSend(ser, FRAME_BAUD, payload, 4);
+	}
 
-			if(LastStatusByte == statbyte->StatusByte) 
-			{
-			//	printf("SerialThread(): data error in read()! %d %s\n", errno, strerror(errno));
-
-
-                                switch(buf[0])
-                                {
-                                        case 33: // MCP sends pairing request, text value is !
-                                                printf("SerialThread(): if LSB = StatByte: received pairing request from MCP, sending ack\n");
-                                                write(fd, "@", 1);
-
-		                                memset(buf, 0, sizeof(buf));
-                                                break;
-                                        case 55: // MCP sends Player 1 Correct/Incorrect Lightbar term request, character 7
-                                                printf("SerialThread(): received Player 1 lightbar term request, killing countdown\n");
-                                                statbyte->StatusByte = 7;
-                                                break;
-                                        case 56: // Player 2 correct/incorrect, chr 8
-                                                printf("SerialThread(): received Player 2 lightbar term request, killing countdown\n");
-                                                //statbyte->StatusByte = 8;
-                                                break;
-                                        case 57: // Player 3 correct/incorrect, chr 9
-                                                printf("SerialThread(): received Player 3 lightbar term request, killing countdown\n");
-                                                //statbyte->StatusByte = 9;
-                                                break;
-
-					default:
-						break;
-				}
+	qsort(t->RttNs, SERLINK_PINGS, sizeof(t->RttNs[0]), CompareNs);
+	t->RttP50Ns = t->RttNs[SERLINK_PINGS / 2];
+	t->State = TUNE_DONE;
+	LogPrintf(LOG_INFO, "SerialThread(): MCP link at %d baud, round trip min %.2f p50 %.2f max %.2f ms over %d pings\n",
+		link->Baud, t->RttNs[0] / 1e6, t->RttP50Ns / 1e6, t->RttNs[SERLINK_PINGS - 1] / 1e6, SERLINK_PINGS);
+}
 
-				LastStatusByte = statbyte->StatusByte;
-				memset(buf, 0, sizeof(buf));
+/* Deadlines: an MCP that didn't answer FRAME_BAUD, a ping that didn't
+   come back, or the wait for the MCP to give up on a rate */
+static void SerialTuneService(SerData *ser, uint64_t now)
+{
+	SerTune *t = &ser->Tune;
+	SerLink *link = &ser->Link;
+	int failed;
 
-				//printf("SerialThread(): LSB: %d SB: %d\n", LastStatusByte,statbyte->StatusByte);
+	if(t->State == TUNE_IDLE || t->State == TUNE_DONE || now < t->DeadlineNs)
+		return;
 
-			}
-			else
+	switch(t->State)
+	{
+		case TUNE_ASKED:
+			LogPrintf(LOG_INFO, "SerialThread(): MCP doesn't change speed, staying at %d baud\n", link->Baud);
+			t->Try = link->Baud;
+			SerialTuneAsk(ser, now);
+			break;
+		case TUNE_PINGING:
+			if(link->Baud == SERLINK_BASE_BAUD)
 			{
-				/* if the data buffer isn't null, start parsing the logic!
-				   first we start by proessing outgoing messages... */
-
-				//printf("SerialThread(): got data: %s\n", buf);
-
-                                //printf("SerialThread(): debug: statbyte->StatusByte is %d\n", statbyte->StatusByte);
-
-                                switch(statbyte->StatusByte)
-                                {
-                                        case 49: // Player 1 ring-in
-                                                printf("SerialThread(): recieved byte 1 on StatusByte, sending start countdown to MCP\n");
-                                                strcpy(DataToSend, "1");
-                                                //write(fd, "A", 1)
-                                                break;
-                                        case 50: // Player 2 ring-in
-                                                printf("SerialThread(): received byte 2 on StatusByte, sending start countdown to MCP\n");
-                                                //DataToSend = '2';
-                                                break;
-                                        case 51: // Player 3 ring-in
-                                                printf("SerialThread(): received byte 3 on StatusByte, sending start countdown to MCP\n");
-                                                //DataToSend = '3';
-                                                break;
-                                        case 52: // Player 1 Expired
-                                                printf("SerialThread(): recieved byte 4 on StatusByte, sending time expired to MCP\n");
-                                                //DataToSend = '4';
-						strcpy(DataToSend, "4");
-                                                break;
-                                        case 53: // Player 2 Expired
-                                                printf("SerialThread(): received byte 5 on StatusByte, sending time expired to MCP\n");
-                                                //DataToSend = '5';
-                                                break;
-                                        case 54: // Player 3 Expired
-                                                printf("SerialThread(): recieved byte 6 on StatusByte, sending time expired to MCP\n");
-                                                //DataToSend = '6';
-                                                break;
-                                        default:
-                                                //printf("SerialThread(): Unknown data in statbyte->StatusByte! %d\n", statbyte->StatusByte);
-                                                break;
-                                }
-
-				/* and then process incoming messages from MCP 
-				switch(buf[0])
-				{
-					case 33: // MCP sends pairing request, text value is !
-						printf("SerialThread(): received pairing request from MCP, sending ack\n");
-						write(fd, "@", 1);
-						break;
-					case 55: // MCP sends Player 1 Correct/Incorrect Lightbar term request, character 7
-						printf("SerialThread(): received Player 1 lightbar term request, killing countdown\n");
-						statbyte->StatusByte = 7;
-						break;
-					case 56: // Player 2 correct/incorrect, chr 8
-						printf("SerialThread(): received Player 2 lightbar term request, killing countdown\n");
-						statbyte->StatusByte = 8;
-						break;
-					case 57: // Player 3 correct/incorrect, chr 9
-						printf("SerialThread(): received Player 3 lightbar term request, killing countdown\n");
-						statbyte->StatusByte = 9;
-						break;
-					default:
-						//printf("SerialThread(): got unknown data: %s\n", buf);
-						break;
-				}*/
-
-				/* and before we send data back to the MCP, check we haven't send the data already lest we flood the MCP! */
-				//if(LastStatusByte != statbyte->StatusByte)
-				//{
-					LastStatusByte = statbyte->StatusByte;
-
-					write(fd, DataToSend, 1);
-				//}
-
-				/*if(buf[0] == 102)
-				{
-					write(fd, "OK\r\n", 4);
-				}
-				else
-				{
-					printf("SerialThread(): unknown data: %s\n", buf);
-				}*/
-
-				/* and clear the buffer so we don't do logic on old data! */
-				memset(buf, 0, sizeof(buf));
+				LogPrintf(LOG_INFO, "SerialThread(): MCP doesn't answer pings, staying at %d baud\n", link->Baud);
+				t->RttP50Ns = 0;
+				t->State = TUNE_DONE;
+				break;
 			}
-		}
+			failed = link->Baud;
+			t->Failed++;
+			t->Try = SerLinkSlowerBaud(failed);
+			SerLinkSetBaud(link, SERLINK_BASE_BAUD);
+			LogPrintf(LOG_WARN, "SerialThread(): MCP link unreliable at %d baud, trying %d once it's back at %d\n", failed, t->Try, SERLINK_BASE_BAUD);
+			t->State = TUNE_REVERTING;
+			t->DeadlineNs = now + (SERLINK_BAUD_REVERT_MS + SER_TUNE_PING_MS) * 1000000ull;
+			break;
+		case TUNE_REVERTING:
+			SerialTuneAsk(ser, now);
+			break;
+		default:
+			break;
 	}
 }
 
-void *Player1Thread(void *thread)
+/* How long the serial thread may sleep before SerialTuneService() is due */
+static int SerialTuneTimeout(const SerData *ser)
 {
-	P1Data *p1b=(P1Data *)thread;
-	p1b->P1Cmd = 1337;
-	p1b->P1Resp = 420;
+	uint64_t now;
 
-	int EarlyPenalty = 0; // variable to hold if this player is subject to an early ring-in penalty
-	int LastMsg = 0;
-	int Enabled = 0;
-	int Lockout = 0;
+	if(ser->Tune.State == TUNE_IDLE || ser->Tune.State == TUNE_DONE)
+		return -1;
 
-	uint8_t Player1Button = 0;
+	now = ClockNow();
+	if(now >= ser->Tune.DeadlineNs)
+		return 0;
+	return (int)((ser->Tune.DeadlineNs - now + 999999) / 1000000ull);
+}
 
-	printf("Player1Thread(): Welcome to P1Thread, entering loop\n");
+void *ScannerThread(void *thread)
+{
+	Scanner *sc = (Scanner *)thread;
+	ScanResult res;
+	uint64_t next;
+	char order[SCAN_MAX_PLAYERS * 4 + 1];
+	int i, len;
+
+	LogPrintf(LOG_DEBUG, "ScannerThread(): Scanning %d player inputs from one GPLEV0 snapshot every %llu us, tie-break policy %s\n", sc->Players, (unsigned long long)(ScanIntervalNs / 1000), ScannerPolicyName(sc->Policy));
+	next = ClockNow();
+
+	/* one snapshot up front, so the bank everyone reads is real by the
+	   time main() hears we're up */
+	ScannerSample(sc, next, &res);
+	ReadyArrive(&Startup, "ScannerThread", true);
 	while(1)
 	{
-		Player1Button = bcm2835_gpio_lev(INPUT1);
-		if(Player1Button == 0) // Player Button was pressed
+		/* sample on a fixed absolute schedule so the tie window stays
+		   ScanIntervalNs no matter how long a sample took */
+		if(ScanIntervalNs != 0)
 		{
-			//printf("Player1Thread(): debug: EarlyPenalty == %d, Lockout == %d, LastMsg == %d\n", EarlyPenalty,Lockout,LastMsg);
-
-			p1b->P1Resp = 1; //tell main() that we got a response!
-
-			if(Enabled != 1) //Enabler is Disabled, we are not safe to ring in
-			{
-				if(EarlyPenalty == 0)
-				{
-					printf("Player1Thread(): P1 rang in unsafe; penalizing (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					EarlyPenalty = 1;
-				}
-			}
-			else //Enabler is Enabled, now it is safe to ring in
-			{
-				if(EarlyPenalty == 0 && Lockout != 1 /*&& p1b->P1Cmd == 5*/) //Make sure we're not enforcing the early ring-in penalty,
-				{						      //that we're not locked out, and that main() has cleared
-					// do the countdown logic here		      //us to ring in!
-					ShowCountdown(1, 5);
-					InterruptDelay(1000, false);
-
-					ShowCountdown(1, 4);
-					InterruptDelay(1000, false);
-
-					ShowCountdown(1, 3);
-					InterruptDelay(1000, false);
-
-					ShowCountdown(1, 2);
-					InterruptDelay(1000, false);
-
-					ShowCountdown(1, 1);
-					InterruptDelay(1000, false);
-
-					ShowCountdown(1, 0);
-
-					Lockout = 1;
-					p1b-P1Resp = 6; //send message back to main() saying that we timed out
-				}
-				else if(EarlyPenalty == 1) //Early penalty enforced
-				{
-					//do the penalty logic here
-					printf("Player1Thread(): Enforcing penalty!(EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					InterruptDelay(250, false);
-					EarlyPenalty = 0;
-					printf("Player1Thread(): Penalty CLEAR! (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-				}
-			}
+			next += ScanIntervalNs;
+			ClockSleepUntil(next);
 
+			/* how late the kernel woke us is the jitter -R is there to cut */
+			LatSince(LAT_WAKEUP, next);
 		}
 
-		/* Process commands send to us from main() */
-		if(LastMsg != p1b->P1Cmd)
+		if(ScannerSample(sc, ClockNow(), &res) > 1)
 		{
-			printf("Player1Thread(): Got new data - (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-			switch(p1b->P1Cmd)
-			{
-				case 2:
-					printf("Player1Thread(): OK, adding to penalty table (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					EarlyPenalty = 1;
-					break;
-				case 3:
-					printf("Player1Thread(): Enabling player input (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					Enabled = 1;
-					Lockout = 0;
-					break;
-				case 4:
-					printf("Player1Thread(): Disabling player input(EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					Enabled = 0;
-					Lockout = 0;
-					EarlyPenalty = 0;
-					break;
-				case 5:
-					printf("Player1Thread(): We got the ring-in! (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					break;
-				case 7:
-					printf("Player1Thread(): Another player won, better luck next time (EP: %d, LO: %d, LM: %d, CM: %d)\n",EarlyPenalty, Lockout, LastMsg,p1b->P1Cmd);
-					Lockout = 1;
-					break;
-				default:
-					break;
-			}
-
-			LastMsg = p1b->P1Cmd;
+			/* one line, so it can't land in the middle of anyone else's */
+			len = 0;
+			for(i = 0; i < res.Count; i++)
+				len += snprintf(order + len, sizeof(order) - len, " P%d", res.Order[i] + 1);
+			LogPrintf(LOG_INFO, "ScannerThread(): TIE in one snapshot (window %llu ns), order:%s (%s)\n",
+				(unsigned long long)res.WindowNs, order, ScannerPolicyName(sc->Policy));
 		}
-
 	}
 }
 
-
-void InterruptDelay(int milliseconds, bool selftest)
-{
-        /* This function exists so the operator can cancel a player's
-           input without having to wait for the timer to expire. This
-           keeps things running fast. */
-        uint8_t oi;
-        int IDelay;
-
-	//SerData *DataRead2 = malloc(sizeof(SerData)); //create pointer to the serialthread's StatusByte
-
-        for(IDelay = 0; IDelay < (milliseconds / 10); IDelay = IDelay + 1)
-        {
-                bcm2835_delay(10);
-                oi = 1; //bcm2835_gpio_lev(OPERATOR_INTERRUPT);
-
-		//printf("InterruptDelay(): StatusByte is %d\n",dataread.StatusByte);
-
-                if(oi == 0)
-                {
-                        printf("InterruptDelay(): Ending countdown - Lockout switch was pressed\n");
-                        break;
-                }
-        }
-
-	return 0;
-}
-
 void CheckIfRoot()
 {
 	/* bcm2835 now supports root-less execution.
@@ -908,32 +1313,73 @@ void CheckIfRoot()
 
 void CleanupAndClose()
 {
-	/* Catch ^C and make sure all LEDs are turned off before
-	   exiting the program. */
-	signal(SIGINT, CleanupAndClose);
+	uint64_t dropped, limited;
+	int i;
+
+	/* Make sure all LEDs are turned off before exiting the
+	   program. Runs on main() once ^C has stopped its reactor. */
+	LogStop();
 	printf("\n\nCleanupAndClose(): Terminating... \n");
+	LogLost(&dropped, &limited);
+	if(dropped != 0 || limited != 0)
+		printf("CleanupAndClose(): Logger dropped %llu lines with a ring full and %llu over the rate limit\n",
+			(unsigned long long)dropped, (unsigned long long)limited);
 
 /*	printf("ENABLER_LED ");
-	bcm2835_gpio_write(ENABLER_LED, LOW);
+	GPIOWrite(ENABLER_LED, LOW);
 	printf("OFF ");*/
 
-	printf("P1_LED ");
-	bcm2835_gpio_write(P1_LED, LOW);
-	printf("- OFF\n");
-
-	printf("P2_LED ");
-	bcm2835_gpio_write(P2_LED, LOW);
-	printf("- OFF\n");
+	for(i = 0; i < PlayerCount; i++)
+	{
+		if(PinMap[i].Led == PIN_NONE)
+			continue;
 
-	printf("P3_LED ");
-	bcm2835_gpio_write(P3_LED, LOW);
-	printf("- OFF\n");
+		printf("P%d_LED ", i + 1);
+		GPIOWrite(PinMap[i].Led, LOW);
+		printf("- OFF\n");
+	}
 
 	TTLClose();
 
+	if(MainPtr != NULL)
+	{
+		if(Scan.Samples > 0)
+			printf("CleanupAndClose(): Scanner: %lu samples, %lu ties, %llu input bounces filtered\n",
+				Scan.Samples, Scan.Ties, (unsigned long long)Scan.Filter.Bounces);
+		if(MainPtr->Ser->Link.Drops > 0 || MainPtr->Ser->Link.Opens > 1)
+			printf("CleanupAndClose(): Serial: %s lost %lu times, opened %lu times, last back after %llu ms\n", SerialPath,
+				MainPtr->Ser->Link.Drops, MainPtr->Ser->Link.Opens, (unsigned long long)MainPtr->Ser->Link.LastDownMs);
+		if(MainPtr->Ser->Tune.RttP50Ns > 0)
+			printf("CleanupAndClose(): Serial: MCP link at %d baud, %.2f ms round trip at pairing, %lu faster rates didn't work\n",
+				MainPtr->Ser->Link.Baud, MainPtr->Ser->Tune.RttP50Ns / 1e6, MainPtr->Ser->Tune.Failed);
+		if(MainPtr->Ser->Tx.Queued > 0)
+			printf("CleanupAndClose(): Serial: %lu messages to the MCP in %lu writes, %lu merged, %lu dropped, queue %.1f deep on average, %d at most\n",
+				MainPtr->Ser->Tx.Queued, MainPtr->Ser->Tx.Writes, MainPtr->Ser->Tx.Merged, MainPtr->Ser->Tx.Dropped,
+				MainPtr->Ser->Tx.Batches ? (double)MainPtr->Ser->Tx.DepthSum / MainPtr->Ser->Tx.Batches : 0.0, MainPtr->Ser->Tx.MaxDepth);
+		if(MainPtr->Ser->Rx.Reads > 0)
+			printf("CleanupAndClose(): Serial: %lu bytes from the MCP in %lu reads, %lu frames, %lu bad CRC, %lu bytes skipped\n",
+				MainPtr->Ser->Rx.Bytes, MainPtr->Ser->Rx.Reads, MainPtr->Ser->Parser.Frames + MainPtr->Ser->Parser.Legacy,
+				MainPtr->Ser->Parser.BadCrc, MainPtr->Ser->Parser.Skipped);
+		LatDump(stdout);
+		ReportCountdowns(MainPtr);
+		GameClose(&Round);
+	}
+
+	if(SimOutputPath != NULL)
+	{
+		printf("CleanupAndClose(): Writing simulated board output log to %s\n", SimOutputPath);
+		SimDumpOutputLog(SimOutputPath);
+	}
+
+	GPIOClose();
+
+	if(TraceActive != NULL)
+	{
+		printf("CleanupAndClose(): Closing event trace %s\n", TracePath);
+		TraceClose();
+	}
+
 	printf("CleanupAndClose(): All systems terminated OK\n\n");
 
 	printf("CleanupAndClose(): Thanks for playing Jeopardy!\n\n");
-
-	exit(0);
 }
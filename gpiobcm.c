@@ -0,0 +1,80 @@
+/* Filename: gpiobcm.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: GPIO backend for the real Pi, a thin wrapper around
+   the bcm2835 library.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <bcm2835.h>
+
+#include "gpioio.h"
+
+static int BCMInit(void)
+{
+	return bcm2835_init();
+}
+
+static void BCMClose(void)
+{
+	bcm2835_close();
+}
+
+static void BCMFSel(uint8_t pin, uint8_t mode)
+{
+	bcm2835_gpio_fsel(pin, mode);
+}
+
+static void BCMSetPud(uint8_t pin, uint8_t pud)
+{
+	bcm2835_gpio_set_pud(pin, pud);
+}
+
+static uint8_t BCMLev(uint8_t pin)
+{
+	return bcm2835_gpio_lev(pin);
+}
+
+static void BCMWrite(uint8_t pin, uint8_t on)
+{
+	bcm2835_gpio_write(pin, on);
+}
+
+static void BCMDelay(unsigned int milliseconds)
+{
+	bcm2835_delay(milliseconds);
+}
+
+static uint32_t BCMLevBank(void)
+{
+	/* One read of GPLEV0 gives every pin's level at the same instant */
+	return bcm2835_peri_read(bcm2835_gpio + BCM2835_GPLEV0 / 4);
+}
+
+static void BCMWriteMask(uint32_t set, uint32_t clr)
+{
+	/* one GPSET0 and one GPCLR0 write, however many pins change */
+	if(set != 0)
+		bcm2835_gpio_set_multi(set);
+	if(clr != 0)
+		bcm2835_gpio_clr_multi(clr);
+}
+
+const GPIOBackend GPIOBackendBCM2835 = {
+	.Name = "bcm2835",
+	.Init = BCMInit,
+	.Close = BCMClose,
+	.FSel = BCMFSel,
+	.SetPud = BCMSetPud,
+	.Lev = BCMLev,
+	.Write = BCMWrite,
+	.Delay = BCMDelay,
+	.LevBank = BCMLevBank,
+	.WriteMask = BCMWriteMask,
+};
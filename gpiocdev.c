@@ -0,0 +1,113 @@
+/* Filename: gpiocdev.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: GPIO character device edge events. See gpiocdev.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "gpiocdev.h"
+
+#define CDEV_MAX_BATCH 16
+
+int CdevOpen(const char *chip, const uint8_t *pins, int count)
+{
+	struct gpio_v2_line_request req;
+	int chipfd;
+	int i;
+
+	if(count < 1 || count > GPIO_V2_LINES_MAX)
+		return -1;
+
+	chipfd = open(chip, O_RDONLY | O_CLOEXEC);
+	if(chipfd == -1)
+	{
+		printf("CdevOpen(): failed to open %s - error %d %s\n", chip, errno, strerror(errno));
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	for(i = 0; i < count; i++)
+		req.offsets[i] = pins[i];
+	req.num_lines = count;
+	strncpy(req.consumer, "jeopardy-ringin", sizeof(req.consumer) - 1);
+
+	/* Timestamps default to CLOCK_MONOTONIC, which is what we compare against */
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+
+	if(ioctl(chipfd, GPIO_V2_GET_LINE_IOCTL, &req) == -1)
+	{
+		printf("CdevOpen(): line request on %s failed - error %d %s\n", chip, errno, strerror(errno));
+		close(chipfd);
+		return -1;
+	}
+
+	/* the line request fd stays valid after the chip is closed */
+	close(chipfd);
+
+	return req.fd;
+}
+
+void CdevClose(int fd)
+{
+	if(fd >= 0)
+		close(fd);
+}
+
+int CdevWaitEdges(int fd, int wakefd, int timeout_ms, InputEdge *edges, int max)
+{
+	struct gpio_v2_line_event ev[CDEV_MAX_BATCH];
+	struct pollfd pfd[2];
+	uint64_t wakes;
+	ssize_t len;
+	int n, i;
+
+	pfd[0].fd = fd;
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+	pfd[1].fd = wakefd;			// poll() ignores negative fds
+	pfd[1].events = POLLIN;
+	pfd[1].revents = 0;
+
+	n = poll(pfd, 2, timeout_ms);
+	if(n <= 0)
+		return (n == 0 || errno == EINTR) ? 0 : -1;
+
+	if(pfd[1].revents & POLLIN)
+		(void)!read(wakefd, &wakes, sizeof(wakes));
+
+	if(!(pfd[0].revents & POLLIN))
+		return 0;
+
+	if(max > CDEV_MAX_BATCH)
+		max = CDEV_MAX_BATCH;
+
+	len = read(fd, ev, sizeof(ev[0]) * max);
+	if(len < (ssize_t)sizeof(ev[0]))
+		return (len == -1 && errno != EAGAIN && errno != EINTR) ? -1 : 0;
+
+	n = len / sizeof(ev[0]);
+	for(i = 0; i < n; i++)
+	{
+		edges[i].TimeNs = ev[i].timestamp_ns;
+		edges[i].Pin = ev[i].offset;
+		edges[i].Level = (ev[i].id == GPIO_V2_LINE_EVENT_FALLING_EDGE) ? 0 : 1;
+		edges[i].Seqno = ev[i].seqno;
+	}
+
+	return n;
+}
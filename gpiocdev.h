@@ -0,0 +1,42 @@
+/* Filename: gpiocdev.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Edge-event input through the Linux GPIO character
+   device (/dev/gpiochipN, v2 line-event API). The kernel timestamps
+   each edge when the interrupt fires, so a press carries the time the
+   button actually closed rather than the time a loop noticed it.
+
+   Works with the gpio-sim kernel module as well as a real Pi.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef GPIOCDEV_H
+#define GPIOCDEV_H
+
+#include <stdint.h>
+
+typedef struct InputEdge {
+	uint64_t TimeNs;			// kernel CLOCK_MONOTONIC timestamp of the edge
+	uint8_t Pin;				// line offset, same as the BCM GPIO number on a Pi
+	uint8_t Level;				// level after the edge, LOW means pressed
+	uint32_t Seqno;				// kernel sequence number, gaps mean lost edges
+} InputEdge;
+
+/* Request pins as pulled-up inputs reporting both edges. Returns the
+   line request fd, or -1 on error. */
+int CdevOpen(const char *chip, const uint8_t *pins, int count);
+void CdevClose(int fd);
+
+/* Wait up to timeout_ms (-1 forever) for edges and copy up to max of
+   them into edges. If wakefd is an eventfd (or -1 for none) and it gets
+   poked, it is drained and the wait ends early. Returns the number of
+   edges copied, 0 on timeout or wakeup, -1 on error. */
+int CdevWaitEdges(int fd, int wakefd, int timeout_ms, InputEdge *edges, int max);
+
+#endif
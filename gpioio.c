@@ -0,0 +1,49 @@
+/* Filename: gpioio.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: GPIO backend selection. See gpioio.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gpioio.h"
+
+static const GPIOBackend *Backends[] = {
+#ifndef GPIO_SIM_ONLY
+	&GPIOBackendBCM2835,
+#endif
+	&GPIOBackendSim,
+};
+
+/* Default to the first backend in the table: bcm2835 on a Pi build,
+   the simulated board on a SIM=1 build. */
+#ifndef GPIO_SIM_ONLY
+const GPIOBackend *GPIO = &GPIOBackendBCM2835;
+#else
+const GPIOBackend *GPIO = &GPIOBackendSim;
+#endif
+
+int GPIOSelectBackend(const char *name)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(Backends) / sizeof(Backends[0]); i++)
+	{
+		if(strcmp(Backends[i]->Name, name) == 0)
+		{
+			GPIO = Backends[i];
+			return 0;
+		}
+	}
+
+	printf("GPIOSelectBackend(): unknown GPIO backend '%s'\n", name);
+	return -1;
+}
@@ -0,0 +1,111 @@
+/* Filename: gpioio.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: GPIO backend abstraction. Everything in the ring-in
+   logic talks to the pins through GPIOLev()/GPIOWrite() and friends
+   so it can run against the real bcm2835 library on a Pi, or against
+   the simulated board in gpiosim.c on any Linux box.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef GPIOIO_H
+#define GPIOIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+
+#ifndef GPIO_SIM_ONLY
+	#include <bcm2835.h>
+#else
+	/* Off-Pi builds (make SIM=1) don't have bcm2835.h, so provide the few
+	   names gpio.c uses. Values match the library so pin numbers in traces
+	   and sim scripts are the same BCM GPIO numbers either way. */
+	#define HIGH 0x1
+	#define LOW  0x0
+
+	#define BCM2835_GPIO_FSEL_INPT	0x00
+	#define BCM2835_GPIO_FSEL_OUTP	0x01
+
+	#define BCM2835_GPIO_PUD_OFF	0x00
+	#define BCM2835_GPIO_PUD_DOWN	0x01
+	#define BCM2835_GPIO_PUD_UP	0x02
+
+	typedef enum
+	{
+		RPI_GPIO_P1_07		= 4,
+		RPI_GPIO_P1_11		= 17,
+		RPI_GPIO_P1_12		= 18,
+		RPI_GPIO_P1_13		= 21,
+		RPI_GPIO_P1_15		= 22,
+		RPI_GPIO_P1_16		= 23,
+		RPI_GPIO_P1_18		= 24,
+		RPI_GPIO_P1_22		= 25,
+		RPI_V2_GPIO_P1_05	= 3,
+		RPI_V2_GPIO_P1_13	= 27,
+
+		RPI_BPLUS_GPIO_J8_03	= 2,
+		RPI_BPLUS_GPIO_J8_05	= 3,
+		RPI_BPLUS_GPIO_J8_07	= 4,
+		RPI_BPLUS_GPIO_J8_11	= 17,
+		RPI_BPLUS_GPIO_J8_13	= 27,
+		RPI_BPLUS_GPIO_J8_15	= 22,
+		RPI_BPLUS_GPIO_J8_19	= 10,
+		RPI_BPLUS_GPIO_J8_21	= 9,
+		RPI_BPLUS_GPIO_J8_23	= 11,
+		RPI_BPLUS_GPIO_J8_29	= 5,
+		RPI_BPLUS_GPIO_J8_31	= 6,
+		RPI_BPLUS_GPIO_J8_32	= 12,
+		RPI_BPLUS_GPIO_J8_33	= 13,
+		RPI_BPLUS_GPIO_J8_35	= 19,
+		RPI_BPLUS_GPIO_J8_36	= 16,
+		RPI_BPLUS_GPIO_J8_37	= 26,
+		RPI_BPLUS_GPIO_J8_38	= 20,
+		RPI_BPLUS_GPIO_J8_40	= 21
+	} RPiGPIOPin;
+#endif
+
+typedef struct GPIOBackend {
+	const char *Name;
+	int (*Init)(void);				// returns 1 on success, same as bcm2835_init()
+	void (*Close)(void);
+	void (*FSel)(uint8_t pin, uint8_t mode);
+	void (*SetPud)(uint8_t pin, uint8_t pud);
+	uint8_t (*Lev)(uint8_t pin);
+	void (*Write)(uint8_t pin, uint8_t on);
+	void (*Delay)(unsigned int milliseconds);
+	uint32_t (*LevBank)(void);			// GPIO 0-31 in one read, bit n = GPIO n
+	void (*WriteMask)(uint32_t set, uint32_t clr);	// GPIO 0-31: set bits high, clr bits low, in one go
+} GPIOBackend;
+
+#ifndef GPIO_SIM_ONLY
+extern const GPIOBackend GPIOBackendBCM2835;
+#endif
+extern const GPIOBackend GPIOBackendSim;
+
+/* The active backend. Set with GPIOSelectBackend() before GPIOInit(). */
+extern const GPIOBackend *GPIO;
+
+int GPIOSelectBackend(const char *name);
+
+static inline int GPIOInit(void)				{ return GPIO->Init(); }
+static inline void GPIOClose(void)				{ GPIO->Close(); }
+static inline void GPIOFSel(uint8_t pin, uint8_t mode)		{ GPIO->FSel(pin, mode); }
+static inline void GPIOSetPud(uint8_t pin, uint8_t pud)		{ GPIO->SetPud(pin, pud); }
+static inline uint8_t GPIOLev(uint8_t pin)			{ return GPIO->Lev(pin); }
+static inline void GPIOWrite(uint8_t pin, uint8_t on)		{ GPIO->Write(pin, on); TraceLog(TRACE_LIGHT, 0, pin, on, 0); }
+static inline void GPIODelay(unsigned int milliseconds)		{ GPIO->Delay(milliseconds); }
+static inline uint32_t GPIOLevBank(void)			{ return GPIO->LevBank(); }
+static inline void GPIOWriteMask(uint32_t set, uint32_t clr)	{ GPIO->WriteMask(set, clr); TraceLog(TRACE_LIGHTS, 0, 0xff, set, clr); }
+
+/* A pin's bit for GPIOWriteMask(), nothing for PIN_NONE or above GPIO 31 */
+static inline uint32_t GPIOBit(uint8_t pin)			{ return pin < 32 ? 1u << pin : 0; }
+
+#endif
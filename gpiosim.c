@@ -0,0 +1,306 @@
+/* Filename: gpiosim.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Simulated GPIO board backend. See gpiosim.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gpioio.h"
+#include "clock.h"
+#include "gpiosim.h"
+
+static pthread_mutex_t SimLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t Levels[SIM_MAX_PINS];
+static uint64_t StartNs;
+
+static SimEvent Script[SIM_MAX_SCRIPT];
+static size_t ScriptLen;
+static size_t ScriptNext;			// first edge not yet applied
+
+static SimEvent OutputLog[SIM_MAX_LOG];
+static size_t OutputLen;
+static unsigned long OutputDropped;
+
+uint64_t SimNow(void)
+{
+	return ClockNow() - StartNs;
+}
+
+/* Apply every scripted edge that is due. Caller holds SimLock. */
+static void ApplyDueEdges(uint64_t now)
+{
+	while(ScriptNext < ScriptLen && Script[ScriptNext].TimeNs <= now)
+	{
+		Levels[Script[ScriptNext].Pin] = Script[ScriptNext].Level;
+		ScriptNext++;
+	}
+}
+
+int SimAddEdge(uint64_t TimeNs, uint8_t pin, uint8_t level)
+{
+	size_t i;
+
+	if(pin >= SIM_MAX_PINS)
+		return -1;
+
+	pthread_mutex_lock(&SimLock);
+	if(ScriptLen == SIM_MAX_SCRIPT)
+	{
+		pthread_mutex_unlock(&SimLock);
+		printf("SimAddEdge(): script is full (%d edges)\n", SIM_MAX_SCRIPT);
+		return -1;
+	}
+
+	/* keep the script sorted; scripts are nearly always appended in order */
+	i = ScriptLen;
+	while(i > ScriptNext && Script[i - 1].TimeNs > TimeNs)
+	{
+		Script[i] = Script[i - 1];
+		i--;
+	}
+	Script[i].TimeNs = TimeNs;
+	Script[i].Pin = pin;
+	Script[i].Level = level ? HIGH : LOW;
+	ScriptLen++;
+	pthread_mutex_unlock(&SimLock);
+
+	return 0;
+}
+
+int SimLoadScript(const char *path)
+{
+	FILE *f;
+	char line[128];
+	unsigned long long us;
+	unsigned int pin, level;
+	int lineno = 0;
+	int count = 0;
+
+	f = fopen(path, "r");
+	if(f == NULL)
+	{
+		printf("SimLoadScript(): can't open %s\n", path);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		lineno++;
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if(sscanf(line, "%llu %u %u", &us, &pin, &level) != 3)
+			pin = SIM_MAX_PINS;
+		else if(pin >= SIM_BANK_PINS)
+		{
+			/* or it'd wrap into some other pin in the uint8_t */
+			printf("SimLoadScript(): %s:%d: no pin %u, the board has BCM GPIO 0-%d\n", path, lineno, pin, SIM_BANK_PINS - 1);
+			fclose(f);
+			return -1;
+		}
+		if(pin >= SIM_BANK_PINS || SimAddEdge(us * 1000ull, pin, level) != 0)
+		{
+			printf("SimLoadScript(): %s:%d: bad edge '%s'\n", path, lineno, line);
+			fclose(f);
+			return -1;
+		}
+		count++;
+	}
+
+	fclose(f);
+	printf("SimLoadScript(): loaded %d edges from %s\n", count, path);
+	return count;
+}
+
+void SimReset(void)
+{
+	pthread_mutex_lock(&SimLock);
+	memset(Levels, 0, sizeof(Levels));
+	ScriptLen = 0;
+	ScriptNext = 0;
+	OutputLen = 0;
+	OutputDropped = 0;
+	StartNs = ClockNow();
+	pthread_mutex_unlock(&SimLock);
+}
+
+size_t SimOutputLog(const SimEvent **log)
+{
+	*log = OutputLog;
+	return OutputLen;
+}
+
+unsigned long SimDroppedWrites(void)
+{
+	return OutputDropped;
+}
+
+int SimDumpOutputLog(const char *path)
+{
+	FILE *f;
+	size_t i;
+
+	f = fopen(path, "w");
+	if(f == NULL)
+	{
+		printf("SimDumpOutputLog(): can't open %s\n", path);
+		return -1;
+	}
+
+	pthread_mutex_lock(&SimLock);
+	fprintf(f, "# time_us gpio level\n");
+	for(i = 0; i < OutputLen; i++)
+		fprintf(f, "%llu.%03llu %u %u\n", (unsigned long long)(OutputLog[i].TimeNs / 1000), (unsigned long long)(OutputLog[i].TimeNs % 1000), OutputLog[i].Pin, OutputLog[i].Level);
+	if(OutputDropped)
+		fprintf(f, "# %lu writes dropped, log full\n", OutputDropped);
+	pthread_mutex_unlock(&SimLock);
+
+	fclose(f);
+	return 0;
+}
+
+static int SimInit(void)
+{
+	/* Keep any edges scripted before init, just restart the clock */
+	pthread_mutex_lock(&SimLock);
+	StartNs = ClockNow();
+	pthread_mutex_unlock(&SimLock);
+
+	return 1;
+}
+
+static void SimClose(void)
+{
+}
+
+static void SimFSel(uint8_t pin, uint8_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+static void SimSetPud(uint8_t pin, uint8_t pud)
+{
+	if(pin >= SIM_MAX_PINS)
+		return;
+
+	/* Pulls set the idle level of an undriven input */
+	pthread_mutex_lock(&SimLock);
+	if(pud == BCM2835_GPIO_PUD_UP)
+		Levels[pin] = HIGH;
+	else if(pud == BCM2835_GPIO_PUD_DOWN)
+		Levels[pin] = LOW;
+	pthread_mutex_unlock(&SimLock);
+}
+
+static uint8_t SimLev(uint8_t pin)
+{
+	uint8_t level;
+
+	if(pin >= SIM_MAX_PINS)
+		return LOW;
+
+	pthread_mutex_lock(&SimLock);
+	ApplyDueEdges(SimNow());
+	level = Levels[pin];
+	pthread_mutex_unlock(&SimLock);
+
+	return level;
+}
+
+static uint32_t SimLevBank(void)
+{
+	uint32_t bank = 0;
+	int pin;
+
+	pthread_mutex_lock(&SimLock);
+	ApplyDueEdges(SimNow());
+	for(pin = 0; pin < SIM_BANK_PINS; pin++)
+		bank |= (uint32_t)(Levels[pin] & 1) << pin;
+	pthread_mutex_unlock(&SimLock);
+
+	return bank;
+}
+
+static void SimWrite(uint8_t pin, uint8_t on)
+{
+	if(pin >= SIM_MAX_PINS)
+		return;
+
+	pthread_mutex_lock(&SimLock);
+	Levels[pin] = on ? HIGH : LOW;
+	if(OutputLen < SIM_MAX_LOG)
+	{
+		OutputLog[OutputLen].TimeNs = SimNow();
+		OutputLog[OutputLen].Pin = pin;
+		OutputLog[OutputLen].Level = Levels[pin];
+		OutputLen++;
+	}
+	else
+	{
+		OutputDropped++;
+	}
+	pthread_mutex_unlock(&SimLock);
+}
+
+static void SimWriteMask(uint32_t set, uint32_t clr)
+{
+	uint64_t now;
+	uint32_t bits = set | clr;
+	uint8_t pin;
+
+	/* every pin in the mask changes at the same instant, as with GPSET0/GPCLR0 */
+	pthread_mutex_lock(&SimLock);
+	now = SimNow();
+	for(; bits != 0; bits &= bits - 1)
+	{
+		pin = __builtin_ctz(bits);
+		Levels[pin] = (set & (1u << pin)) ? HIGH : LOW;
+		if(OutputLen < SIM_MAX_LOG)
+		{
+			OutputLog[OutputLen].TimeNs = now;
+			OutputLog[OutputLen].Pin = pin;
+			OutputLog[OutputLen].Level = Levels[pin];
+			OutputLen++;
+		}
+		else
+		{
+			OutputDropped++;
+		}
+	}
+	pthread_mutex_unlock(&SimLock);
+}
+
+static void SimDelay(unsigned int milliseconds)
+{
+	struct timespec ts;
+
+	ts.tv_sec = milliseconds / 1000;
+	ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+const GPIOBackend GPIOBackendSim = {
+	.Name = "sim",
+	.Init = SimInit,
+	.Close = SimClose,
+	.FSel = SimFSel,
+	.SetPud = SimSetPud,
+	.Lev = SimLev,
+	.Write = SimWrite,
+	.Delay = SimDelay,
+	.LevBank = SimLevBank,
+	.WriteMask = SimWriteMask,
+};
@@ -0,0 +1,53 @@
+/* Filename: gpiosim.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Simulated GPIO board. Input edges are scripted ahead of
+   time with nanosecond timestamps and every output write is recorded,
+   so the ring-in logic can be exercised and timed without a Pi.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef GPIOSIM_H
+#define GPIOSIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_MAX_PINS	54		// BCM2835 has 54 GPIOs
+#define SIM_BANK_PINS	32		// GPLEV0, the only inputs anything reads
+#define SIM_MAX_SCRIPT	65536		// scripted input edges
+#define SIM_MAX_LOG	65536		// recorded output writes
+
+typedef struct SimEvent {
+	uint64_t TimeNs;			// ns since the board was initialised
+	uint8_t Pin;				// BCM GPIO number
+	uint8_t Level;
+} SimEvent;
+
+/* Script an input edge. Edges may be added in any order and before or
+   after GPIOInit(); they take effect the first time a pin is read at or
+   after TimeNs. */
+int SimAddEdge(uint64_t TimeNs, uint8_t pin, uint8_t level);
+
+/* Load edges from a text file, one "<time_us> <gpio> <level>" per line.
+   Blank lines and lines starting with # are ignored. */
+int SimLoadScript(const char *path);
+
+/* Forget all scripted edges, recorded writes and pin levels. */
+void SimReset(void);
+
+/* Nanoseconds since the board was initialised. */
+uint64_t SimNow(void);
+
+/* Recorded output writes, oldest first. */
+size_t SimOutputLog(const SimEvent **log);
+unsigned long SimDroppedWrites(void);
+int SimDumpOutputLog(const char *path);
+
+#endif
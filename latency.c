@@ -0,0 +1,137 @@
+/* Filename: latency.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Pipeline latency histograms. See latency.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+
+#include "latency.h"
+
+LatHist LatStages[LAT_STAGES] = {
+	[LAT_THREAD]		= { .Name = "press -> player thread", .MinNs = UINT64_MAX },
+	[LAT_ARBITRATION]	= { .Name = "press -> arbitration", .MinNs = UINT64_MAX },
+	[LAT_LOCKOUT]		= { .Name = "press -> LOCKOUT_ASSERT", .MinNs = UINT64_MAX },
+	[LAT_ENABLE]		= { .Name = "press -> P*_ENABLE", .MinNs = UINT64_MAX },
+	[LAT_SERIAL]		= { .Name = "press -> serial write", .MinNs = UINT64_MAX },
+	[LAT_ARMED]		= { .Name = "Enabler -> armed", .MinNs = UINT64_MAX },
+	[LAT_WAKEUP]		= { .Name = "scanner wake-up late", .MinNs = UINT64_MAX },
+	[LAT_CANCEL]		= { .Name = "operator interrupt", .MinNs = UINT64_MAX },
+	[LAT_SERIAL_RX]		= { .Name = "MCP byte -> handled", .MinNs = UINT64_MAX },
+	[LAT_SERIAL_TX]		= { .Name = "MCP message queued -> sent", .MinNs = UINT64_MAX },
+};
+
+void LatHistRecord(LatHist *h, uint64_t ns)
+{
+	uint64_t seen;
+
+	atomic_fetch_add_explicit(&h->Buckets[LatBucket(ns)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->SumNs, ns, memory_order_relaxed);
+
+	seen = atomic_load_explicit(&h->MaxNs, memory_order_relaxed);
+	while(ns > seen && !atomic_compare_exchange_weak_explicit(&h->MaxNs, &seen, ns, memory_order_relaxed, memory_order_relaxed))
+		;
+	seen = atomic_load_explicit(&h->MinNs, memory_order_relaxed);
+	while(ns < seen && !atomic_compare_exchange_weak_explicit(&h->MinNs, &seen, ns, memory_order_relaxed, memory_order_relaxed))
+		;
+
+	/* Count last, so a reader never sees more samples than buckets */
+	atomic_fetch_add_explicit(&h->Count, 1, memory_order_release);
+}
+
+uint64_t LatHistPercentile(LatHist *h, double pct)
+{
+	uint64_t count = atomic_load_explicit(&h->Count, memory_order_acquire);
+	uint64_t want, seen = 0, max, top;
+	int i;
+
+	if(count == 0)
+		return 0;
+
+	want = (uint64_t)(count * pct / 100.0 + 0.5);
+	if(want < 1)
+		want = 1;
+
+	max = atomic_load_explicit(&h->MaxNs, memory_order_relaxed);
+	for(i = 0; i < LAT_BUCKETS; i++)
+	{
+		seen += atomic_load_explicit(&h->Buckets[i], memory_order_relaxed);
+		if(seen >= want)
+		{
+			/* report the top of the bucket, so a p99 is never flattering,
+			   but not more than we actually saw */
+			top = (i + 1 < LAT_BUCKETS) ? LatBucketFloor(i + 1) - 1 : max;
+			return top < max ? top : max;
+		}
+	}
+
+	return max;
+}
+
+void LatHistReset(LatHist *h)
+{
+	int i;
+
+	atomic_store(&h->Count, 0);
+	atomic_store(&h->SumNs, 0);
+	atomic_store(&h->MinNs, UINT64_MAX);
+	atomic_store(&h->MaxNs, 0);
+	for(i = 0; i < LAT_BUCKETS; i++)
+		atomic_store_explicit(&h->Buckets[i], 0, memory_order_relaxed);
+}
+
+uint64_t LatTotal(void)
+{
+	uint64_t total = 0;
+	int s;
+
+	/* the scanner's wake-ups tick along whether anyone's playing or not */
+	for(s = 0; s < LAT_STAGES; s++)
+		if(s != LAT_WAKEUP)
+			total += atomic_load(&LatStages[s].Count);
+
+	return total;
+}
+
+void LatDump(FILE *out)
+{
+	LatHist *h;
+	uint64_t count;
+	int s;
+
+	fprintf(out, "LatDump(): %-24s %8s %10s %10s %10s %10s %10s %10s %10s (us)\n",
+		"stage", "count", "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+	for(s = 0; s < LAT_STAGES; s++)
+	{
+		h = &LatStages[s];
+		count = atomic_load(&h->Count);
+		if(count == 0)
+			continue;
+
+		fprintf(out, "LatDump(): %-24s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			h->Name, (unsigned long long)count,
+			atomic_load(&h->MinNs) / 1000.0,
+			atomic_load(&h->SumNs) / 1000.0 / count,
+			LatHistPercentile(h, 50.0) / 1000.0,
+			LatHistPercentile(h, 90.0) / 1000.0,
+			LatHistPercentile(h, 99.0) / 1000.0,
+			LatHistPercentile(h, 99.9) / 1000.0,
+			atomic_load(&h->MaxNs) / 1000.0);
+	}
+	fflush(out);
+}
+
+void LatReset(void)
+{
+	int s;
+
+	for(s = 0; s < LAT_STAGES; s++)
+		LatHistReset(&LatStages[s]);
+}
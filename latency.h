@@ -0,0 +1,110 @@
+/* Filename: latency.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Pipeline latency probes. Each stage of a ring-in is
+   timed from the button edge and dropped into a log-linear (HDR
+   style) histogram: 16 buckets per power of two, so any value is
+   within about 6% of its bucket, from 1 ns up to centuries. Recording
+   is a couple of relaxed atomic adds, safe from any thread and cheap
+   enough to leave on at a show.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "clock.h"
+
+#define LAT_SUB_BITS	4
+#define LAT_SUB		(1 << LAT_SUB_BITS)
+#define LAT_BUCKETS	((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef enum LatStage {
+	LAT_THREAD,				// press edge -> player thread has it
+	LAT_ARBITRATION,			// press edge -> main() accepts the ring-in
+	LAT_LOCKOUT,				// press edge -> LOCKOUT_ASSERT written
+	LAT_ENABLE,				// press edge -> winner's P*_ENABLE light on
+	LAT_SERIAL,				// press edge -> ring-in handed to the kernel for the MCP
+	LAT_ARMED,				// Enabler edge -> player thread armed
+	LAT_WAKEUP,				// scanner's scheduled sample -> it actually woke
+	LAT_CANCEL,				// operator interrupt edge -> wait cut short / lights out
+	LAT_SERIAL_RX,				// MCP bytes read in -> frame handed to main()
+	LAT_SERIAL_TX,				// message for the MCP queued -> handed to the kernel
+	LAT_STAGES
+} LatStage;
+
+typedef struct LatHist {
+	const char *Name;
+	_Atomic uint64_t Count;
+	_Atomic uint64_t SumNs;
+	_Atomic uint64_t MinNs;
+	_Atomic uint64_t MaxNs;
+	_Atomic uint64_t Buckets[LAT_BUCKETS];
+} LatHist;
+
+extern LatHist LatStages[LAT_STAGES];
+
+static inline int LatBucket(uint64_t ns)
+{
+	int shift;
+
+	if(ns < LAT_SUB)
+		return (int)ns;
+
+	shift = 63 - __builtin_clzll(ns) - LAT_SUB_BITS;
+	return (shift + 1) * LAT_SUB + (int)((ns >> shift) & (LAT_SUB - 1));
+}
+
+/* Smallest value that lands in bucket i */
+static inline uint64_t LatBucketFloor(int i)
+{
+	if(i < LAT_SUB)
+		return (uint64_t)i;
+
+	return (uint64_t)(LAT_SUB + (i & (LAT_SUB - 1))) << (i / LAT_SUB - 1);
+}
+
+void LatHistRecord(LatHist *h, uint64_t ns);
+
+static inline void LatRecord(LatStage s, uint64_t ns)
+{
+	LatHistRecord(&LatStages[s], ns);
+}
+
+/* Record the time from startns (CLOCK_MONOTONIC) until now. A startns
+   of 0 means the start wasn't stamped, and nothing is recorded. */
+static inline void LatSince(LatStage s, uint64_t startns)
+{
+	uint64_t now;
+
+	if(startns == 0)
+		return;
+
+	now = ClockNow();
+	LatHistRecord(&LatStages[s], now > startns ? now - startns : 0);
+}
+
+/* Value at or below which pct percent of the samples fall, rounded up
+   to the top of its bucket. 0 when there are no samples. */
+uint64_t LatHistPercentile(LatHist *h, double pct);
+
+void LatHistReset(LatHist *h);
+
+/* Samples recorded over every ring-in stage, to tell if anything happened */
+uint64_t LatTotal(void);
+
+/* One line per stage that has samples: count, min, p50, p90, p99, p99.9, max */
+void LatDump(FILE *out);
+void LatReset(void);
+
+#endif
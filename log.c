@@ -0,0 +1,265 @@
+/* Filename: log.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Console logging off the hot path. See log.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "clock.h"
+#include "log.h"
+
+_Atomic int LogMaxLevel = LOG_DEBUG;
+
+static LogRing *_Atomic Rings[LOG_MAX_THREADS];
+static _Atomic int RingCount = 0;
+static _Thread_local LogRing *Mine = NULL;
+static _Thread_local bool NoRing = false;
+
+static FILE *Out = NULL;
+static int Rate = 0;
+static _Atomic bool Running = false;
+static _Atomic bool Stopping = false;
+static pthread_t Writer;
+
+static const char *LevelNames[] = { "error", "warn", "info", "debug" };
+
+/* The calling thread's ring, set up the first time it logs */
+static LogRing *LogMine(void)
+{
+	LogRing *r;
+	int i;
+
+	if(Mine != NULL || NoRing)
+		return Mine;
+
+	i = atomic_fetch_add(&RingCount, 1);
+	if(i >= LOG_MAX_THREADS)
+	{
+		NoRing = true;
+		return NULL;
+	}
+
+	r = aligned_alloc(64, sizeof(LogRing));
+	if(r == NULL)
+	{
+		NoRing = true;
+		return NULL;
+	}
+	memset(r, 0, sizeof(*r));
+	atomic_store_explicit(&Rings[i], r, memory_order_release);
+	Mine = r;
+
+	return r;
+}
+
+void LogPrintf(LogLevel level, const char *fmt, ...)
+{
+	LogRing *r;
+	LogRecord *rec;
+	uint32_t head;
+	uint64_t now, second;
+	va_list ap;
+	int len;
+
+	if((int)level > atomic_load_explicit(&LogMaxLevel, memory_order_relaxed)
+		|| !atomic_load_explicit(&Running, memory_order_relaxed))
+		return;
+	if((r = LogMine()) == NULL)
+		return;
+
+	/* so many lines a second below LOG_WARN */
+	now = MonotonicNs();
+	if(Rate > 0 && level > LOG_WARN)
+	{
+		second = now / 1000000000ull;
+		if(second != r->Window)
+		{
+			r->Window = second;
+			r->InWindow = 0;
+		}
+		if(r->InWindow >= (uint32_t)Rate)
+		{
+			atomic_fetch_add_explicit(&r->Limited, 1, memory_order_relaxed);
+			return;
+		}
+		r->InWindow++;
+	}
+
+	head = atomic_load_explicit(&r->Head, memory_order_relaxed);
+	if(head - atomic_load_explicit(&r->Tail, memory_order_acquire) >= LOG_RING_RECORDS)
+	{
+		atomic_fetch_add_explicit(&r->Dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	rec = &r->Records[head & (LOG_RING_RECORDS - 1)];
+	va_start(ap, fmt);
+	len = vsnprintf(rec->Text, sizeof(rec->Text), fmt, ap);
+	va_end(ap);
+	if(len < 0)
+		len = 0;
+	if(len >= (int)sizeof(rec->Text))
+	{
+		/* cut short, but still a line of its own */
+		len = sizeof(rec->Text) - 1;
+		rec->Text[len - 1] = '\n';
+	}
+	rec->Len = len;
+	rec->Level = level;
+	rec->TimeNs = now;
+
+	atomic_store_explicit(&r->Head, head + 1, memory_order_release);
+}
+
+void LogLost(uint64_t *dropped, uint64_t *limited)
+{
+	LogRing *r;
+	int i, n = atomic_load(&RingCount);
+
+	*dropped = 0;
+	*limited = 0;
+	for(i = 0; i < n && i < LOG_MAX_THREADS; i++)
+	{
+		if((r = atomic_load_explicit(&Rings[i], memory_order_acquire)) == NULL)
+			continue;
+		*dropped += atomic_load_explicit(&r->Dropped, memory_order_relaxed);
+		*limited += atomic_load_explicit(&r->Limited, memory_order_relaxed);
+	}
+}
+
+/* Write out everything in the rings, oldest line first whichever
+   thread it came from. Returns the number of lines. */
+static int LogDrain(void)
+{
+	LogRing *r, *oldest;
+	LogRecord *rec;
+	uint32_t tail;
+	uint64_t oldestns;
+	int i, n, lines = 0;
+
+	while(1)
+	{
+		oldest = NULL;
+		oldestns = 0;
+		n = atomic_load(&RingCount);
+		for(i = 0; i < n && i < LOG_MAX_THREADS; i++)
+		{
+			if((r = atomic_load_explicit(&Rings[i], memory_order_acquire)) == NULL)
+				continue;
+			tail = atomic_load_explicit(&r->Tail, memory_order_relaxed);
+			if(tail == atomic_load_explicit(&r->Head, memory_order_acquire))
+				continue;
+			rec = &r->Records[tail & (LOG_RING_RECORDS - 1)];
+			if(oldest == NULL || rec->TimeNs < oldestns)
+			{
+				oldest = r;
+				oldestns = rec->TimeNs;
+			}
+		}
+		if(oldest == NULL)
+			return lines;
+
+		tail = atomic_load_explicit(&oldest->Tail, memory_order_relaxed);
+		rec = &oldest->Records[tail & (LOG_RING_RECORDS - 1)];
+		fwrite(rec->Text, 1, rec->Len, Out);
+		atomic_store_explicit(&oldest->Tail, tail + 1, memory_order_release);
+		lines++;
+	}
+}
+
+static void *LogThread(void *arg)
+{
+	struct timespec ts = { 0, LOG_FLUSH_MS * 1000000L };
+	uint64_t dropped, limited, lastdropped = 0, lastlimited = 0, lastreport = 0, now;
+
+	(void)arg;
+	while(1)
+	{
+		if(LogDrain() > 0)
+			fflush(Out);
+
+		/* say what went missing, once a second at most */
+		now = MonotonicNs();
+		if(now - lastreport >= 1000000000ull)
+		{
+			LogLost(&dropped, &limited);
+			if(dropped != lastdropped || limited != lastlimited)
+			{
+				fprintf(Out, "LogThread(): %llu lines dropped with the ring full, %llu over the rate limit so far\n",
+					(unsigned long long)dropped, (unsigned long long)limited);
+				fflush(Out);
+				lastdropped = dropped;
+				lastlimited = limited;
+			}
+			lastreport = now;
+		}
+
+		if(atomic_load(&Stopping))
+			break;
+		nanosleep(&ts, NULL);
+	}
+
+	/* anything logged while we were last writing */
+	if(LogDrain() > 0)
+		fflush(Out);
+	return NULL;
+}
+
+int LogStart(FILE *out, LogLevel level, int rate)
+{
+	if(atomic_load(&Running))
+		return 0;
+
+	Out = out;
+	Rate = rate;
+	atomic_store(&LogMaxLevel, level);
+	atomic_store(&Stopping, false);
+	if(pthread_create(&Writer, NULL, LogThread, NULL) != 0)
+		return -1;
+	atomic_store(&Running, true);
+
+	return 0;
+}
+
+void LogStop(void)
+{
+	if(!atomic_load(&Running))
+		return;
+
+	atomic_store(&Running, false);
+	atomic_store(&Stopping, true);
+	pthread_join(Writer, NULL);
+}
+
+int LogParse(const char *arg, LogLevel *level, int *rate)
+{
+	const char *colon = strchr(arg, ':');
+	size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+	int i;
+
+	for(i = 0; i <= LOG_DEBUG; i++)
+	{
+		if(strlen(LevelNames[i]) == len && strncmp(arg, LevelNames[i], len) == 0)
+		{
+			*level = i;
+			if(colon != NULL)
+				*rate = atoi(colon + 1);
+			return 0;
+		}
+	}
+
+	printf("LogParse(): can't make sense of '%s' (error, warn, info or debug, then :lines-per-second if wanted)\n", arg);
+	return -1;
+}
@@ -0,0 +1,83 @@
+/* Filename: log.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Console logging off the hot path. printf() takes the
+   stdout lock and blocks as long as the terminal does, so a slow SSH
+   session could hold up a player thread in the middle of a ring-in.
+   LogPrintf() formats into the calling thread's own ring instead,
+   never blocks and never takes a lock; LogThread() picks the lines up
+   every few ms, in time order across threads, and does the writing.
+
+   A full ring drops the line and counts it. Below LOG_WARN each thread
+   gets so many lines a second and the rest are counted as rate
+   limited; both counts go to the console once a second while they
+   grow.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define LOG_RING_RECORDS	256		// per thread, must be a power of 2
+#define LOG_TEXT		116		// longest line kept, newline included
+#define LOG_MAX_THREADS		32
+#define LOG_FLUSH_MS		10		// how often LogThread() looks
+#define LOG_DEFAULT_RATE	200		// lines a second per thread below LOG_WARN
+
+typedef enum LogLevel {
+	LOG_ERROR,
+	LOG_WARN,
+	LOG_INFO,
+	LOG_DEBUG
+} LogLevel;
+
+typedef struct LogRecord {
+	uint64_t TimeNs;			// MonotonicNs(), for the merge
+	uint8_t Level;
+	uint8_t Len;
+	char Text[LOG_TEXT];
+} LogRecord;
+
+/* One per thread that logs, written only by it */
+typedef struct LogRing {
+	_Atomic uint32_t Head;			// next record the thread writes
+	_Atomic uint32_t Tail;			// next record LogThread() reads
+	_Atomic uint64_t Dropped;		// ring was full
+	_Atomic uint64_t Limited;		// over the thread's rate
+	uint64_t Window;			// current second, and lines in it
+	uint32_t InWindow;
+	LogRecord Records[LOG_RING_RECORDS];
+} LogRing;
+
+extern _Atomic int LogMaxLevel;			// lines above this are skipped before formatting
+
+/* Start the writer on out, keeping lines up to level, rate lines a
+   second per thread below LOG_WARN (0 for no limit). Until then, and
+   after LogStop(), lines are thrown away. */
+int LogStart(FILE *out, LogLevel level, int rate);
+
+/* Write out what's left and stop the writer */
+void LogStop(void);
+
+/* "error", "warn", "info" or "debug", then ":rate" if wanted; -1 if
+   it makes no sense */
+int LogParse(const char *arg, LogLevel *level, int *rate);
+
+/* printf() for any thread; costs a vsnprintf() and never blocks */
+void LogPrintf(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* Lines thrown away so far, ring full and rate limited */
+void LogLost(uint64_t *dropped, uint64_t *limited);
+
+#endif
@@ -0,0 +1,835 @@
+/* Filename: mcpsim.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: MCP simulator. Testing SerialThread() used to mean the
+   Arduino on /dev/ttyS0 (or archive/sertest.c echoing by hand). This
+   makes a pty pair, starts jeopardy-ringin with -S pointed at the
+   slave end, and plays the MCP on the master end from a script: it
+   pairs in either protocol, sends lightbar term requests and penalties,
+   fires bursts of traffic, and waits for the ring-ins and time-outs the
+   daemon sends back. Round trips and burst throughput are timed, so
+   the serial path can be measured with no hardware at all.
+
+   It also takes the MCP's side of changing speed (see serproto.h),
+   answering FRAME_BAUD and FRAME_PING. A pty has no wire, so each
+   byte costs the time it would take at the rate both ends are set to
+   (the master sees the speed the daemon set on its end), and if the
+   two rates differ, or the line is flaky at that rate, nothing gets
+   through either way.
+
+   Usage: jeopardy-mcp [-f script] [-L daemon-log] [-- daemon args...]
+   The daemon is "./jeopardy-ringin -g sim -r none -s 0 -l warn" on a
+   -m map that keeps every button off the Enabler's line, unless args
+   are given after --; "-S <pty>" is added either way. Its console
+   goes to daemon-log (default /dev/null). Exits nonzero if any script
+   line fails.
+
+   Script, one command a line, # for comments:
+	expect ready|ack|ringin|timeout <player|-> <ms>
+				wait up to ms for it from the daemon
+	expect baud <rate> <ms>	wait for the daemon to keep a new rate
+	baud <rate>		the fastest the MCP will switch to, 0 to
+				ignore FRAME_BAUD like older firmware
+				(default 1000000)
+	flaky <rate>		nothing gets through at this rate or
+				faster, 0 for a clean line (the default)
+	quiet <ms>		no ring-in or time-out for ms
+	pair legacy|framed [n]	n pairing requests ('!' or FRAME_PAIR_REQ),
+				each waiting for its ack: the round trip
+	burst <n> legacy|framed	n pairing requests in one write, then all
+				n acks: the throughput
+	end <player> legacy|framed
+				lightbar term request ('7'-'9' or
+				FRAME_COUNTDOWN_END)
+	penalty <ms>		FRAME_PENALTY
+	wait <ms>
+   Once the daemon has had a good frame it stops listening to the old
+   single bytes, so put the legacy lines first. Without -f it runs a
+   built-in script that does a little of everything. The default daemon
+   then also gets a sim press script (-i) to go with it, so there are
+   rounds to play: one whose countdown the MCP ends while it's running,
+   and one left to run out.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "clock.h"
+#include "serproto.h"
+#include "serlink.h"
+
+#define MCP_MAX_EVENTS		4096
+#define MCP_MAX_SAMPLES		10000
+#define MCP_BURST_MAX		2000
+#define MCP_REPLY_MAX		(8 * FRAME_MAX)
+
+static const char *DefaultScript[] = {
+	"expect ready - 5000",
+	"expect ringin 1 3000",		// DefaultPresses' first round...
+	"end 1 legacy",			// ...cut short with the countdown running
+	"pair legacy 200",
+	"burst 200 legacy",
+	"end 2 legacy",
+	"end 3 legacy",
+	"flaky 921600",
+	"pair framed",
+	"expect baud 500000 5000",
+	"pair framed 200",
+	"burst 500 framed",
+	"penalty 250",
+	"end 3 framed",
+	"quiet 200",
+	"expect ringin 2 10000",	// the second round, framed now...
+	"expect timeout 2 8000",	// ...left to run out
+	"quiet 200",			// one ring-in a round, and P1's never ran out
+	NULL
+};
+
+/* What the buttons do under DefaultScript, "<time_us> <gpio> <level>"
+   from the daemon's GPIO init: the Enabler (GPIO 22) goes live and P1
+   (17) rings in, then well after the pairing and bursts P2 (27) does.
+   Letting go of the Enabler puts out any countdown, so the first round
+   stays live past the 5 s P1's would have run if the MCP hadn't ended it */
+static const char *DefaultPresses[] = {
+	"500000 22 0",
+	"600000 17 0",
+	"700000 17 1",
+	"7000000 22 1",
+	"7500000 22 0",
+	"7600000 27 0",
+	"7700000 27 1",
+	"14000000 22 1",
+	NULL
+};
+
+/* -m: with the default pins Player 3's button is the Enabler, and
+   whether that press beats P1's depends on thread timing */
+static const char *DefaultDaemon[] = { "./jeopardy-ringin", "-g", "sim", "-r", "none", "-s", "0", "-l", "warn", "-b", "1000000",
+	"-m", "17:5:4,27:6:3,23:13:2", NULL };
+
+typedef enum McpEventType {
+	MCP_READY,
+	MCP_ACK,
+	MCP_RINGIN,
+	MCP_TIMEOUT,
+	MCP_BAUD
+} McpEventType;
+
+static const char *McpEventNames[] = { "ready", "ack", "ringin", "timeout", "baud" };
+
+typedef struct McpEvent {
+	McpEventType Type;
+	int Player;				// 0 if it doesn't say; the rate for MCP_BAUD
+	bool Framed;
+	uint64_t Ns;				// when we parsed it
+} McpEvent;
+
+typedef struct Mcp {
+	int Fd;					// pty master
+	pid_t Daemon;
+	uint16_t TxSeq;
+
+	int Baud;				// what the MCP's UART is at
+	int MaxBaud;				// the fastest it'll agree to, 0 for none
+	int FlakyBaud;				// nothing gets through at this or faster
+	uint64_t RevertNs;			// back to the base rate unless kept by then
+	int PendingBaud;			// switch to this once the reply's gone
+	uint8_t Reply[MCP_REPLY_MAX];		// answers to FRAME_BAUD and FRAME_PING
+	size_t ReplyLen;
+
+	uint8_t Rx[1024];			// bytes from the daemon not yet made sense of
+	size_t Have;
+	McpEvent Events[MCP_MAX_EVENTS];	// parsed, not yet taken
+	int Head, Tail;
+
+	unsigned long BytesIn, BytesOut;
+	unsigned long Unknown;			// bytes that were neither a frame nor an old command
+	unsigned long BadCrc;
+	unsigned long Dropped;			// events nobody waited for, once the queue filled
+	unsigned long Garbled;			// bytes lost to mismatched rates or a flaky line
+	unsigned long Pongs;
+	uint64_t Samples[MCP_MAX_SAMPLES];
+} Mcp;
+
+static void McpPush(Mcp *m, McpEventType type, int player, bool framed)
+{
+	McpEvent *ev;
+
+	if(m->Head - m->Tail == MCP_MAX_EVENTS)
+	{
+		m->Dropped++;
+		m->Tail++;
+	}
+	ev = &m->Events[m->Head++ % MCP_MAX_EVENTS];
+	ev->Type = type;
+	ev->Player = player;
+	ev->Framed = framed;
+	ev->Ns = MonotonicNs();
+}
+
+/* The daemon's end of the pty, as the master sees it */
+static int McpLineBaud(Mcp *m)
+{
+	static const struct { speed_t Speed; int Rate; } rates[] = {
+		{ B9600, 9600 }, { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 }, { B115200, 115200 },
+		{ B230400, 230400 }, { B460800, 460800 }, { B500000, 500000 }, { B921600, 921600 }, { B1000000, 1000000 }
+	};
+	struct termios t;
+	speed_t speed;
+	size_t i;
+
+	if(tcgetattr(m->Fd, &t) != 0)
+		return 0;
+	speed = cfgetospeed(&t);
+	for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+		if(rates[i].Speed == speed)
+			return rates[i].Rate;
+	return 0;
+}
+
+/* Whether bytes get through: both ends at the same rate, on a line
+   that's good at it */
+static bool McpLineOK(Mcp *m)
+{
+	if(m->RevertNs != 0 && MonotonicNs() >= m->RevertNs)
+	{
+		/* never told to keep it */
+		m->Baud = SERLINK_BASE_BAUD;
+		m->RevertNs = 0;
+	}
+	return McpLineBaud(m) == m->Baud && (m->FlakyBaud == 0 || m->Baud < m->FlakyBaud);
+}
+
+/* What n bytes take on the wire at the MCP's rate, 10 bits each */
+static void McpWire(Mcp *m, size_t n)
+{
+	uint64_t ns = (uint64_t)n * 10000000000ull / m->Baud;
+	struct timespec ts = { ns / 1000000000ull, ns % 1000000000ull };
+
+	nanosleep(&ts, NULL);
+}
+
+static void McpReply(Mcp *m, uint8_t type, const void *payload, uint8_t len)
+{
+	if(m->ReplyLen + FRAME_MAX <= sizeof(m->Reply))
+		m->ReplyLen += FrameEncode(m->Reply + m->ReplyLen, type, m->TxSeq++, (uint32_t)(MonotonicNs() / 1000), payload, len);
+}
+
+/* FRAME_BAUD: a new rate to go to, or the one we're at to keep it */
+static void McpBaud(Mcp *m, int rate)
+{
+	uint8_t payload[4];
+	int pick = 0, i;
+
+	if(m->MaxBaud == 0)
+		return;
+	if(rate == m->Baud && m->RevertNs != 0)
+	{
+		m->RevertNs = 0;
+		McpPush(m, MCP_BAUD, rate, true);
+		return;
+	}
+
+	pick = rate < m->MaxBaud ? rate : m->MaxBaud;
+	if(!SerLinkBaudSupported(pick))
+		pick = 0;
+	for(i = 0; i < 4; i++)
+		payload[i] = (pick >> (8 * i)) & 0xff;
+	McpReply(m, FRAME_BAUD_ACK, payload, 4);
+	if(pick == 0)
+		return;
+
+	/* the ack goes out at the old rate, then we switch */
+	m->PendingBaud = pick;
+}
+
+/* Split what the daemon sent into frames and old single bytes. A frame
+   starts with FRAME_SYNC and has to pass its CRC; anything else is
+   taken a byte at a time. Returns how many bytes were used. */
+static size_t McpDecode(Mcp *m, const uint8_t *b, size_t n)
+{
+	size_t size;
+	uint16_t crc;
+
+	if(b[0] == FRAME_SYNC)
+	{
+		if(n < 4)
+			return 0;
+		size = FRAME_HEADER + b[3] + FRAME_CRC;
+		if(b[1] != FRAME_VERSION || b[3] > FRAME_MAX_PAYLOAD)
+		{
+			m->Unknown++;
+			return 1;
+		}
+		if(n < size)
+			return 0;
+		crc = b[size - 2] | (b[size - 1] << 8);
+		if(FrameCrc(b + 1, size - 3) != crc)
+		{
+			m->BadCrc++;
+			return 1;
+		}
+
+		switch(b[2])
+		{
+			case FRAME_READY:
+				McpPush(m, MCP_READY, 0, true);
+				break;
+			case FRAME_PAIR_ACK:
+				McpPush(m, MCP_ACK, 0, true);
+				break;
+			case FRAME_RINGIN:
+				McpPush(m, MCP_RINGIN, b[3] > 0 ? b[FRAME_HEADER] : 0, true);
+				break;
+			case FRAME_TIMED_OUT:
+				McpPush(m, MCP_TIMEOUT, b[3] > 0 ? b[FRAME_HEADER] : 0, true);
+				break;
+			case FRAME_BAUD:
+				if(b[3] >= 4)
+					McpBaud(m, b[10] | (b[11] << 8) | (b[12] << 16) | ((uint32_t)b[13] << 24));
+				break;
+			case FRAME_PING:
+				McpReply(m, FRAME_PONG, b + FRAME_HEADER, b[3]);
+				m->Pongs++;
+				break;
+			default:
+				m->Unknown += size;
+				break;
+		}
+		return size;
+	}
+
+	if(b[0] == 'S')
+	{
+		if(n < 8)
+			return memcmp(b, "SReady\r\n", n) == 0 ? 0 : (m->Unknown++, 1);
+		if(memcmp(b, "SReady\r\n", 8) == 0)
+		{
+			McpPush(m, MCP_READY, 0, false);
+			return 8;
+		}
+	}
+
+	if(b[0] == '@')
+		McpPush(m, MCP_ACK, 0, false);
+	else if(b[0] >= '1' && b[0] <= '3')
+		McpPush(m, MCP_RINGIN, b[0] - '0', false);
+	else if(b[0] >= '4' && b[0] <= '6')
+		McpPush(m, MCP_TIMEOUT, b[0] - '3', false);
+	else
+		m->Unknown++;
+	return 1;
+}
+
+/* Straight out, for replies, without taking anything in meanwhile */
+static void McpPut(Mcp *m, const uint8_t *d, size_t len)
+{
+	struct pollfd p = { m->Fd, POLLOUT, 0 };
+	ssize_t got;
+
+	if(!McpLineOK(m))
+	{
+		m->Garbled += len;
+		return;
+	}
+	McpWire(m, len);
+	while(len > 0)
+	{
+		got = write(m->Fd, d, len);
+		if(got < 0 && errno == EAGAIN)
+		{
+			poll(&p, 1, 10);
+			continue;
+		}
+		if(got <= 0)
+			return;
+		m->BytesOut += got;
+		d += got;
+		len -= got;
+	}
+}
+
+/* Take in whatever the daemon has sent, waiting up to ms for it */
+static void McpPump(Mcp *m, int ms)
+{
+	struct pollfd p = { m->Fd, POLLIN, 0 };
+	ssize_t got;
+	size_t used, at;
+
+	if(poll(&p, 1, ms) <= 0)
+		return;
+
+	while((got = read(m->Fd, m->Rx + m->Have, sizeof(m->Rx) - m->Have)) > 0)
+	{
+		if(!McpLineOK(m))
+		{
+			m->Garbled += got;
+			continue;
+		}
+		McpWire(m, got);
+		m->BytesIn += got;
+		m->Have += got;
+		for(at = 0; at < m->Have; at += used)
+		{
+			used = McpDecode(m, m->Rx + at, m->Have - at);
+			if(used == 0)
+				break;
+		}
+		memmove(m->Rx, m->Rx + at, m->Have - at);
+		m->Have -= at;
+
+		if(m->ReplyLen > 0)
+		{
+			McpPut(m, m->Reply, m->ReplyLen);
+			m->ReplyLen = 0;
+		}
+		if(m->PendingBaud != 0)
+		{
+			m->Baud = m->PendingBaud;
+			m->PendingBaud = 0;
+			m->RevertNs = MonotonicNs() + SERLINK_BAUD_REVERT_MS * 1000000ull;
+		}
+	}
+}
+
+/* The next event of type (any player if player is 0), waiting up to
+   ms. Events of other types that come first are thrown away, except
+   ring-ins, time-outs and rate changes, which stay for a later expect. */
+static bool McpWait(Mcp *m, McpEventType type, int player, int ms, McpEvent *out)
+{
+	uint64_t until = MonotonicNs() + (uint64_t)ms * 1000000ull, now;
+	McpEvent *ev;
+	int i;
+
+	while(1)
+	{
+		for(i = m->Tail; i < m->Head; i++)
+		{
+			ev = &m->Events[i % MCP_MAX_EVENTS];
+			if(ev->Type == type && (player == 0 || ev->Player == player))
+			{
+				*out = *ev;
+				/* take it out, keeping the order of the rest */
+				for(; i > m->Tail; i--)
+					m->Events[i % MCP_MAX_EVENTS] = m->Events[(i - 1) % MCP_MAX_EVENTS];
+				m->Tail++;
+				return true;
+			}
+		}
+		while(m->Tail < m->Head && m->Events[m->Tail % MCP_MAX_EVENTS].Type < MCP_RINGIN)
+			m->Tail++;
+
+		now = MonotonicNs();
+		if(now >= until)
+			return false;
+		McpPump(m, (int)((until - now + 999999) / 1000000));
+	}
+}
+
+static void McpWrite(Mcp *m, const void *data, size_t len)
+{
+	const uint8_t *d = data;
+	ssize_t got;
+
+	if(!McpLineOK(m))
+	{
+		m->Garbled += len;
+		return;
+	}
+	McpWire(m, len);
+	while(len > 0)
+	{
+		got = write(m->Fd, d, len);
+		if(got < 0 && errno == EAGAIN)
+		{
+			/* the daemon isn't keeping up; take in what it's said meanwhile */
+			McpPump(m, 1);
+			continue;
+		}
+		if(got <= 0)
+			return;
+		m->BytesOut += got;
+		d += got;
+		len -= got;
+	}
+}
+
+static size_t McpFrame(Mcp *m, uint8_t *out, uint8_t type, const void *payload, uint8_t len)
+{
+	return FrameEncode(out, type, m->TxSeq++, (uint32_t)(MonotonicNs() / 1000), payload, len);
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void McpPercentiles(const char *what, uint64_t *samples, size_t n)
+{
+	if(n == 0)
+		return;
+
+	qsort(samples, n, sizeof(samples[0]), CompareU64);
+	printf("mcpsim: %s: n=%zu min %.1f p50 %.1f p99 %.1f max %.1f us\n", what, n,
+		samples[0] / 1000.0, samples[n / 2] / 1000.0, samples[n * 99 / 100] / 1000.0, samples[n - 1] / 1000.0);
+}
+
+static bool McpFramed(const char *mode)
+{
+	return mode != NULL && strcmp(mode, "framed") == 0;
+}
+
+/* n pairing requests one at a time, each round trip timed */
+static bool McpPair(Mcp *m, bool framed, int n)
+{
+	uint8_t frame[FRAME_MAX];
+	size_t size;
+	uint64_t sent;
+	McpEvent ev;
+	char label[64];
+	int i;
+
+	if(n > MCP_MAX_SAMPLES)
+		n = MCP_MAX_SAMPLES;
+	for(i = 0; i < n; i++)
+	{
+		sent = MonotonicNs();
+		if(framed)
+		{
+			size = McpFrame(m, frame, FRAME_PAIR_REQ, NULL, 0);
+			McpWrite(m, frame, size);
+		}
+		else
+			McpWrite(m, "!", 1);
+
+		if(!McpWait(m, MCP_ACK, 0, 1000, &ev))
+		{
+			printf("mcpsim: pair %s: no ack for request %d\n", framed ? "framed" : "legacy", i + 1);
+			return false;
+		}
+		if(ev.Framed != framed)
+		{
+			printf("mcpsim: pair %s: acked %s\n", framed ? "framed" : "legacy", ev.Framed ? "framed" : "legacy");
+			return false;
+		}
+		m->Samples[i] = ev.Ns - sent;
+	}
+
+	snprintf(label, sizeof(label), "pair %s round trip", framed ? "framed" : "legacy");
+	McpPercentiles(label, m->Samples, n);
+	return true;
+}
+
+/* n pairing requests in one write, then all n acks */
+static bool McpBurst(Mcp *m, bool framed, int n)
+{
+	static uint8_t out[MCP_BURST_MAX * (FRAME_HEADER + FRAME_CRC)];
+	size_t size = 0;
+	uint64_t start, last = 0, ns;
+	McpEvent ev;
+	int i, acks = 0;
+
+	if(n > MCP_BURST_MAX)
+		n = MCP_BURST_MAX;
+	for(i = 0; i < n; i++)
+	{
+		if(framed)
+			size += McpFrame(m, out + size, FRAME_PAIR_REQ, NULL, 0);
+		else
+			out[size++] = '!';
+	}
+
+	start = MonotonicNs();
+	McpWrite(m, out, size);
+	while(acks < n && McpWait(m, MCP_ACK, 0, 1000, &ev))
+	{
+		acks++;
+		last = ev.Ns;
+	}
+
+	ns = last > start ? last - start : 1;
+	printf("mcpsim: burst of %d %s pairing requests: %d acks in %.2f ms, %.0f round trips/s, %.0f bytes/s each way\n",
+		n, framed ? "framed" : "legacy", acks, ns / 1e6, acks * 1e9 / ns, size * 1e9 / ns);
+	return acks == n;
+}
+
+static bool McpRun(Mcp *m, const char *line, int lineno)
+{
+	char cmd[16], a[16], b[16];
+	uint8_t frame[FRAME_MAX], payload[2];
+	size_t size;
+	McpEvent ev;
+	uint64_t until, now;
+	int i, n, type;
+
+	n = sscanf(line, "%15s %15s %15s", cmd, a, b);
+	if(n < 1 || cmd[0] == '#')
+		return true;
+
+	if(strcmp(cmd, "expect") == 0 && n == 3)
+	{
+		for(type = 0; type <= MCP_BAUD; type++)
+			if(strcmp(a, McpEventNames[type]) == 0)
+				break;
+		if(type > MCP_BAUD || sscanf(line, "%*s %*s %15s %d", b, &i) != 2)
+			goto bad;
+		if(!McpWait(m, type, atoi(b), i, &ev))
+		{
+			printf("mcpsim: line %d: no %s from %s in %d ms\n", lineno, a, b, i);
+			return false;
+		}
+		if(type == MCP_BAUD)
+			printf("mcpsim: line %d: daemon kept %d baud, %lu pings answered so far\n", lineno, ev.Player, m->Pongs);
+		else if(ev.Player)
+			printf("mcpsim: line %d: %s %s P%d\n", lineno, ev.Framed ? "framed" : "legacy", a, ev.Player);
+		else
+			printf("mcpsim: line %d: %s %s\n", lineno, ev.Framed ? "framed" : "legacy", a);
+		return true;
+	}
+	if(strcmp(cmd, "quiet") == 0 && n == 2)
+	{
+		if(McpWait(m, MCP_RINGIN, 0, atoi(a), &ev) || McpWait(m, MCP_TIMEOUT, 0, 0, &ev))
+		{
+			printf("mcpsim: line %d: %s from P%d when it should be quiet\n", lineno, McpEventNames[ev.Type], ev.Player);
+			return false;
+		}
+		return true;
+	}
+	if(strcmp(cmd, "pair") == 0 && n >= 2)
+		return McpPair(m, McpFramed(a), n == 3 ? atoi(b) : 1);
+	if(strcmp(cmd, "burst") == 0 && n == 3)
+		return McpBurst(m, McpFramed(b), atoi(a));
+	if(strcmp(cmd, "end") == 0 && n == 3)
+	{
+		i = atoi(a);
+		if(i < 1 || i > 9)
+			goto bad;
+		if(McpFramed(b))
+		{
+			payload[0] = i;
+			size = McpFrame(m, frame, FRAME_COUNTDOWN_END, payload, 1);
+			McpWrite(m, frame, size);
+		}
+		else
+		{
+			frame[0] = '6' + i;
+			McpWrite(m, frame, 1);
+		}
+		return true;
+	}
+	if(strcmp(cmd, "penalty") == 0 && n == 2)
+	{
+		i = atoi(a);
+		payload[0] = i & 0xff;
+		payload[1] = i >> 8;
+		size = McpFrame(m, frame, FRAME_PENALTY, payload, 2);
+		McpWrite(m, frame, size);
+		return true;
+	}
+	if(strcmp(cmd, "baud") == 0 && n == 2)
+	{
+		m->MaxBaud = atoi(a);
+		return true;
+	}
+	if(strcmp(cmd, "flaky") == 0 && n == 2)
+	{
+		m->FlakyBaud = atoi(a);
+		return true;
+	}
+	if(strcmp(cmd, "wait") == 0 && n == 2)
+	{
+		/* still answering pings and rate changes meanwhile */
+		until = MonotonicNs() + atoi(a) * 1000000ull;
+		while((now = MonotonicNs()) < until)
+			McpPump(m, (int)((until - now + 999999) / 1000000));
+		return true;
+	}
+
+bad:
+	printf("mcpsim: line %d: can't make sense of '%s'\n", lineno, line);
+	return false;
+}
+
+/* A pty for the daemon to take as its serial port */
+static int McpOpenPty(char *slave, size_t len)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+	if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, slave, len) != 0)
+		return -1;
+	return fd;
+}
+
+/* DefaultPresses in a file for the daemon's -i; returns its path */
+static char *McpWritePresses(void)
+{
+	static char path[] = "/tmp/jeopardy-mcp-presses-XXXXXX";
+	FILE *f;
+	int fd, i;
+
+	fd = mkstemp(path);
+	if(fd < 0 || (f = fdopen(fd, "w")) == NULL)
+		return NULL;
+	for(i = 0; DefaultPresses[i] != NULL; i++)
+		fprintf(f, "%s\n", DefaultPresses[i]);
+	fclose(f);
+	return path;
+}
+
+static pid_t McpStartDaemon(char **args, int nargs, const char *presses, const char *slave, const char *log)
+{
+	const char **argv = calloc(nargs + 5, sizeof(char *));
+	pid_t pid;
+	int i, fd;
+
+	for(i = 0; i < nargs; i++)
+		argv[i] = args[i];
+	if(presses != NULL)
+	{
+		argv[i++] = "-i";
+		argv[i++] = presses;
+	}
+	argv[i++] = "-S";
+	argv[i++] = slave;
+	argv[i] = NULL;
+
+	pid = fork();
+	if(pid == 0)
+	{
+		fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd >= 0)
+		{
+			dup2(fd, 1);
+			dup2(fd, 2);
+		}
+		execv(argv[0], (char **)argv);
+		_exit(127);
+	}
+
+	free(argv);
+	return pid;
+}
+
+int main(int argc, char *argv[])
+{
+	static Mcp m;
+	const char *script = NULL, *log = "/dev/null";
+	char slave[64], line[256], *presses = NULL;
+	char **dargs = (char **)DefaultDaemon;
+	int ndargs = sizeof(DefaultDaemon) / sizeof(DefaultDaemon[0]) - 1;
+	int opt, lineno = 0, failed = 0, status;
+	uint64_t start;
+	FILE *f = NULL;
+
+	while((opt = getopt(argc, argv, "f:L:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'f':
+				script = optarg;
+				break;
+			case 'L':
+				log = optarg;
+				break;
+			default:
+				printf("usage: %s [-f script] [-L daemon-log] [-- daemon args...]\n", argv[0]);
+				return 1;
+		}
+	}
+	if(optind < argc)
+	{
+		dargs = argv + optind;
+		ndargs = argc - optind;
+	}
+
+	if(script != NULL && (f = fopen(script, "r")) == NULL)
+	{
+		printf("mcpsim: can't open %s\n", script);
+		return 1;
+	}
+
+	m.Baud = SERLINK_BASE_BAUD;
+	m.MaxBaud = SERLINK_MAX_BAUD;
+	m.Fd = McpOpenPty(slave, sizeof(slave));
+	if(m.Fd < 0)
+	{
+		printf("mcpsim: can't make a pty - error %d %s\n", errno, strerror(errno));
+		return 1;
+	}
+
+	/* the built-in script plays rounds on the default daemon's buttons */
+	if(script == NULL && dargs == (char **)DefaultDaemon && (presses = McpWritePresses()) == NULL)
+	{
+		printf("mcpsim: can't write the press script - error %d %s\n", errno, strerror(errno));
+		return 1;
+	}
+
+	start = MonotonicNs();
+	m.Daemon = McpStartDaemon(dargs, ndargs, presses, slave, log);
+	if(m.Daemon < 0)
+	{
+		printf("mcpsim: can't start %s\n", dargs[0]);
+		return 1;
+	}
+	printf("mcpsim: %s on %s\n", dargs[0], slave);
+
+	while(1)
+	{
+		if(f != NULL)
+		{
+			if(fgets(line, sizeof(line), f) == NULL)
+				break;
+			line[strcspn(line, "\r\n")] = '\0';
+		}
+		else if(DefaultScript[lineno] != NULL)
+			snprintf(line, sizeof(line), "%s", DefaultScript[lineno]);
+		else
+			break;
+		lineno++;
+
+		if(!McpRun(&m, line, lineno))
+		{
+			failed = 1;
+			break;
+		}
+		if(lineno == 1)
+			printf("mcpsim: daemon up and talking after %.1f ms\n", (MonotonicNs() - start) / 1e6);
+	}
+
+	McpPump(&m, 0);
+	printf("mcpsim: %d script lines%s; %lu bytes in, %lu out, %lu not understood, %lu bad CRC, %lu garbled, ending at %d baud\n",
+		lineno, failed ? ", stopped at a failure" : " OK", m.BytesIn, m.BytesOut, m.Unknown, m.BadCrc, m.Garbled, m.Baud);
+	if(m.Unknown != 0 || m.BadCrc != 0)
+		failed = 1;
+
+	kill(m.Daemon, SIGINT);
+	waitpid(m.Daemon, &status, 0);
+	close(m.Fd);
+	if(f != NULL)
+		fclose(f);
+	if(presses != NULL)
+		unlink(presses);
+
+	return failed;
+}
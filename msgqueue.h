@@ -0,0 +1,117 @@
+/* Filename: msgqueue.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Bounded lock-free single-producer/single-consumer
+   message queues between main() and the player threads, one per
+   direction per player. Replaces the old PXCmd/PXResp ints, which
+   lost a command whenever main() wrote twice before the thread
+   looked. Message codes are the ones listed in bytestatus.txt.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef MSGQUEUE_H
+#define MSGQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define MSGQUEUE_SIZE 64		// must be a power of 2
+
+typedef enum MsgCode {
+	/* PXCmd: main() -> PlayerXThread() */
+	CMD_ENABLER_ACTIVE	= 3,	// Enabler Active - Allow the player to respond
+	CMD_ENABLER_INACTIVE	= 4,	// Enabler Inactive - Clear all statuses and cancel countdown lights
+	CMD_RINGIN_WON		= 5,	// A player successfully rang in
+	CMD_LOCKED_OUT		= 7,	// Another player rang in ahead of us
+	CMD_OPERATOR_INTERRUPT	= 10,	// Operator cut everything short - a running penalty ends at TimeNs
+	CMD_INPUT_EDGE		= 11,	// Our button's line moved, passed on by main() - it shares the line
+
+	/* PXResp: PlayerXThread() -> main() */
+	RESP_RANG_IN		= 1,	// Player Rang In
+	RESP_TIMED_OUT		= 6,	// Player Timed Out (main()'s countdown engine, for the MCP)
+	RESP_COUNTDOWN		= 8,	// Player's ring-in counts, start its countdown
+	RESP_PENALIZED		= 9	// Press ignored, still inside an early ring-in penalty
+} MsgCode;
+
+typedef struct Msg {
+	uint8_t Code;			// MsgCode
+	uint8_t Player;			// 1-based player number
+	uint16_t Arg;			// RESP_RANG_IN: place in a tie, 0 for none; CMD_ENABLER_*: penalty ms; CMD_INPUT_EDGE: level
+	uint32_t Seq;			// sender's running count, handy for spotting gaps
+	uint64_t TimeNs;		// CLOCK_MONOTONIC; for RESP_RANG_IN the time of the press
+} Msg;
+
+typedef struct MsgQueue {
+	/* head and tail on their own cache lines so the two sides don't fight over them */
+	_Alignas(64) _Atomic uint32_t Head;	// next slot to read, written by the consumer
+	_Alignas(64) _Atomic uint32_t Tail;	// next slot to write, written by the producer
+	_Alignas(64) int WakeFd;		// eventfd poked after each push, or -1
+	Msg Slots[MSGQUEUE_SIZE];
+} MsgQueue;
+
+static inline void MsgQueueInit(MsgQueue *q, int wakefd)
+{
+	atomic_init(&q->Head, 0);
+	atomic_init(&q->Tail, 0);
+	q->WakeFd = wakefd;
+}
+
+/* Producer side. Returns false if the queue is full. */
+static inline bool MsgQueuePush(MsgQueue *q, const Msg *m)
+{
+	uint32_t tail = atomic_load_explicit(&q->Tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&q->Head, memory_order_acquire);
+
+	if(tail - head == MSGQUEUE_SIZE)
+		return false;
+
+	q->Slots[tail & (MSGQUEUE_SIZE - 1)] = *m;
+	atomic_store_explicit(&q->Tail, tail + 1, memory_order_release);
+
+	if(q->WakeFd >= 0)
+	{
+		uint64_t one = 1;
+
+		(void)!write(q->WakeFd, &one, sizeof(one));
+	}
+
+	return true;
+}
+
+/* Producer side. Never drops: waits for the consumer if the queue is full. */
+static inline void MsgQueueSend(MsgQueue *q, const Msg *m)
+{
+	while(!MsgQueuePush(q, m))
+		sched_yield();
+}
+
+/* Consumer side. Returns false if the queue is empty. */
+static inline bool MsgQueuePop(MsgQueue *q, Msg *m)
+{
+	uint32_t head = atomic_load_explicit(&q->Head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&q->Tail, memory_order_acquire);
+
+	if(head == tail)
+		return false;
+
+	*m = q->Slots[head & (MSGQUEUE_SIZE - 1)];
+	atomic_store_explicit(&q->Head, head + 1, memory_order_release);
+
+	return true;
+}
+
+static inline uint32_t MsgQueueDepth(MsgQueue *q)
+{
+	return atomic_load_explicit(&q->Tail, memory_order_acquire) - atomic_load_explicit(&q->Head, memory_order_acquire);
+}
+
+#endif
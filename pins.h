@@ -0,0 +1,80 @@
+/* Filename: pins.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Pin assignments for the ring-in device. These are the
+   defaults; the player pin map can be overridden at run time (see
+   PlayerParsePinMap() in player.c).
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef PINS_H
+#define PINS_H
+
+#include "gpioio.h"
+
+#define MODEL_BPLUS		// Define this as MODEL_AB or MODEL_BPLUS depending on your Pi model.
+
+#ifdef PI_MODEL
+	#error Must define a Pi type as MODEL_AB (26-pin) or MODEL_BPLUS (40-pin)
+#endif
+#ifdef MODEL_AB //map the pin assignments to the 26-pin Model A/B Pi
+	#define INPUT1 		RPI_GPIO_P1_07			//Pin 4
+	#define INPUT2 		RPI_GPIO_P1_11			//Pin 17
+	#define INPUT3 		RPI_V2_GPIO_P1_13		//Pin 27 (Rev2)
+	//#define INPUT3 	RPI_GPIO_P1_13			//Pin 21 (Rev1)
+	#define INPUT4 		RPI_GPIO_P1_15			//Pin 22
+	#define P1_LED 		RPI_GPIO_P1_12			//Pin 18
+	#define P2_LED 		RPI_GPIO_P1_16			//Pin 23
+	#define P3_LED 		RPI_GPIO_P1_18			//Pin 24
+//	#define P4_LED 		RPI_GPIO_P1_22			//Pin 25
+	#define LOCKOUT_ASSERT	RPI_GPIO_P1_11			//Pin 11 (SCLK)
+	#define OPERATOR_INTERRUPT RPI_V2_GPIO_P1_05		//Pin 5 (SCL, GPIO 3 on Rev2)
+#endif
+#ifdef MODEL_BPLUS //map the pin assignments to the 40-pin Model B+ (and all later revisions)
+	#define INPUT1		RPI_BPLUS_GPIO_J8_11		//Pin 11 (GPIO 17)
+	#define INPUT2		RPI_BPLUS_GPIO_J8_13		//Pin 13 (GPIO 27)
+	#define INPUT3		RPI_BPLUS_GPIO_J8_15		//Pin 15 (GPIO 22)
+//	#define INPUT4		RPI_BPLUS_GPIO_J8_7		//Pin 7  (GPIO 4)
+	#define P1_LED		RPI_BPLUS_GPIO_J8_29		//Pin 29 (GPIO 5)
+	#define P2_LED		RPI_BPLUS_GPIO_J8_31		//Pin 31 (GPIO 6)
+	#define P3_LED		RPI_BPLUS_GPIO_J8_33		//Pin 33 (GPIO 13)
+//	#define P4_LED		RPI_BPLUS_GPIO_J8_37		//Pin 37 (GPIO 26)
+	#define LOCKOUT_ASSERT	RPI_BPLUS_GPIO_J8_32		//Pin 32 (GPIO 12)
+	#define OPERATOR_INTERRUPT RPI_BPLUS_GPIO_J8_36		//Pin 36 (GPIO 16), to ground to cut everything short
+
+	//Define the countdown timer lights
+	#define P1_ENABLE	RPI_BPLUS_GPIO_J8_07		//Pin 7  (GPIO 4)
+	#define P2_ENABLE	RPI_BPLUS_GPIO_J8_05		//Pin 5  (GPIO 3)
+	#define P3_ENABLE	RPI_BPLUS_GPIO_J8_03		//Pin 3  (GPIO 2)
+	#define TIME_1		RPI_BPLUS_GPIO_J8_19		//Pin 19 (GPIO 10 / MOSI)
+	#define TIME_2		RPI_BPLUS_GPIO_J8_23		//Pin 23 (GPIO 11 / CLK)
+	#define TIME_3		RPI_BPLUS_GPIO_J8_21		//Pin 21 (GPIO 9 / MISO)
+	#define TIME_4		RPI_BPLUS_GPIO_J8_35		//Pin 35 (GPIO 19)
+	#define TIME_5		RPI_BPLUS_GPIO_J8_37		//Pin 37 (GPIO 26)
+#endif
+
+
+//Used in Mk.II. Pin assignments changed in Mk.III.
+/*#define INPUT1 RPI_GPIO_P1_16                   //Pin 23
+#define INPUT2 RPI_GPIO_P1_11                   //Pin 17
+#define INPUT3 RPI_GPIO_P1_18                   //Pin 24
+#define ENABLER RPI_GPIO_P1_12                  //Pin 18
+#define ENABLER_LED RPI_GPIO_P1_07              //Pin 4
+#define P1_LED RPI_GPIO_P1_15                   //Pin 22
+#define P2_LED RPI_GPIO_P1_22                   //Pin 25
+#define P3_LED RPI_V2_GPIO_P1_13                //Pin 27 (Rev2) */
+/*#define P3_LED RPI_GPIO_P1_13*/               //Pin 21 (Rev1)
+//#define OPERATOR_INTERRUPT RPI_V2_GPIO_P1_05    //Pin SCL (GPIO 3, Rev2)
+/*#define OPERATOR_INTERRUPT RPI_GPIO_P1_05*/   //Pin SCL? (GPIO 1, Rev1)
+
+#define ENABLER		INPUT3		//temporarily use player 3's input test button while I test this program
+
+#define PIN_NONE	0xff		// no pin wired for this function
+
+#endif
@@ -0,0 +1,543 @@
+/* Filename: player.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Table-driven player engine. See player.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pins.h"
+#include "clock.h"
+#include "gpiocdev.h"
+#include "reactor.h"
+#include "player.h"
+#include "latency.h"
+#include "trace.h"
+#include "rt.h"
+#include "log.h"
+
+#define ENABLER_WAIT_MS 10	// longest we'll wait on main() to pass on an Enabler the scanner saw
+
+int PlayerParsePinMap(const char *arg, PlayerPins *pins, int max)
+{
+	const char *s = arg;
+	char *end;
+	unsigned long v[3];
+	int count = 0;
+	int f;
+
+	while(*s != '\0')
+	{
+		if(count == max)
+		{
+			printf("PlayerParsePinMap(): more than %d players in '%s'\n", max, arg);
+			return -1;
+		}
+
+		v[1] = PIN_NONE;
+		v[2] = PIN_NONE;
+		for(f = 0; f < 3; f++)
+		{
+			v[f] = strtoul(s, &end, 0);
+			if(end == s || v[f] >= 32)
+			{
+				printf("PlayerParsePinMap(): bad pin in '%s' at '%s' (BCM GPIO 0-31)\n", arg, s);
+				return -1;
+			}
+			s = end;
+			if(*s != ':')
+				break;
+			s++;
+		}
+
+		pins[count].Input = v[0];
+		pins[count].Led = v[1];
+		pins[count].Enable = v[2];
+		count++;
+
+		if(*s == ',')
+			s++;
+		else if(*s != '\0')
+		{
+			printf("PlayerParsePinMap(): expected ',' in '%s' at '%s'\n", arg, s);
+			return -1;
+		}
+	}
+
+	if(count < MIN_PLAYERS)
+	{
+		printf("PlayerParsePinMap(): only %d players in '%s', need at least %d\n", count, arg, MIN_PLAYERS);
+		return -1;
+	}
+
+	return count;
+}
+
+int PlayerEngineInit(PlayerEngine *pe, const PlayerPins *pins, int count)
+{
+	int i;
+
+	if(count < MIN_PLAYERS || count > MAX_PLAYERS)
+	{
+		printf("PlayerEngineInit(): can't run %d players, %d to %d supported\n", count, MIN_PLAYERS, MAX_PLAYERS);
+		return -1;
+	}
+
+	pe->Count = count;
+	pe->Players = aligned_alloc(64, sizeof(Player) * count);	// MsgQueue wants cache-line alignment
+	if(pe->Players == NULL)
+		return -1;
+	pe->RespWakeFd = ReactorEventFd();
+	ArbiterInit(&pe->Arb);
+
+	for(i = 0; i < count; i++)
+	{
+		Player *p = &pe->Players[i];
+
+		memset(p, 0, sizeof(*p));
+		p->Number = i + 1;
+		p->Pins = pins[i];
+		p->InputFd = -1;
+		p->WakeFd = -1;
+		p->Arb = &pe->Arb;
+		atomic_init(&p->JudgedNs, 0);
+		atomic_init(&p->Ready, 0);
+		MsgQueueInit(&p->Resp, pe->RespWakeFd);
+		MsgQueueInit(&p->Cmd, ReactorEventFd());	// the player thread sleeps until woken
+	}
+
+	return 0;
+}
+
+static void AddLine(uint8_t *lines, int *n, uint8_t pin)
+{
+	int i;
+
+	for(i = 0; i < *n; i++)
+		if(lines[i] == pin)
+			return;
+	lines[(*n)++] = pin;
+}
+
+int PlayerEngineShareLines(PlayerEngine *pe, const uint8_t *others, int count, uint8_t *lines)
+{
+	Player *p;
+	int i, j, n = 0;
+
+	for(i = 0; i < count; i++)
+		AddLine(lines, &n, others[i]);
+
+	for(i = 0; i < pe->Count; i++)
+	{
+		p = &pe->Players[i];
+		p->Relayed = false;
+		for(j = 0; j < count; j++)
+			if(others[j] == p->Pins.Input)
+				p->Relayed = true;
+		for(j = 0; j < pe->Count; j++)
+			if(j != i && pe->Players[j].Pins.Input == p->Pins.Input)
+				p->Relayed = true;
+		if(p->Relayed)
+			AddLine(lines, &n, p->Pins.Input);
+	}
+
+	return n;
+}
+
+int PlayerEngineStart(PlayerEngine *pe)
+{
+	int i;
+
+	for(i = 0; i < pe->Count; i++)
+	{
+		if(RtThreadCreate(&pe->Players[i].Thread, RT_PLAYER, PlayerThread, &pe->Players[i]) != 0)
+		{
+			printf("PlayerEngineStart(): couldn't start Player %d's thread\n", i + 1);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void PlayerEngineBroadcast(PlayerEngine *pe, const Msg *m)
+{
+	int i;
+
+	for(i = 0; i < pe->Count; i++)
+		MsgQueueSend(&pe->Players[i].Cmd, m);
+}
+
+#ifdef MODEL_AB
+/* Player lights that aren't wired are PIN_NONE */
+static void LightWrite(uint8_t pin, uint8_t on)
+{
+	if(pin != PIN_NONE)
+		GPIOWrite(pin, on);
+}
+#endif
+
+#ifdef MODEL_BPLUS
+#define BAR_1 (1u << TIME_1)
+#define BAR_2 (BAR_1 | 1u << TIME_2)
+#define BAR_3 (BAR_2 | 1u << TIME_3)
+#define BAR_4 (BAR_3 | 1u << TIME_4)
+#define BAR_5 (BAR_4 | 1u << TIME_5)
+#define LIGHTBAR_MASK BAR_5
+
+/* The lightbar for each second left: TIME_1 up to TIME_<Second> lit */
+static const uint32_t LightbarFrames[6] = { 0, BAR_1, BAR_2, BAR_3, BAR_4, BAR_5 };
+#endif
+
+uint32_t LightbarFrame(const Player *p, int Second, uint32_t *clr)
+{
+	uint32_t set = 0;
+
+	*clr = 0;
+#ifdef MODEL_BPLUS
+	if(Second < 0 || Second > 5)
+		return 0;
+
+	/* the winner's countdown relay stays on throughout, and someone
+	   having the ring-in locks the other podiums out */
+	set = LightbarFrames[Second] | GPIOBit(p->Pins.Enable);
+	if(Second == 5)
+		set |= GPIOBit(LOCKOUT_ASSERT);
+	*clr = LIGHTBAR_MASK & ~set;
+#endif
+
+	return set;
+}
+
+int ShowCountdown(Player *p, int Second)
+{
+	/* This function supersedes GetPlayerRingIn() as it's more generalized to enable the multi-thread expansion.
+	   Still does pretty much the same thing though; sets the appropriate player LED(s) high to show a countdown feature.*/
+#ifdef MODEL_BPLUS
+	uint32_t set, clr;
+#endif
+
+	LogPrintf(LOG_DEBUG, "ShowCountdown(): Showing countdown for Player %d, Second %d\n", p->Number, Second);
+
+#ifdef MODEL_AB
+	/* Someone has the ring-in: lock the other podiums out first, that's
+	   the one the contestants race against */
+	if(Second == 5)
+	{
+		GPIOWrite(LOCKOUT_ASSERT, HIGH);
+		LatSince(LAT_LOCKOUT, p->ProbeNs);
+	}
+
+	/* Use the old single-LED indicator logic for 26-pin devices:
+	   the player's LED on for the whole countdown. */
+	if(Second == 5)
+		LightWrite(p->Pins.Led, HIGH);
+	else if(Second == 0)
+	{
+		GPIOWrite(LOCKOUT_ASSERT, LOW);
+		LightWrite(p->Pins.Led, LOW);
+	}
+#endif
+#ifdef MODEL_BPLUS
+	if(Second < 0 || Second > 5)
+	{
+		LogPrintf(LOG_WARN, "ShowCountdown(): Unknown Second %d\n", Second);
+		return 0;
+	}
+
+	/* The whole frame in one set and one clear write, so the bar steps
+	   down cleanly instead of rippling a light at a time. At 5 that's
+	   the lockout, the winner's relay and the full bar together. */
+	set = LightbarFrame(p, Second, &clr);
+	GPIOWriteMask(set, clr);
+	if(Second == 5)
+	{
+		LatSince(LAT_LOCKOUT, p->ProbeNs);
+		LatSince(LAT_ENABLE, p->ProbeNs);
+	}
+#endif
+
+	return 0;
+}
+
+void ClearCountdownLights(Player *p)
+{
+	/* Lightbar off and the player's countdown relay released, however
+	   far the countdown got */
+#ifdef MODEL_AB
+	GPIOWrite(LOCKOUT_ASSERT, LOW);
+	LightWrite(p->Pins.Led, LOW);
+#endif
+#ifdef MODEL_BPLUS
+	GPIOWriteMask(0, LIGHTBAR_MASK | GPIOBit(LOCKOUT_ASSERT) | GPIOBit(p->Pins.Enable));
+#endif
+}
+
+void *PlayerThread(void *thread)
+{
+	Player *p=(Player *)thread;
+
+	int EarlyPenalty = 0; // variable to hold if this player is subject to an early ring-in penalty
+	int LastMsg = 0;
+	int Enabled = 0;
+	int Lockout = 0;
+
+	uint8_t Button = 0;
+	uint64_t PressNs = 0;
+	uint64_t ReportedNs = 0;
+	uint64_t JudgedNs = 0;
+	bool Backlog = false;		// a press still to judge after this one
+	uint32_t Round = 0;		// the Enabler-active edge's Seq, for the arbiter
+	uint64_t EnabledNs = 0;		// Enabler edges from main(); a press is judged
+	uint64_t DisabledNs = 0;	// by when it happened, not when we woke up
+	uint64_t PenaltyNs = PENALTY_DEFAULT_MS * 1000000ull;	// this round's, from the Enabler commands
+	uint64_t PenaltyFromNs = 0;	// the early press that started it...
+	uint64_t PenaltyUntilNs = 0;	// ...and presses before this are ignored
+	ScanPress Press;
+	InputEdge edges[4];
+	int n, i;
+	char name[16];
+
+	Msg Cmd = { 0 };
+	Msg Resp = { 0 };
+	Msg Penalized = { 0 };
+	Resp.Player = p->Number;
+	Penalized.Player = p->Number;
+	Penalized.Code = RESP_PENALIZED;
+
+	const int WakeFds[] = { p->WakeFd, p->Cmd.WakeFd };
+
+	atomic_store(&p->Ready, 1);
+
+	LogPrintf(LOG_DEBUG, "PlayerThread(): Welcome to P%dThread, entering loop (%s input)\n", p->Number,
+		p->InputFd >= 0 ? "edge event" : p->Relayed ? "shared edge event" : "polled");
+	snprintf(name, sizeof(name), "P%dThread", p->Number);
+	ReadyArrive(p->Started, name, true);
+	while(1)
+	{
+		if(p->InputFd >= 0 || p->Relayed)
+		{
+			/* Sleep in the kernel until the button moves or main() sends a command.
+			   Only a falling edge is a press, and it keeps the kernel's timestamp
+			   of when it happened. On a shared line there's no fd of our own
+			   (poll() skips the -1) and the edges come in as CMD_INPUT_EDGE. */
+			Button = 1;
+			n = CdevWaitEdges(p->InputFd, p->Cmd.WakeFd, -1, edges, 4);
+			for(i = 0; i < n; i++)
+			{
+				TraceLogAt(edges[i].TimeNs, TRACE_EDGE, p->Number, edges[i].Pin, edges[i].Level, 0);
+				if(edges[i].Level == 0 && Button == 1)
+				{
+					Button = 0;
+					PressNs = edges[i].TimeNs;
+				}
+			}
+		}
+		else
+		{
+			/* Sleep until the scanner sees our bit change or main() sends a command,
+			   then read our bit out of ScannerThread()'s snapshot of the whole bank.
+			   A tap can be over before we wake; the scanner kept when it
+			   happened, so it's judged all the same. */
+			if(!Backlog)
+				ReactorWaitAny(WakeFds, 2, -1);
+			Backlog = false;
+			Button = ScannerLev(p->Scan, p->Number - 1);
+			ScannerPress(p->Scan, p->Number - 1, &Press);
+			PressNs = Press.PressNs;
+			Resp.Arg = Press.TieRank;
+
+			/* Slept through two presses, an early one and the next? Judge
+			   the early one first and come straight back for the other,
+			   or it gets away without its penalty. */
+			if(Press.PrevPressNs > JudgedNs && Press.PrevPressNs < PressNs)
+			{
+				PressNs = Press.PrevPressNs;
+				Resp.Arg = 0;
+				Backlog = true;
+			}
+		}
+
+		/* Process commands send to us from main(), every one of them in order.
+		   They go first: they carry the Enabler edge times the press below
+		   is judged against, however late in the loop we got woken. */
+		while(1)
+		{
+			while(MsgQueuePop(&p->Cmd, &Cmd))
+			{
+				TraceLog(TRACE_CMD, p->Number, 0xff, Cmd.Code, Cmd.Seq);
+				LogPrintf(LOG_DEBUG, "PlayerThread(): P%d Got new data - (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+				switch(Cmd.Code)
+				{
+					case CMD_INPUT_EDGE:
+						if(Cmd.Arg == 0 && Button == 1)
+						{
+							Button = 0;
+							PressNs = Cmd.TimeNs;
+						}
+						break;
+					case CMD_OPERATOR_INTERRUPT:
+						/* ends a penalty that was running when the operator hit
+						   the switch, not one an early press started since */
+						if(Cmd.TimeNs >= PenaltyFromNs && Cmd.TimeNs < PenaltyUntilNs)
+						{
+							LogPrintf(LOG_DEBUG, "PlayerThread(): P%d Operator lifted the penalty (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+							PenaltyUntilNs = Cmd.TimeNs;
+						}
+						break;
+					case CMD_ENABLER_ACTIVE:
+						LogPrintf(LOG_DEBUG, "PlayerThread(): P%d Enabling player input (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+						Enabled = 1;
+						Lockout = 0;
+						Round = Cmd.Seq;
+						EnabledNs = Cmd.TimeNs;
+						PenaltyNs = Cmd.Arg * 1000000ull;
+
+						/* Cmd.TimeNs is when the Enabler edge happened */
+						LatSince(LAT_ARMED, Cmd.TimeNs);
+						break;
+					case CMD_ENABLER_INACTIVE:
+						LogPrintf(LOG_DEBUG, "PlayerThread(): P%d Disabling player input(EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+						Enabled = 0;
+						Lockout = 0;
+						EarlyPenalty = 0;
+						PenaltyUntilNs = 0;
+						DisabledNs = Cmd.TimeNs;
+						PenaltyNs = Cmd.Arg * 1000000ull;
+						break;
+					case CMD_RINGIN_WON:
+						LogPrintf(LOG_INFO, "PlayerThread(): P%d We got the ring-in! (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+						break;
+					case CMD_LOCKED_OUT:
+						LogPrintf(LOG_DEBUG, "PlayerThread(): P%d Another player won, better luck next time (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+						Lockout = 1;
+						break;
+					default:
+						break;
+				}
+
+				LastMsg = Cmd.Code;
+			}
+
+			/* The scanner shows us the Enabler in the same snapshot as our button.
+			   If it has moved and main() hasn't said so yet, the command is on
+			   its way; wait for it rather than call a good press early, or let
+			   an early one off its penalty. Only ask once the queue is empty:
+			   last round's "inactive" may still have been sitting in it, and
+			   until it's read Enabled is stale. The level alone can't tell
+			   us we slept through a whole off-and-on again; the scanner
+			   having seen an edge newer than any we've been told of can. */
+			if(PressNs != JudgedNs && p->Scan != NULL && p->Pins.Input != ENABLER
+				&& ((ScannerPinLev(p->Scan, ENABLER) == 0) != (Enabled == 1)
+					|| ScannerWatchNs(p->Scan) > (EnabledNs > DisabledNs ? EnabledNs : DisabledNs))
+				&& ReactorWaitAny(&p->Cmd.WakeFd, 1, ENABLER_WAIT_MS) > 0)
+				continue;
+			break;
+		}
+
+		if(Button == 0 || PressNs != JudgedNs) // Player Button was pressed, maybe let go already
+		{
+			//printf("PlayerThread(): P%d debug: EarlyPenalty == %d, Lockout == %d, LastMsg == %d\n",p->Number, EarlyPenalty,Lockout,LastMsg);
+
+			if(PressNs != ReportedNs) //tell main() that we got a response, once per press
+			{
+				LatSince(LAT_THREAD, PressNs);
+				Resp.Code = RESP_RANG_IN;
+				Resp.TimeNs = PressNs;
+				Resp.Seq++;
+				MsgQueueSend(&p->Resp, &Resp);
+				ReportedNs = PressNs;
+			}
+
+			/* judge each press once, even if the button is still held next time round */
+			if(PressNs == JudgedNs)
+				continue;
+			JudgedNs = PressNs;
+
+			if(Enabled == 0 && PressNs >= EnabledNs && PressNs < DisabledNs)
+			{
+				//Pressed while the Enabler was live, but the round closed before we heard; not early
+			}
+			else if((Backlog || Enabled == 1) && PressNs < DisabledNs)
+			{
+				//Slept through it and the round it was in is over; too late to count either way
+			}
+			else if(Enabled != 1 || PressNs < EnabledNs) //Enabler is Disabled (or wasn't yet when pressed), we are not safe to ring in
+			{
+				/* every early press starts the window over, from when it happened */
+				LogPrintf(LOG_INFO, "PlayerThread(): P%d rang in unsafe; penalizing (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+				EarlyPenalty = 1;
+				PenaltyFromNs = PressNs;
+				PenaltyUntilNs = PressNs + PenaltyNs;
+			}
+			else //Enabler is Enabled, now it is safe to ring in
+			{
+				if(PressNs < PenaltyUntilNs) //Early penalty enforced
+				{
+					/* No sleeping it off: the press is just checked against the
+					   deadline, so we keep taking commands and the first press
+					   after the window counts to the nanosecond */
+					LogPrintf(LOG_INFO, "PlayerThread(): P%d Enforcing penalty, %llu us to go (EP: %d, LO: %d, LM: %d, CM: %d)\n",p->Number,
+						(unsigned long long)((PenaltyUntilNs - PressNs) / 1000), EarlyPenalty, Lockout, LastMsg,Cmd.Code);
+					Penalized.Arg = (PenaltyUntilNs - PressNs + 999999) / 1000000;
+					Penalized.TimeNs = PressNs;
+					Penalized.Seq++;
+					MsgQueueSend(&p->Resp, &Penalized);
+				}
+				else if(Lockout != 1 /*&& Cmd.Code == CMD_RINGIN_WON*/) //Make sure we're not locked out
+				{							//and that main() has cleared us to ring in!
+					// do the countdown logic here
+					EarlyPenalty = 0;
+
+					/* main() runs the countdown lights off its timer, so we stay
+					   free to take commands. We're locked out until the Enabler
+					   comes round again, same as after the old blocking countdown. */
+					Lockout = 1;
+
+					/* Someone who pressed first has already claimed it? Then
+					   we know we're out without waiting on main() to say so */
+					if(ArbiterClaim(p->Arb, Round, PressNs - EnabledNs, Resp.Arg, p->Number) != ARB_LEADING)
+						LogPrintf(LOG_DEBUG, "PlayerThread(): P%d rang in at %llu.%06llu, beaten to it\n", p->Number, (unsigned long long)(PressNs / 1000000000ull), (unsigned long long)(PressNs % 1000000000ull / 1000));
+					else
+					{
+						LogPrintf(LOG_INFO, "PlayerThread(): P%d rang in at %llu.%06llu\n", p->Number, (unsigned long long)(PressNs / 1000000000ull), (unsigned long long)(PressNs % 1000000000ull / 1000));
+						Resp.Code = RESP_COUNTDOWN;
+						Resp.TimeNs = PressNs;
+						Resp.Seq++;
+						MsgQueueSend(&p->Resp, &Resp);
+					}
+				}
+			}
+
+			/* main() may be holding a claim until it knows we didn't press first */
+			atomic_store_explicit(&p->JudgedNs, PressNs, memory_order_release);
+			if(ArbPlayer(ArbiterPeek(p->Arb)) != 0 && !ArbSealed(ArbiterPeek(p->Arb)))
+				ReactorPoke(p->Resp.WakeFd);
+		}
+
+	}
+}
+
+bool InterruptDelay(CancelWait *w, int milliseconds)
+{
+	/* This function exists so the operator can cut a wait short
+	   without having to wait for the timer to expire. This keeps
+	   things running fast. The operator interrupt wakes us the moment
+	   it's seen instead of us looking every 10 ms. */
+	if(CancelSleepUntil(w, ClockNow() + (uint64_t)milliseconds * 1000000ull))
+	{
+		LogPrintf(LOG_INFO, "InterruptDelay(): Ending wait - operator interrupt\n");
+		return true;
+	}
+
+	return false;
+}
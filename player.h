@@ -0,0 +1,97 @@
+/* Filename: player.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Table-driven player engine. Each podium is a row in a
+   pin map (button, LED, countdown enable) and gets its own
+   PlayerThread() running the same code, so 3 to 16 podiums are just
+   a different table.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "msgqueue.h"
+#include "scanner.h"
+#include "ready.h"
+#include "arbiter.h"
+
+#define MIN_PLAYERS 3				// a Jeopardy round has three podiums at the least
+#define MAX_PLAYERS SCAN_MAX_PLAYERS
+#define PENALTY_DEFAULT_MS 250			// early ring-in lockout, until the round says otherwise
+
+typedef struct PlayerPins {
+	uint8_t Input;				// button, active low
+	uint8_t Led;				// podium LED, or PIN_NONE
+	uint8_t Enable;				// countdown enable relay, or PIN_NONE
+} PlayerPins;
+
+typedef struct Player {
+	MsgQueue Cmd;				// main() -> PlayerThread(), see bytestatus.txt
+	MsgQueue Resp;				// PlayerThread() -> main()
+
+	int Number;				// 1-based, as shown to the operator
+	PlayerPins Pins;
+	int InputFd;				// GPIO chardev line request, or -1 to read the scanner snapshot
+	bool Relayed;				// ...or edge events main() reads, on a line it shares, as CMD_INPUT_EDGE
+	int WakeFd;				// scanner pokes this when our bit changes (scanner mode only)
+	Scanner *Scan;
+	Arbiter *Arb;				// the engine's, shared by every player
+	_Atomic uint64_t JudgedNs;		// the last press we've judged, for main() to wait on
+	atomic_int Ready;			// set to 1 once the thread is running
+	ReadyBarrier *Started;			// ...and reported to then, or NULL
+	pthread_t Thread;
+
+	uint64_t ProbeNs;			// press being timed through the countdown lights, main() only
+} Player;
+
+typedef struct PlayerEngine {
+	int Count;
+	Player *Players;			// Count entries
+	int RespWakeFd;				// shared by every player's Resp queue
+	Arbiter Arb;				// who rang in first this round
+} PlayerEngine;
+
+/* Parse a pin map: comma separated "input[:led[:enable]]" BCM GPIO
+   numbers, one entry per podium, MIN_PLAYERS to max of them. Returns the
+   number of players, or -1. */
+int PlayerParsePinMap(const char *arg, PlayerPins *pins, int max);
+
+/* Set up count players. Input modes (InputFd, Relayed, WakeFd, Scan)
+   are filled in by the caller before PlayerEngineStart(). */
+int PlayerEngineInit(PlayerEngine *pe, const PlayerPins *pins, int count);
+
+/* The kernel hands out each chardev line once. Sets Relayed on every
+   player whose button is on one of others' count lines (the Enabler,
+   say) or on another player's, and fills lines with the distinct pins
+   of others and those players, for main() to request as one and pass
+   on; returns how many. Everyone else can request their own. */
+int PlayerEngineShareLines(PlayerEngine *pe, const uint8_t *others, int count, uint8_t *lines);
+int PlayerEngineStart(PlayerEngine *pe);
+void PlayerEngineBroadcast(PlayerEngine *pe, const Msg *m);
+
+void *PlayerThread(void *thread);
+
+int ShowCountdown(Player *p, int Second);
+void ClearCountdownLights(Player *p);
+
+/* The countdown lights for Second as one GPIO 0-31 set mask (returned)
+   and clear mask, for GPIOWriteMask() */
+uint32_t LightbarFrame(const Player *p, int Second, uint32_t *clr);
+
+/* Sleep milliseconds on the game clock; true if the operator interrupt
+   cut it short */
+bool InterruptDelay(CancelWait *w, int milliseconds);
+
+#endif
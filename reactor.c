@@ -0,0 +1,219 @@
+/* Filename: reactor.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: epoll-based event loop. See reactor.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "clock.h"
+#include "reactor.h"
+
+int ReactorInit(Reactor *r)
+{
+	memset(r, 0, sizeof(*r));
+	r->EpollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(r->EpollFd == -1)
+	{
+		printf("ReactorInit(): epoll_create1 failed - error %d %s\n", errno, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+void ReactorClose(Reactor *r)
+{
+	if(r->EpollFd >= 0)
+		close(r->EpollFd);
+	r->EpollFd = -1;
+	r->Count = 0;
+}
+
+int ReactorAdd(Reactor *r, int fd, ReactorHandler handler, void *ctx)
+{
+	struct epoll_event ev;
+	int slot;
+
+	if(fd < 0)
+		return -1;
+
+	/* reuse a slot freed by ReactorRemove() before growing the table */
+	for(slot = 0; slot < r->Count; slot++)
+		if(r->Sources[slot].Fd == -1)
+			break;
+	if(slot == REACTOR_MAX_SOURCES)
+	{
+		printf("ReactorAdd(): too many sources (%d)\n", REACTOR_MAX_SOURCES);
+		return -1;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = slot;
+	if(epoll_ctl(r->EpollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+	{
+		printf("ReactorAdd(): epoll_ctl failed for fd %d - error %d %s\n", fd, errno, strerror(errno));
+		return -1;
+	}
+
+	r->Sources[slot].Fd = fd;
+	r->Sources[slot].Handler = handler;
+	r->Sources[slot].Ctx = ctx;
+	if(slot == r->Count)
+		r->Count++;
+
+	return 0;
+}
+
+int ReactorRemove(Reactor *r, int fd)
+{
+	int slot;
+
+	for(slot = 0; slot < r->Count; slot++)
+	{
+		if(r->Sources[slot].Fd == fd)
+		{
+			epoll_ctl(r->EpollFd, EPOLL_CTL_DEL, fd, NULL);
+			r->Sources[slot].Fd = -1;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int ReactorRunOnce(Reactor *r, int timeout_ms)
+{
+	struct epoll_event ev[REACTOR_MAX_SOURCES];
+	ReactorSource *src;
+	int n, i;
+
+	n = epoll_wait(r->EpollFd, ev, REACTOR_MAX_SOURCES, timeout_ms);
+	if(n == -1)
+		return (errno == EINTR) ? 0 : -1;
+
+	for(i = 0; i < n; i++)
+	{
+		src = &r->Sources[ev[i].data.u32];
+		if(src->Fd >= 0)
+			src->Handler(src->Fd, ev[i].events, src->Ctx);
+	}
+
+	return n;
+}
+
+void ReactorRun(Reactor *r)
+{
+	while(!r->Stop)
+	{
+		if(ReactorRunOnce(r, -1) == -1)
+		{
+			printf("ReactorRun(): epoll_wait failed - error %d %s\n", errno, strerror(errno));
+			break;
+		}
+	}
+}
+
+int ReactorEventFd(void)
+{
+	return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+void ReactorPoke(int fd)
+{
+	uint64_t one = 1;
+
+	if(fd >= 0)
+		(void)!write(fd, &one, sizeof(one));
+}
+
+uint64_t ReactorDrain(int fd)
+{
+	uint64_t count = 0;
+
+	if(read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+
+	return count;
+}
+
+int ReactorWaitAny(const int *fds, int count, int timeout_ms)
+{
+	struct pollfd pfd[REACTOR_MAX_SOURCES];
+	int n, i;
+
+	if(count > REACTOR_MAX_SOURCES)
+		count = REACTOR_MAX_SOURCES;
+
+	for(i = 0; i < count; i++)
+	{
+		pfd[i].fd = fds[i];
+		pfd[i].events = POLLIN;
+		pfd[i].revents = 0;
+	}
+
+	n = poll(pfd, count, timeout_ms);
+	if(n <= 0)
+		return 0;
+
+	for(i = 0; i < count; i++)
+		if(pfd[i].revents & POLLIN)
+			ReactorDrain(pfd[i].fd);
+
+	return n;
+}
+
+int ReactorTimerFd(void)
+{
+	/* on the virtual clock, an eventfd it pokes instead */
+	if(ClockVirtual)
+		return ClockTimerFd();
+
+	return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+int ReactorArmTimer(int fd, uint64_t first_ns, uint64_t interval_ns)
+{
+	struct itimerspec its;
+
+	if(ClockVirtual)
+		return ClockArmTimer(fd, first_ns, interval_ns);
+
+	/* first_ns of 0 disarms the timer */
+	its.it_value.tv_sec = first_ns / 1000000000ull;
+	its.it_value.tv_nsec = first_ns % 1000000000ull;
+	its.it_interval.tv_sec = interval_ns / 1000000000ull;
+	its.it_interval.tv_nsec = interval_ns % 1000000000ull;
+
+	return timerfd_settime(fd, 0, &its, NULL);
+}
+
+int ReactorArmTimerAt(int fd, uint64_t deadline_ns)
+{
+	struct itimerspec its;
+
+	if(ClockVirtual)
+		return ClockArmTimerAt(fd, deadline_ns);
+
+	its.it_value.tv_sec = deadline_ns / 1000000000ull;
+	its.it_value.tv_nsec = deadline_ns % 1000000000ull;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+
+	return timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
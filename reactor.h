@@ -0,0 +1,69 @@
+/* Filename: reactor.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Small epoll-based event loop. main() registers the fds
+   it cares about (Enabler edges, player responses, serial traffic,
+   timers) with a handler each and then sleeps in epoll_wait() until one
+   of them has something for it, instead of spinning on GPIO reads.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define REACTOR_MAX_SOURCES 16
+
+typedef void (*ReactorHandler)(int fd, uint32_t events, void *ctx);
+
+typedef struct ReactorSource {
+	int Fd;
+	ReactorHandler Handler;
+	void *Ctx;
+} ReactorSource;
+
+typedef struct Reactor {
+	int EpollFd;
+	int Count;
+	bool Stop;
+	ReactorSource Sources[REACTOR_MAX_SOURCES];
+} Reactor;
+
+int ReactorInit(Reactor *r);
+void ReactorClose(Reactor *r);
+
+/* Call handler whenever fd is readable. */
+int ReactorAdd(Reactor *r, int fd, ReactorHandler handler, void *ctx);
+int ReactorRemove(Reactor *r, int fd);
+
+/* Dispatch whatever is ready, waiting up to timeout_ms (-1 forever).
+   Returns the number of handlers called, or -1 on error. */
+int ReactorRunOnce(Reactor *r, int timeout_ms);
+
+/* Dispatch until a handler sets r->Stop. */
+void ReactorRun(Reactor *r);
+
+/* Helpers for the fd types main() hands to the reactor. */
+int ReactorEventFd(void);
+void ReactorPoke(int fd);
+uint64_t ReactorDrain(int fd);			// eventfd count or timerfd expirations
+int ReactorTimerFd(void);
+int ReactorArmTimer(int fd, uint64_t first_ns, uint64_t interval_ns);
+/* One-shot at an absolute CLOCK_MONOTONIC time, 0 disarms. Deadlines
+   chained off the previous one don't drift the way relative ones do. */
+int ReactorArmTimerAt(int fd, uint64_t deadline_ns);
+
+/* For threads that aren't running a reactor: sleep until one of fds
+   (eventfds, negative entries ignored) is readable, drain the ones that
+   are, and return how many were. 0 on timeout. */
+int ReactorWaitAny(const int *fds, int count, int timeout_ms);
+
+#endif
@@ -0,0 +1,91 @@
+/* Filename: ready.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Startup readiness barrier. See ready.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include "clock.h"
+#include "ready.h"
+
+void ReadyInit(ReadyBarrier *b, int expected)
+{
+	pthread_condattr_t attr;
+
+	/* the deadline in ReadyWait() is on CLOCK_MONOTONIC, so a clock
+	   change at boot can't stretch or cut it short */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&b->Changed, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&b->Lock, NULL);
+
+	b->Expected = expected;
+	b->Arrived = 0;
+	b->Failed = 0;
+	b->StartNs = MonotonicNs();
+	b->LastNs = b->StartNs;
+}
+
+void ReadyExpect(ReadyBarrier *b, int n)
+{
+	pthread_mutex_lock(&b->Lock);
+	b->Expected += n;
+	pthread_mutex_unlock(&b->Lock);
+}
+
+void ReadyArrive(ReadyBarrier *b, const char *who, bool ok)
+{
+	uint64_t now;
+
+	if(b == NULL)
+		return;
+
+	now = MonotonicNs();
+	pthread_mutex_lock(&b->Lock);
+	b->Arrived++;
+	if(!ok)
+		b->Failed++;
+	b->LastNs = now;
+	pthread_cond_broadcast(&b->Changed);
+	pthread_mutex_unlock(&b->Lock);
+
+	printf("ReadyArrive(): %s %s after %llu us\n", who, ok ? "ready" : "up, but NOT ready",
+		(unsigned long long)((now - b->StartNs) / 1000));
+}
+
+int ReadyWait(ReadyBarrier *b, int timeout_ms)
+{
+	uint64_t deadline = MonotonicNs() + (uint64_t)timeout_ms * 1000000ull;
+	struct timespec ts = { deadline / 1000000000ull, deadline % 1000000000ull };
+	int missing;
+
+	pthread_mutex_lock(&b->Lock);
+	while(b->Arrived < b->Expected)
+	{
+		if(pthread_cond_timedwait(&b->Changed, &b->Lock, &ts) == ETIMEDOUT)
+			break;
+	}
+	missing = b->Expected - b->Arrived;
+	pthread_mutex_unlock(&b->Lock);
+
+	if(missing > 0)
+		printf("ReadyWait(): %d of %d threads still not ready after %d ms, carrying on without them\n",
+			missing, b->Expected, timeout_ms);
+	else
+		printf("ReadyWait(): all %d threads ready in %llu us%s\n", b->Expected,
+			(unsigned long long)((b->LastNs - b->StartNs) / 1000),
+			b->Failed ? ", some of them degraded" : "");
+
+	return missing;
+}
@@ -0,0 +1,48 @@
+/* Filename: ready.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Startup readiness barrier. main() counts each thread in
+   with ReadyExpect() as it starts it; the thread calls ReadyArrive() as
+   soon as it's in its loop and carries on, and main() blocks in
+   ReadyWait() until the last one has, instead of sleeping a fixed time
+   and hoping.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef READY_H
+#define READY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct ReadyBarrier {
+	pthread_mutex_t Lock;
+	pthread_cond_t Changed;
+	int Expected;
+	int Arrived;
+	int Failed;			// arrived, but couldn't do their job
+	uint64_t StartNs;		// MonotonicNs() at ReadyInit()
+	uint64_t LastNs;		// ...and at the last arrival
+} ReadyBarrier;
+
+void ReadyInit(ReadyBarrier *b, int expected);
+
+/* n more threads to wait for; call before starting them */
+void ReadyExpect(ReadyBarrier *b, int n);
+
+/* who is up; ok false if it's running but without what it needs (no
+   serial port, say). Safe to call with b NULL. */
+void ReadyArrive(ReadyBarrier *b, const char *who, bool ok);
+
+/* Wait up to timeout_ms of real time for everyone; returns how many
+   never turned up */
+int ReadyWait(ReadyBarrier *b, int timeout_ms);
+
+#endif
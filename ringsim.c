@@ -0,0 +1,954 @@
+/* Filename: ringsim.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Deterministic ring-in simulator. Plays thousands of
+   rounds through the real round logic (game.c), player threads,
+   early ring-in penalty and countdown engine, on the simulated GPIO
+   board. This program stands in for the buttons, the Enabler and the
+   MCP: it feeds the input scanner snapshots on a fixed grid, exactly
+   as ScannerThread() would, from a seeded press schedule, and checks
+   every round's winner against the schedule.
+
+   Presses are bunched into near-ties a few microseconds apart, so many
+   land in one scanner snapshot and go to the tie-break policy. The
+   same seed always gives the same schedule, and so the same rightful
+   winners; "wrong winner" counts the rounds where thread timing picked
+   someone else.
+
+   Early ring-ins are checked to the snapshot: a player who jumped the
+   gun and presses again is scheduled within 1 ms either side of the end
+   of their penalty, with everyone else held back until after it, so
+   the round goes to them exactly when the press is past the deadline.
+
+   Reports rounds per second, press -> decision latency percentiles,
+   the stage histograms from latency.c, and per-player fairness: wins
+   against the wins the schedule says were earned, and how ties split.
+
+   With -V the game runs on the virtual clock (clock.h): instead of
+   sleeping, the simulator jumps the clock to each snapshot, countdown
+   step and press in turn, so a full game with its countdowns and
+   penalties plays out in milliseconds. Latencies taken
+   on the virtual clock only say how far the game clock moved, not how
+   long the program took.
+
+   Usage: jeopardy-sim [-n players] [-r rounds] [-s seed] [-t lowest|rotate|random[:seed]]
+                       [-u scan-usec] [-j tie-spacing-usec] [-w spread-usec] [-p press-percent]
+                       [-e early-percent] [-P penalty-ms] [-o timeout-percent] [-I interrupt-percent]
+                       [-c countdown-step-usec] [-T trace-file] [-S] [-V] [-v]
+   Exits nonzero if a round nobody earned is won, an earned one isn't,
+   a player wins inside their penalty or loses a round they earned
+   just after it, an operator interrupt leaves a countdown running, or a
+   round sends the MCP anything but its winner's one ring-in; with -S, on any wrong winner too.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "pins.h"
+#include "clock.h"
+#include "gpioio.h"
+#include "msgqueue.h"
+#include "reactor.h"
+#include "scanner.h"
+#include "player.h"
+#include "countdown.h"
+#include "game.h"
+#include "latency.h"
+#include "trace.h"
+#include "cancel.h"
+#include "log.h"
+
+#define SIM_LEAD_NS		300000ull	// quiet time before each round's first event
+#define SIM_DECIDE_MS		50		// longest a round may take to be decided
+#define SIM_NOBODY_MS		2		// how long to watch for a winner nobody earned
+#define SIM_PENALTY_EDGE_NS	1000000ull	// penalized presses land this close to the deadline
+#define SIM_SETTLE_NS		50000ull	// virtual clock: real time the threads get after each jump
+
+/* driver -> reactor thread, standing in for OnEnabler() and OnSerial() */
+#define SIM_ENABLER		1	// Arg = level, TimeNs = the edge
+#define SIM_COUNTDOWN_END	2
+#define SIM_STOP		3
+
+typedef struct SimConfig {
+	int Players;
+	int Rounds;
+	uint32_t Seed;
+	TieBreak Policy;
+	uint32_t PolicySeed;
+	uint64_t ScanNs;		// snapshot grid, 0 to decode every press on its own
+	uint64_t SpacingNs;		// near-tie spacing
+	uint64_t SpreadNs;		// rounds' first presses land somewhere in this after the Enabler
+	int PressPct;
+	int EarlyPct;
+	int PenaltyMs;			// early ring-in penalty
+	int TimeoutPct;			// rounds where the MCP lets the countdown run out
+	int InterruptPct;		// rounds where the operator cuts the countdown short instead
+	uint64_t StepNs;		// countdown step, 0 for the clock's default
+	const char *TracePath;
+	bool Strict;
+	bool Virtual;
+	bool Verbose;
+} SimConfig;
+
+/* One podium's part in a round. Slots count scanner snapshots from the
+   Enabler edge (slot 0); an early press is a negative slot. */
+typedef struct SimPlayer {
+	int64_t EarlySlot;		// early press, or 0 for none
+	int64_t PressSlot;		// press after the Enabler, or 0 for none
+	uint8_t Rank;			// tie place the scanner gave PressSlot's snapshot
+} SimPlayer;
+
+typedef struct SimEdge {
+	int64_t Slot;
+	int Player;			// -1 for the Enabler
+	uint8_t Level;
+} SimEdge;
+
+typedef struct SimStats {
+	uint64_t Rounds;
+	uint64_t Presses;
+	uint64_t Early;
+	uint64_t Ties;			// rounds whose first valid snapshot held more than one press
+	uint64_t Decided;
+	uint64_t Wrong;			// someone other than the schedule's winner got it
+	uint64_t Missed;		// earned, but nobody got it
+	uint64_t Spurious;		// nobody earned it, somebody got it
+	uint64_t Late;			// decided after the round was given up on
+	uint64_t EarlyWins;		// penalized player won
+	uint64_t PenaltyEdge;		// early players' presses near the end of their penalty
+	uint64_t PenaltyHeld;		// ...past it, and earned the round, but didn't get it
+	uint64_t TimedOut;
+	uint64_t Interrupts;		// operator interrupts...
+	uint64_t InterruptMissed;	// ...that left the countdown running
+	uint64_t RangIn;		// ring-ins passed on to the MCP
+	uint64_t RangInOff;		// rounds that sent it other than one, the winner's
+	uint64_t Pressed[MAX_PLAYERS];
+	uint64_t Earned[MAX_PLAYERS];
+	uint64_t Won[MAX_PLAYERS];
+	uint64_t TieRounds[MAX_PLAYERS];
+	uint64_t TieWins[MAX_PLAYERS];
+	uint64_t *DecideNs;		// press -> decision, one per decided round
+} SimStats;
+
+typedef struct Sim {
+	SimConfig Cfg;
+	PlayerEngine Engine;
+	Game Game;
+	Scanner Scan;
+	Reactor R;
+	pthread_t Thread;
+	uint8_t Pins[MAX_PLAYERS];
+	uint32_t Idle;			// bank with every button up and the Enabler inactive
+
+	MsgQueue *Cmd;			// driver -> reactor
+	int DriverFd;			// reactor -> driver, anything in Decisions or Mcp
+	MsgQueue *Decisions;
+	MsgQueue *Mcp;			// what the game would send the MCP
+	int McpPlayer;			// ...and whose ring-in it was last
+	uint32_t EnablerSent;		// Enabler edges sent to the reactor...
+	_Atomic uint32_t EnablerDone;	// ...and passed on to the player threads
+
+	Cancel Operator;		// raised by the scanner, like the real switch
+	int InterruptFd;		// reactor's listener
+	uint32_t InterruptsSeen;	// reactor only
+	_Atomic uint64_t PutOut;	// countdowns operator interrupts have put out
+
+	uint32_t Rng;
+	SimStats Stats;
+	FILE *Report;
+} Sim;
+
+static uint32_t SimRand(Sim *s)
+{
+	uint32_t x = s->Rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	s->Rng = x;
+	return x;
+}
+
+/* Real time for the threads to act on what the virtual clock just did */
+static void SimSettle(void)
+{
+	struct timespec ts = { 0, SIM_SETTLE_NS };
+
+	nanosleep(&ts, NULL);
+}
+
+/* Bring the game clock to ns: sleep on the real clock, or jump the
+   virtual one deadline by deadline so every timer and sleeper on the
+   way goes off in order */
+static void SimClockTo(uint64_t ns)
+{
+	uint64_t next;
+
+	if(!ClockVirtual)
+	{
+		ClockSleepUntil(ns);
+		return;
+	}
+
+	while((next = ClockNextDeadline()) != 0 && next <= ns)
+	{
+		ClockAdvance(next);
+		SimSettle();
+	}
+	ClockAdvance(ns);
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int CompareEdge(const void *a, const void *b)
+{
+	const SimEdge *x = (const SimEdge *)a, *y = (const SimEdge *)b;
+
+	return (x->Slot > y->Slot) - (x->Slot < y->Slot);
+}
+
+/* ---- reactor thread: main() as far as the game is concerned ---- */
+
+static void SimOnCmd(int fd, uint32_t events, void *ctx)
+{
+	Sim *s = (Sim *)ctx;
+	Msg m;
+
+	(void)events;
+	ReactorDrain(fd);
+	while(MsgQueuePop(s->Cmd, &m))
+	{
+		/* every Enabler edge comes through here in order; rounds are far
+		   closer together than a real show's, and reading the level
+		   off the scanner like OnEnabler() could fold two into one */
+		if(m.Code == SIM_ENABLER)
+		{
+			GameEnabler(&s->Game, m.Arg, m.TimeNs);
+			atomic_fetch_add(&s->EnablerDone, 1);
+		}
+		else if(m.Code == SIM_COUNTDOWN_END)
+			GameCountdownEnd(&s->Game, m.Player, m.TimeNs);
+		else if(m.Code == SIM_STOP)
+			s->R.Stop = true;
+	}
+}
+
+static void SimOnInterrupt(int fd, uint32_t events, void *ctx)
+{
+	Sim *s = (Sim *)ctx;
+	uint32_t raised;
+
+	(void)events;
+	ReactorDrain(fd);
+	raised = atomic_load(&s->Operator.Raised);
+	if(raised == s->InterruptsSeen)
+		return;
+	s->InterruptsSeen = raised;
+
+	GameInterrupt(&s->Game, atomic_load(&s->Operator.RaisedNs));
+	atomic_store(&s->PutOut, s->Game.Interrupted);
+}
+
+static void SimOnAwarded(Player *p, const Msg *claim, int claims, void *ctx)
+{
+	Sim *s = (Sim *)ctx;
+	Msg m = *claim;
+
+	/* the driver wants the round and how long it took, not the press time */
+	m.Arg = claims;
+	m.Seq = (uint32_t)s->Game.Rounds;
+	m.TimeNs = ClockNow() - claim->TimeNs;
+	MsgQueuePush(s->Decisions, &m);
+	(void)p;
+}
+
+static void *SimReactor(void *arg)
+{
+	Sim *s = (Sim *)arg;
+
+	ReactorRun(&s->R);
+	return NULL;
+}
+
+static void SimSend(Sim *s, uint8_t code, int player, int arg, uint64_t ns)
+{
+	Msg m = { 0 };
+
+	m.Code = code;
+	m.Player = player;
+	m.Arg = arg;
+	m.TimeNs = ns;
+	MsgQueueSend(s->Cmd, &m);
+}
+
+/* ---- driver: buttons, Enabler and MCP ---- */
+
+/* Move the Enabler. On the virtual clock, hold the game until the
+   player threads have read the edge: the next snapshot comes straight
+   after in real time, and a press judged before last round's
+   "inactive" or this round's "active" reached its thread is judged
+   against the wrong round. */
+static void SimEnabler(Sim *s, int level, uint64_t ns)
+{
+	uint64_t until;
+	int i;
+
+	SimSend(s, SIM_ENABLER, 0, level, ns);
+	s->EnablerSent++;
+	if(!ClockVirtual)
+		return;
+
+	until = MonotonicNs() + SIM_DECIDE_MS * 1000000ull;
+	while(MonotonicNs() < until)
+	{
+		for(i = 0; i < s->Cfg.Players && MsgQueueDepth(&s->Engine.Players[i].Cmd) == 0; i++)
+			;
+		if(i == s->Cfg.Players && atomic_load(&s->EnablerDone) == s->EnablerSent)
+			return;
+		SimSettle();
+	}
+}
+
+static int64_t SlotOf(Sim *s, uint64_t offsetns)
+{
+	uint64_t grid = s->Cfg.ScanNs ? s->Cfg.ScanNs : 1000;
+
+	/* the first snapshot at or after the press sees it */
+	return (int64_t)((offsetns + grid - 1) / grid);
+}
+
+/* Is sp's press still inside the penalty for its early one? The player
+   thread goes by the snapshot times, so this is exact. */
+static bool SimPenalized(Sim *s, const SimPlayer *sp)
+{
+	uint64_t grid = s->Cfg.ScanNs ? s->Cfg.ScanNs : 1000;
+
+	if(sp->EarlySlot == 0 || sp->PressSlot == 0)
+		return false;
+	return (uint64_t)(sp->PressSlot - sp->EarlySlot) * grid < (uint64_t)s->Cfg.PenaltyMs * 1000000ull;
+}
+
+/* Roll one round's presses */
+static void SimSchedule(Sim *s, SimPlayer *sp)
+{
+	uint64_t lead, spread = s->Cfg.SpreadNs ? s->Cfg.SpreadNs : 1;
+	uint64_t grid = s->Cfg.ScanNs ? s->Cfg.ScanNs : 1000;
+	int64_t edge = SlotOf(s, SIM_PENALTY_EDGE_NS), penalty = SlotOf(s, (uint64_t)s->Cfg.PenaltyMs * 1000000ull);
+	int64_t last = 0;
+	int i, n = s->Cfg.Players;
+
+	lead = SimRand(s) % spread;
+	for(i = 0; i < n; i++)
+	{
+		memset(&sp[i], 0, sizeof(sp[i]));
+
+		/* jumping the gun: down well before the Enabler and let go again before it */
+		if((int)(SimRand(s) % 100) < s->Cfg.EarlyPct)
+			sp[i].EarlySlot = -SlotOf(s, (SimRand(s) % spread) + SIM_LEAD_NS / 3) - 10;
+
+		/* everyone else piles in a few microseconds apart */
+		if((int)(SimRand(s) % 100) < s->Cfg.PressPct)
+			sp[i].PressSlot = SlotOf(s, lead + (SimRand(s) % (4 * n)) * s->Cfg.SpacingNs + 1);
+
+		/* ...but the early ones press again somewhere around the end of
+		   their penalty, after they've let go */
+		if(sp[i].EarlySlot != 0 && sp[i].PressSlot != 0)
+		{
+			sp[i].PressSlot = sp[i].EarlySlot + penalty + (int64_t)(SimRand(s) % (2 * edge + 1)) - edge;
+			if(sp[i].PressSlot < sp[i].EarlySlot + 6)
+				sp[i].PressSlot = sp[i].EarlySlot + 6;
+			if(sp[i].PressSlot < 1)
+				sp[i].PressSlot = 1;
+			if(sp[i].EarlySlot + penalty > last)
+				last = sp[i].EarlySlot + penalty;
+			if((uint64_t)llabs(sp[i].PressSlot - sp[i].EarlySlot - penalty) * grid <= SIM_PENALTY_EDGE_NS)
+				s->Stats.PenaltyEdge++;
+		}
+	}
+
+	/* and nobody else beats them to it, so the round shows which side
+	   of the deadline each press fell. A few ms clear, so a slow
+	   thread on the real clock doesn't hand it to them anyway. */
+	for(i = 0; i < n && last > 0; i++)
+		if(sp[i].EarlySlot == 0 && sp[i].PressSlot != 0)
+			sp[i].PressSlot += last + 5 * edge;
+}
+
+/* Who the schedule says should win, 0 for nobody, and how many tied for it */
+static int SimExpected(Sim *s, const SimPlayer *sp, int *tied)
+{
+	int i, best = -1;
+
+	*tied = 0;
+	for(i = 0; i < s->Cfg.Players; i++)
+	{
+		if(sp[i].PressSlot == 0 || SimPenalized(s, &sp[i]))
+			continue;
+
+		if(best < 0 || sp[i].PressSlot < sp[best].PressSlot)
+		{
+			best = i;
+			*tied = 1;
+		}
+		else if(sp[i].PressSlot == sp[best].PressSlot)
+		{
+			(*tied)++;
+			if(sp[i].Rank < sp[best].Rank)
+				best = i;
+		}
+	}
+
+	return best + 1;
+}
+
+/* Wait for one of the reactor's messages, up to ms; returns false on timeout */
+static bool SimWait(Sim *s, MsgQueue *q, Msg *m, int ms)
+{
+	uint64_t until = MonotonicNs() + (uint64_t)ms * 1000000ull;
+	uint64_t now;
+
+	while(!MsgQueuePop(q, m))
+	{
+		now = MonotonicNs();
+		if(now >= until)
+			return false;
+		ReactorWaitAny(&s->DriverFd, 1, (int)((until - now) / 1000000ull) + 1);
+	}
+
+	return true;
+}
+
+/* Let the winner's countdown run out, moving the virtual clock along
+   to each of its steps; returns false if it never does */
+static bool SimWaitTimeout(Sim *s)
+{
+	SimStats *st = &s->Stats;
+	uint64_t steps = s->Cfg.StepNs * (COUNTDOWN_SECONDS + 2);
+	uint64_t until, now, next;
+	Msg m;
+
+	/* the virtual countdown costs real time per step, not per second */
+	until = MonotonicNs() + (ClockVirtual ? (COUNTDOWN_SECONDS + 2) * SIM_DECIDE_MS * 1000000ull : steps) + SIM_DECIDE_MS * 1000000ull;
+	while((now = MonotonicNs()) < until)
+	{
+		while(MsgQueuePop(s->Mcp, &m))
+		{
+			if(m.Code == RESP_TIMED_OUT)
+			{
+				st->TimedOut++;
+				return true;
+			}
+			st->RangIn++;
+			s->McpPlayer = m.Player;
+		}
+
+		/* the reactor re-arms the countdown after each step; wait for
+		   that rather than jump past it to some later deadline */
+		if(ClockVirtual && (next = ClockNextDeadline()) > ClockNow())
+			ClockAdvance(next);
+		ReactorWaitAny(&s->DriverFd, 1, ClockVirtual ? 1 : (int)((until - now) / 1000000ull) + 1);
+	}
+
+	return false;
+}
+
+/* The operator hits the interrupt, in the next snapshot of bank, and
+   lets go; returns false if the winner's countdown is still running */
+static bool SimInterrupt(Sim *s, uint32_t bank)
+{
+	uint64_t grid = s->Cfg.ScanNs ? s->Cfg.ScanNs : 1000;
+	uint64_t before = atomic_load(&s->PutOut), until, t;
+	ScanResult res;
+
+	s->Stats.Interrupts++;
+	t = ClockNow() + grid;
+	SimClockTo(t);
+	ScannerDecode(&s->Scan, bank & ~(1u << OPERATOR_INTERRUPT), t, &res);
+
+	/* it goes straight from the scanner to the reactor; no clock involved */
+	until = MonotonicNs() + SIM_DECIDE_MS * 1000000ull;
+	while(atomic_load(&s->PutOut) == before && MonotonicNs() < until)
+		SimSettle();
+
+	SimClockTo(t + grid);
+	ScannerDecode(&s->Scan, bank, t + grid, &res);
+
+	if(atomic_load(&s->PutOut) != before)
+		return true;
+	s->Stats.InterruptMissed++;
+	return false;
+}
+
+/* This round's decision, skipping any that came in too late for an earlier one */
+static bool SimWaitDecision(Sim *s, Msg *m, int ms)
+{
+	while(SimWait(s, s->Decisions, m, ms))
+	{
+		if(m->Seq == (uint32_t)(s->Stats.Rounds + 1))
+			return true;
+		s->Stats.Late++;
+	}
+
+	return false;
+}
+
+static int SimRound(Sim *s)
+{
+	SimConfig *c = &s->Cfg;
+	SimStats *st = &s->Stats;
+	SimPlayer sp[MAX_PLAYERS];
+	SimEdge edges[3 * MAX_PLAYERS + 1];
+	ScanResult res;
+	uint64_t grid = c->ScanNs ? c->ScanNs : 1000;
+	uint64_t base, t, rangin = st->RangIn;
+	uint32_t bank = s->Idle;
+	int64_t first = 0;
+	int i, j, e, n = 0, expected, tied, winner = 0, bad = 0;
+	bool moved;
+	Msg m;
+
+	SimSchedule(s, sp);
+
+	for(i = 0; i < c->Players; i++)
+	{
+		if(sp[i].EarlySlot != 0)
+		{
+			edges[n++] = (SimEdge){ sp[i].EarlySlot, i, 0 };
+			edges[n++] = (SimEdge){ sp[i].EarlySlot + 5, i, 1 };
+			st->Early++;
+		}
+		if(sp[i].PressSlot != 0)
+		{
+			edges[n++] = (SimEdge){ sp[i].PressSlot, i, 0 };
+			st->Presses++;
+			st->Pressed[i]++;
+		}
+	}
+	edges[n++] = (SimEdge){ 0, -1, 0 };
+	qsort(edges, n, sizeof(edges[0]), CompareEdge);
+	if(edges[0].Slot < first)
+		first = edges[0].Slot;
+
+	/* play the snapshots on the game clock; on the real one the threads
+	   see real gaps, on the virtual one they get a moment after every
+	   button that moved, or an early press could come and go unseen */
+	base = ClockNow() + SIM_LEAD_NS + (uint64_t)(-first) * grid;
+	for(e = 0; e < n; )
+	{
+		t = base + edges[e].Slot * (int64_t)grid;
+		SimClockTo(t);
+		moved = false;
+		for(i = e; i < n && edges[i].Slot == edges[e].Slot; i++)
+		{
+			moved |= edges[i].Player >= 0;
+			if(edges[i].Player < 0)
+			{
+				bank = edges[i].Level ? bank | (1u << ENABLER) : bank & ~(1u << ENABLER);
+				SimEnabler(s, edges[i].Level, t);
+			}
+			else if(edges[i].Level)
+				bank |= 1u << s->Pins[edges[i].Player];
+			else
+				bank &= ~(1u << s->Pins[edges[i].Player]);
+		}
+
+		if(ScannerDecode(&s->Scan, bank, t, &res) > 0)
+		{
+			for(j = 0; j < res.Count; j++)
+				if(sp[res.Order[j]].PressSlot == edges[e].Slot)
+					sp[res.Order[j]].Rank = atomic_load(&s->Scan.TieRank[res.Order[j]]);
+		}
+		if(ClockVirtual && moved)
+			SimSettle();
+		e = i;
+	}
+
+	expected = SimExpected(s, sp, &tied);
+	if(expected)
+	{
+		st->Earned[expected - 1]++;
+		if(tied > 1)
+		{
+			st->Ties++;
+			for(i = 0; i < c->Players; i++)
+				if(sp[i].PressSlot == sp[expected - 1].PressSlot && !SimPenalized(s, &sp[i]))
+					st->TieRounds[i]++;
+		}
+	}
+
+	if(SimWaitDecision(s, &m, expected ? SIM_DECIDE_MS : SIM_NOBODY_MS))
+	{
+		winner = m.Player;
+		st->Decided++;
+		st->Won[winner - 1]++;
+		st->DecideNs[st->Decided - 1] = m.TimeNs;
+		if(tied > 1 && sp[winner - 1].PressSlot == sp[expected - 1].PressSlot)
+			st->TieWins[winner - 1]++;
+		if(SimPenalized(s, &sp[winner - 1]))
+			st->EarlyWins++;
+
+		/* the host judges the answer; now and then they let the clock run out */
+		if((int)(SimRand(s) % 100) < c->TimeoutPct)
+			SimWaitTimeout(s);
+		else if(c->InterruptPct > 0 && (int)(SimRand(s) % 100) < c->InterruptPct)
+		{
+			/* or the operator puts it out */
+			if(!SimInterrupt(s, bank))
+				bad = 1;
+		}
+		else
+			SimSend(s, SIM_COUNTDOWN_END, winner, 0, ClockNow());
+	}
+
+	if(winner != expected)
+	{
+		if(expected == 0)
+			st->Spurious++;
+		else if(winner == 0)
+			st->Missed++;
+		else
+			st->Wrong++;
+	}
+	if(winner != 0 && SimPenalized(s, &sp[winner - 1]))
+		bad = 1;
+	if(expected != 0 && winner != expected && sp[expected - 1].EarlySlot != 0)
+	{
+		st->PenaltyHeld++;
+		bad = 1;
+	}
+
+	/* everyone lets go and the Enabler drops for the next question */
+	t = ClockNow();
+	ScannerDecode(&s->Scan, s->Idle, t, &res);
+	SimEnabler(s, 1, t);
+	while(MsgQueuePop(s->Mcp, &m))
+	{
+		if(m.Code == RESP_RANG_IN)
+		{
+			st->RangIn++;
+			s->McpPlayer = m.Player;
+		}
+	}
+
+	/* the MCP starts a countdown on every ring-in it hears */
+	if(st->RangIn - rangin != (winner != 0) || s->McpPlayer != winner)
+	{
+		st->RangInOff++;
+		bad = 1;
+	}
+
+	s->McpPlayer = 0;
+	st->Rounds++;
+	if(winner != expected && (expected == 0 || winner == 0 || c->Strict))
+		bad = 1;
+	return bad;
+}
+
+static void SimPercentiles(FILE *f, const char *what, uint64_t *samples, size_t n)
+{
+	if(n == 0)
+		return;
+
+	qsort(samples, n, sizeof(samples[0]), CompareU64);
+	fprintf(f, "ringsim: %s: n=%zu min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f us\n", what, n,
+		samples[0] / 1e3, samples[n / 2] / 1e3, samples[n * 90 / 100] / 1e3,
+		samples[n * 99 / 100] / 1e3, samples[n * 999 / 1000] / 1e3, samples[n - 1] / 1e3);
+}
+
+static void SimReport(Sim *s, uint64_t elapsedns, uint64_t gamens)
+{
+	SimConfig *c = &s->Cfg;
+	SimStats *st = &s->Stats;
+	FILE *f = s->Report;
+	double share, earned, worst = 0;
+	int i;
+
+	fprintf(f, "ringsim: %d players, %llu rounds, seed %u, tie-break %s, scan %llu us, presses %llu us apart\n",
+		c->Players, (unsigned long long)st->Rounds, c->Seed, ScannerPolicyName(c->Policy),
+		(unsigned long long)(c->ScanNs / 1000), (unsigned long long)(c->SpacingNs / 1000));
+	fprintf(f, "ringsim: %.0f rounds/s over %.2f s; %llu presses, %llu early, %llu ring-ins passed to the MCP, %llu rounds not the winner's one\n",
+		st->Rounds / (elapsedns / 1e9), elapsedns / 1e9,
+		(unsigned long long)st->Presses, (unsigned long long)st->Early, (unsigned long long)st->RangIn,
+		(unsigned long long)st->RangInOff);
+	fprintf(f, "ringsim: %llu decided (%llu tied in one snapshot), %llu timed out; wrong winner %llu, missed %llu, unearned %llu, penalized winner %llu, late %llu\n",
+		(unsigned long long)st->Decided, (unsigned long long)st->Ties, (unsigned long long)st->TimedOut,
+		(unsigned long long)st->Wrong, (unsigned long long)st->Missed,
+		(unsigned long long)st->Spurious, (unsigned long long)st->EarlyWins, (unsigned long long)st->Late);
+	if(st->Interrupts > 0)
+		fprintf(f, "ringsim: %llu operator interrupts, %llu left the countdown running\n",
+			(unsigned long long)st->Interrupts, (unsigned long long)st->InterruptMissed);
+	if(st->Early > 0)
+		fprintf(f, "ringsim: penalty %d ms: %llu presses within %llu us of the deadline; penalized winner %llu, held too long %llu\n",
+			c->PenaltyMs, (unsigned long long)st->PenaltyEdge, (unsigned long long)(SIM_PENALTY_EDGE_NS / 1000),
+			(unsigned long long)st->EarlyWins, (unsigned long long)st->PenaltyHeld);
+	fprintf(f, "ringsim: %s clock: %.2f s of game in %.3f s (%.0fx real time)\n", ClockName(),
+		gamens / 1e9, elapsedns / 1e9, (double)gamens / elapsedns);
+	if(ClockVirtual)
+		fprintf(f, "ringsim: latencies below are game clock time, not how long the program took\n");
+	SimPercentiles(f, "press -> decision", st->DecideNs, st->Decided);
+
+	fprintf(f, "ringsim: %-6s %8s %8s %8s %8s %8s %9s\n", "player", "pressed", "earned", "won", "ties", "tie wins", "tie share");
+	for(i = 0; i < c->Players; i++)
+	{
+		fprintf(f, "ringsim: P%-5d %8llu %8llu %8llu %8llu %8llu %8.1f%%\n", i + 1,
+			(unsigned long long)st->Pressed[i], (unsigned long long)st->Earned[i],
+			(unsigned long long)st->Won[i], (unsigned long long)st->TieRounds[i],
+			(unsigned long long)st->TieWins[i],
+			st->TieRounds[i] ? 100.0 * st->TieWins[i] / st->TieRounds[i] : 0.0);
+
+		if(st->Decided > 0)
+		{
+			share = (double)st->Won[i] / st->Decided;
+			earned = (double)st->Earned[i] / st->Decided;
+			if(share - earned > worst || earned - share > worst)
+				worst = share > earned ? share - earned : earned - share;
+		}
+	}
+	fprintf(f, "ringsim: worst gap between a player's share of wins and of wins earned: %.2f%%\n", 100.0 * worst);
+
+	GameReport(&s->Game, f);
+	LatDump(f);
+}
+
+static int SimParse(SimConfig *c, int argc, char *argv[])
+{
+	int opt;
+
+	c->Players = 3;
+	c->Rounds = 2000;
+	c->Seed = 1;
+	c->Policy = TIEBREAK_LOWEST;
+	c->PolicySeed = 1;
+	c->ScanNs = 100000;
+	c->SpacingNs = 10000;
+	c->SpreadNs = 1000000;
+	c->PressPct = 100;
+	c->EarlyPct = 0;
+	c->PenaltyMs = PENALTY_DEFAULT_MS;
+	c->TimeoutPct = 2;
+	c->StepNs = 0;
+
+	while((opt = getopt(argc, argv, "n:r:s:t:u:j:w:p:e:P:o:I:c:T:SVv")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				c->Players = atoi(optarg);
+				break;
+			case 'r':
+				c->Rounds = atoi(optarg);
+				break;
+			case 's':
+				c->Seed = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				if(ScannerParsePolicy(optarg, &c->Policy, &c->PolicySeed) != 0)
+					return -1;
+				break;
+			case 'u':
+				c->ScanNs = strtoull(optarg, NULL, 0) * 1000ull;
+				break;
+			case 'j':
+				c->SpacingNs = strtoull(optarg, NULL, 0) * 1000ull;
+				break;
+			case 'w':
+				c->SpreadNs = strtoull(optarg, NULL, 0) * 1000ull;
+				break;
+			case 'p':
+				c->PressPct = atoi(optarg);
+				break;
+			case 'e':
+				c->EarlyPct = atoi(optarg);
+				break;
+			case 'P':
+				c->PenaltyMs = atoi(optarg);
+				break;
+			case 'o':
+				c->TimeoutPct = atoi(optarg);
+				break;
+			case 'I':
+				c->InterruptPct = atoi(optarg);
+				break;
+			case 'c':
+				c->StepNs = strtoull(optarg, NULL, 0) * 1000ull;
+				break;
+			case 'T':
+				c->TracePath = optarg;
+				break;
+			case 'S':
+				c->Strict = true;
+				break;
+			case 'V':
+				c->Virtual = true;
+				break;
+			case 'v':
+				c->Verbose = true;
+				break;
+			default:
+				return -1;
+		}
+	}
+
+	/* on the real clock a 1 ms step keeps timeouts quick; the virtual
+	   clock can afford a real show's full second */
+	if(c->StepNs == 0)
+		c->StepNs = c->Virtual ? 1000000000ull : 1000000ull;
+
+	if(c->Players < MIN_PLAYERS || c->Players > MAX_PLAYERS || c->Rounds < 1)
+	{
+		printf("ringsim: need %d-%d players and at least one round\n", MIN_PLAYERS, MAX_PLAYERS);
+		return -1;
+	}
+	if(c->PenaltyMs < 0 || c->PenaltyMs > UINT16_MAX)
+	{
+		printf("ringsim: the penalty goes in a 16 bit ms count, 0-%d\n", UINT16_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	Sim *s = calloc(1, sizeof(Sim));
+	PlayerPins pins[MAX_PLAYERS];
+	ReadyBarrier started;
+	uint64_t start, elapsed, gamestart, gamens;
+	uint8_t pin;
+	int i, quiet, saved, failed = 0;
+
+	if(SimParse(&s->Cfg, argc, argv) != 0)
+	{
+		printf("usage: %s [-n players] [-r rounds] [-s seed] [-t lowest|rotate|random[:seed]] [-u scan-usec] [-j tie-spacing-usec] [-w spread-usec] [-p press-percent] [-e early-percent] [-P penalty-ms] [-o timeout-percent] [-I interrupt-percent] [-c countdown-step-usec] [-T trace-file] [-S] [-V] [-v]\n", argv[0]);
+		return 1;
+	}
+	s->Rng = s->Cfg.Seed ? s->Cfg.Seed : 1;
+
+	/* before anything asks for a timer */
+	if(s->Cfg.Virtual)
+		ClockUseVirtual(MonotonicNs());
+	s->Stats.DecideNs = calloc(s->Cfg.Rounds, sizeof(uint64_t));
+
+	/* the player threads and the countdowns chat about everything; keep it
+	   out of the report unless asked */
+	fflush(stdout);
+	saved = dup(1);
+	s->Report = fdopen(saved, "w");
+	quiet = -1;
+	if(!s->Cfg.Verbose)
+	{
+		quiet = open("/dev/null", O_WRONLY);
+		dup2(quiet, 1);
+	}
+	else
+		LogStart(stdout, LOG_DEBUG, 0);
+
+	if(s->Cfg.TracePath != NULL)
+	{
+		unlink(s->Cfg.TracePath);
+		TraceOpen(s->Cfg.TracePath, 0);
+	}
+
+	GPIOSelectBackend("sim");
+	GPIOInit();
+
+	/* podium buttons on any pins but the Enabler's */
+	for(i = 0, pin = 0; i < s->Cfg.Players; pin++)
+	{
+		if(pin == ENABLER || pin == OPERATOR_INTERRUPT)
+			continue;
+		s->Pins[i] = pin;
+		pins[i].Input = pin;
+		pins[i].Led = PIN_NONE;
+		pins[i].Enable = PIN_NONE;
+		i++;
+	}
+
+	if(PlayerEngineInit(&s->Engine, pins, s->Cfg.Players) != 0)
+		return 1;
+	ScannerInit(&s->Scan, s->Pins, s->Cfg.Players, s->Cfg.Policy, s->Cfg.PolicySeed);
+	for(i = 0; i < s->Cfg.Players; i++)
+	{
+		s->Engine.Players[i].Scan = &s->Scan;
+		s->Engine.Players[i].WakeFd = ReactorEventFd();
+		s->Scan.WakeFd[i] = s->Engine.Players[i].WakeFd;
+	}
+	/* the players look for the Enabler in the snapshot too */
+	ScannerWatch(&s->Scan, ENABLER, -1);
+	CancelInit(&s->Operator);
+	s->InterruptFd = CancelListen(&s->Operator);
+	ScannerCancelOn(&s->Scan, OPERATOR_INTERRUPT, &s->Operator);
+	s->Idle = atomic_load(&s->Scan.Bank);
+
+	s->Cmd = aligned_alloc(64, sizeof(MsgQueue));
+	s->Decisions = aligned_alloc(64, sizeof(MsgQueue));
+	s->Mcp = aligned_alloc(64, sizeof(MsgQueue));
+	s->DriverFd = ReactorEventFd();
+	MsgQueueInit(s->Cmd, ReactorEventFd());
+	MsgQueueInit(s->Decisions, s->DriverFd);
+	MsgQueueInit(s->Mcp, s->DriverFd);
+
+	ReactorInit(&s->R);
+	if(GameInit(&s->Game, &s->Engine, s->Mcp, s->Cfg.StepNs) != 0)
+		return 1;
+	GameSetPenalty(&s->Game, s->Cfg.PenaltyMs);
+	s->Game.Awarded = SimOnAwarded;
+	s->Game.Ctx = s;
+	GameAttach(&s->Game, &s->R);
+	ReactorAdd(&s->R, s->Cmd->WakeFd, SimOnCmd, s);
+	ReactorAdd(&s->R, s->InterruptFd, SimOnInterrupt, s);
+
+	/* the Enabler starts out inactive, same as a real show */
+	GameEnabler(&s->Game, 1, ClockNow());
+
+	/* no round starts before every player thread is listening */
+	ReadyInit(&started, s->Cfg.Players);
+	for(i = 0; i < s->Cfg.Players; i++)
+		s->Engine.Players[i].Started = &started;
+	PlayerEngineStart(&s->Engine);
+	ReadyWait(&started, 1000);
+	pthread_create(&s->Thread, NULL, SimReactor, s);
+
+	start = MonotonicNs();
+	gamestart = ClockNow();
+	for(i = 0; i < s->Cfg.Rounds; i++)
+		failed |= SimRound(s);
+	elapsed = MonotonicNs() - start;
+	gamens = ClockNow() - gamestart;
+
+	SimSend(s, SIM_STOP, 0, 0, 0);
+	pthread_join(s->Thread, NULL);
+
+	LogStop();
+	fflush(stdout);
+	if(quiet >= 0)
+	{
+		dup2(saved, 1);
+		close(quiet);
+	}
+
+	SimReport(s, elapsed, gamens);
+	fflush(s->Report);
+
+	GameClose(&s->Game);
+	GPIOClose();
+	TraceClose();
+	return failed;
+}
@@ -0,0 +1,175 @@
+/* Filename: rt.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Real-time thread setup. See rt.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+bool RtMode = false;
+
+static const struct {
+	const char *Name;
+	int Priority;			// SCHED_FIFO, 1-99, or 0 to stay SCHED_OTHER
+} Roles[RT_ROLES] = {
+	[RT_SCANNER]	= { "scanner", 80 },
+	[RT_PLAYER]	= { "player", 70 },
+	[RT_MAIN]	= { "main", 60 },
+	/* SerialThread() sleeps in poll() until the MCP sends something or
+	   there's a ring-in to pass on, so it can be real-time too; below
+	   main(), whose countdowns and lockouts come first */
+	[RT_SERIAL]	= { "serial", 50 },
+};
+
+static cpu_set_t RoleCpus[RT_ROLES];
+static bool Pinned = false;
+
+typedef struct RtStart {
+	void *(*Fn)(void *);
+	void *Arg;
+} RtStart;
+
+const char *RtRoleName(RtRole role)
+{
+	return role < RT_ROLES ? Roles[role].Name : "?";
+}
+
+void RtPrefaultStack(size_t bytes)
+{
+	volatile unsigned char *stack = alloca(bytes);
+	size_t i;
+
+	/* one write per page is enough to get it mapped and, once
+	   mlockall() is in force, kept */
+	for(i = 0; i < bytes; i += 4096)
+		stack[i] = 0;
+}
+
+int RtSetup(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, r, failed = 0;
+
+	if(!RtMode)
+		return 0;
+
+	if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		printf("RtSetup(): couldn't lock memory (%s), page faults can still stall\n", strerror(errno));
+		failed = -1;
+	}
+	RtPrefaultStack(RT_PREFAULT_BYTES);
+
+	/* the scanner alone on the last CPU, the rest on the others; on a
+	   single CPU there's nothing to pin, priorities have to do */
+	for(r = 0; r < RT_ROLES; r++)
+		CPU_ZERO(&RoleCpus[r]);
+	if(cpus > 1)
+	{
+		CPU_SET(cpus - 1, &RoleCpus[RT_SCANNER]);
+		for(r = 0; r < RT_ROLES; r++)
+			for(i = 0; i < cpus - 1 && r != RT_SCANNER; i++)
+				CPU_SET(i, &RoleCpus[r]);
+		Pinned = true;
+	}
+
+	printf("RtSetup(): real-time mode: SCHED_FIFO scanner %d, player %d, main %d, serial %d; ",
+		Roles[RT_SCANNER].Priority, Roles[RT_PLAYER].Priority, Roles[RT_MAIN].Priority, Roles[RT_SERIAL].Priority);
+	if(Pinned)
+		printf("scanner on CPU %ld, everything else on CPUs 0-%ld\n", cpus - 1, cpus - 2);
+	else
+		printf("one CPU, nothing pinned\n");
+
+	return failed;
+}
+
+static void *RtTrampoline(void *arg)
+{
+	RtStart st = *(RtStart *)arg;
+
+	free(arg);
+	RtPrefaultStack(RT_PREFAULT_BYTES);
+	return st.Fn(st.Arg);
+}
+
+int RtThreadCreate(pthread_t *t, RtRole role, void *(*fn)(void *), void *arg)
+{
+	pthread_attr_t attr;
+	struct sched_param sp;
+	RtStart *st;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, RT_STACK_BYTES);
+
+	if(!RtMode)
+	{
+		err = pthread_create(t, &attr, fn, arg);
+		pthread_attr_destroy(&attr);
+		return err;
+	}
+
+	st = malloc(sizeof(*st));
+	if(st == NULL)
+		return ENOMEM;
+	st->Fn = fn;
+	st->Arg = arg;
+
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = Roles[role].Priority;
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, sp.sched_priority ? SCHED_FIFO : SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &sp);
+	if(Pinned)
+		pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &RoleCpus[role]);
+
+	err = pthread_create(t, &attr, RtTrampoline, st);
+	if(err == EPERM)
+	{
+		printf("RtThreadCreate(): not allowed SCHED_FIFO, starting the %s thread with default scheduling\n", Roles[role].Name);
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+		err = pthread_create(t, &attr, RtTrampoline, st);
+	}
+	if(err != 0)
+		free(st);
+
+	pthread_attr_destroy(&attr);
+	return err;
+}
+
+int RtApplySelf(RtRole role)
+{
+	struct sched_param sp;
+	int err;
+
+	if(!RtMode)
+		return 0;
+
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = Roles[role].Priority;
+	err = pthread_setschedparam(pthread_self(), sp.sched_priority ? SCHED_FIFO : SCHED_OTHER, &sp);
+	if(err != 0)
+		printf("RtApplySelf(): couldn't make the %s thread SCHED_FIFO (%s)\n", Roles[role].Name, strerror(err));
+	if(Pinned)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &RoleCpus[role]);
+
+	return err ? -1 : 0;
+}
@@ -0,0 +1,60 @@
+/* Filename: rt.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Opt-in real-time mode (-R). Every thread main() starts
+   goes through RtThreadCreate(), which in real-time mode gives it a
+   SCHED_FIFO priority for its job, pins it to its CPUs and faults in
+   its stack before it runs. The input scanner gets the last CPU to
+   itself when there is more than one; everything else shares the rest.
+   RtSetup() locks all memory, so a page fault can't stall a press.
+
+   Without -R threads are started the same way, with default
+   scheduling, so both modes can be compared on the same build.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef RT_H
+#define RT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define RT_STACK_BYTES		(256 * 1024)	// every thread's stack
+#define RT_PREFAULT_BYTES	(64 * 1024)	// how much of it to touch before running
+
+/* Highest priority first: the scanner's sampling is what makes a
+   press's timestamp, then the threads that judge and arbitrate it */
+typedef enum RtRole {
+	RT_SCANNER,
+	RT_PLAYER,
+	RT_MAIN,
+	RT_SERIAL,
+	RT_ROLES
+} RtRole;
+
+extern bool RtMode;
+
+/* Lock memory and work out which CPUs go to whom. Call once, before
+   starting any thread; returns -1 if any of it was refused. */
+int RtSetup(void);
+
+/* pthread_create() for role. Falls back to default scheduling if the
+   kernel won't allow SCHED_FIFO, rather than not start the thread. */
+int RtThreadCreate(pthread_t *t, RtRole role, void *(*fn)(void *), void *arg);
+
+/* Give the calling thread role's priority and CPUs */
+int RtApplySelf(RtRole role);
+
+/* Touch bytes of stack so it's all resident before it's needed */
+void RtPrefaultStack(size_t bytes);
+
+const char *RtRoleName(RtRole role);
+
+#endif
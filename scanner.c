@@ -0,0 +1,258 @@
+/* Filename: scanner.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Single-register input scanner. See scanner.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gpioio.h"
+#include "scanner.h"
+#include "trace.h"
+
+void ScannerInit(Scanner *sc, const uint8_t *pins, int players, TieBreak policy, uint32_t seed)
+{
+	int i;
+
+	memset(sc, 0, sizeof(*sc));
+	if(players > SCAN_MAX_PLAYERS)
+		players = SCAN_MAX_PLAYERS;
+
+	sc->Players = players;
+	for(i = 0; i < players; i++)
+	{
+		sc->Pins[i] = pins[i];
+		sc->PlayerMask |= 1u << pins[i];
+	}
+	for(i = 0; i < SCAN_MAX_PLAYERS; i++)
+		sc->WakeFd[i] = -1;
+	sc->WatchFd = -1;
+	sc->Policy = policy;
+	sc->Seed = seed ? seed : 1;		// xorshift must not start at 0
+
+	/* buttons idle high with the pull-ups on */
+	sc->LastBank = sc->PlayerMask;
+	atomic_store(&sc->Bank, sc->PlayerMask);
+	DebounceInit(&sc->Filter, sc->PlayerMask);
+}
+
+void ScannerWatch(Scanner *sc, uint8_t pin, int fd)
+{
+	sc->WatchMask |= 1u << pin;
+	sc->WatchFd = fd;
+
+	/* inputs idle high with the pull-ups on */
+	sc->LastBank |= 1u << pin;
+	atomic_fetch_or(&sc->Bank, 1u << pin);
+	sc->Filter.Stable |= 1u << pin;
+}
+
+void ScannerCancelOn(Scanner *sc, uint8_t pin, Cancel *c)
+{
+	sc->CancelMask |= 1u << pin;
+	sc->Interrupt = c;
+
+	/* idles high with the pull-up on, same as the buttons */
+	sc->LastBank |= 1u << pin;
+	atomic_fetch_or(&sc->Bank, 1u << pin);
+	sc->Filter.Stable |= 1u << pin;
+}
+
+static void Poke(int fd)
+{
+	uint64_t one = 1;
+
+	if(fd >= 0)
+		(void)!write(fd, &one, sizeof(one));
+}
+
+int ScannerParsePolicy(const char *arg, TieBreak *policy, uint32_t *seed)
+{
+	if(strcmp(arg, "lowest") == 0)
+		*policy = TIEBREAK_LOWEST;
+	else if(strcmp(arg, "rotate") == 0)
+		*policy = TIEBREAK_ROTATE;
+	else if(strncmp(arg, "random", 6) == 0 && (arg[6] == '\0' || arg[6] == ':'))
+	{
+		*policy = TIEBREAK_RANDOM;
+		if(arg[6] == ':')
+			*seed = strtoul(arg + 7, NULL, 0);
+	}
+	else
+	{
+		printf("ScannerParsePolicy(): unknown tie-break policy '%s' (lowest, rotate, random[:seed])\n", arg);
+		return -1;
+	}
+
+	return 0;
+}
+
+const char *ScannerPolicyName(TieBreak policy)
+{
+	switch(policy)
+	{
+		case TIEBREAK_LOWEST:
+			return "lowest";
+		case TIEBREAK_ROTATE:
+			return "rotate";
+		case TIEBREAK_RANDOM:
+			return "random";
+		default:
+			return "unknown";
+	}
+}
+
+static uint32_t XorShift32(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/* Put the tied players in res->Order (already in player order) into
+   tie-break order. */
+static void BreakTie(Scanner *sc, ScanResult *res)
+{
+	int i, j, tmp;
+
+	switch(sc->Policy)
+	{
+		case TIEBREAK_LOWEST:
+			break;
+		case TIEBREAK_ROTATE:
+			/* first tied player at or after RotateNext goes first, wrapping around */
+			for(i = 0; i < res->Count && res->Order[i] < sc->RotateNext; i++)
+				;
+			if(i > 0 && i < res->Count)
+			{
+				int rotated[SCAN_MAX_PLAYERS];
+
+				for(j = 0; j < res->Count; j++)
+					rotated[j] = res->Order[(i + j) % res->Count];
+				memcpy(res->Order, rotated, sizeof(int) * res->Count);
+			}
+			sc->RotateNext = (res->Order[0] + 1) % sc->Players;
+			break;
+		case TIEBREAK_RANDOM:
+			/* Fisher-Yates */
+			for(i = res->Count - 1; i > 0; i--)
+			{
+				j = XorShift32(&sc->Seed) % (uint32_t)(i + 1);
+				tmp = res->Order[i];
+				res->Order[i] = res->Order[j];
+				res->Order[j] = tmp;
+			}
+			break;
+	}
+}
+
+static void ScannerTrace(Scanner *sc, uint32_t changed, uint32_t bank, uint64_t now)
+{
+	uint32_t other = changed & (sc->WatchMask | sc->CancelMask) & ~sc->PlayerMask;
+	int i;
+
+	for(i = 0; i < sc->Players; i++)
+	{
+		if(changed & (1u << sc->Pins[i]))
+			TraceLogAt(now, TRACE_EDGE, i + 1, sc->Pins[i], (bank >> sc->Pins[i]) & 1,
+				((bank >> sc->Pins[i]) & 1) ? 0 : atomic_load_explicit(&sc->TieRank[i], memory_order_relaxed));
+	}
+	for(i = 0; i < 32; i++)
+	{
+		if(other & (1u << i))
+			TraceLogAt(now, TRACE_EDGE, 0, i, (bank >> i) & 1, 0);
+	}
+}
+
+/* Player p pressed at now: the seqlock writer side of ScannerPress(),
+   only ever called from the scanner's own thread */
+static void ScannerPublish(Scanner *sc, int p, uint64_t now, int rank)
+{
+	uint32_t seq = atomic_load_explicit(&sc->PressSeq[p], memory_order_relaxed);
+
+	atomic_store_explicit(&sc->PressSeq[p], seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&sc->PrevPressNs[p], atomic_load_explicit(&sc->PressNs[p], memory_order_relaxed), memory_order_relaxed);
+	atomic_store_explicit(&sc->PressNs[p], now, memory_order_relaxed);
+	atomic_store_explicit(&sc->TieRank[p], rank, memory_order_relaxed);
+	atomic_store_explicit(&sc->PressSeq[p], seq + 2, memory_order_release);
+}
+
+int ScannerDecode(Scanner *sc, uint32_t bank, uint64_t now, ScanResult *res)
+{
+	uint32_t pressed, changed;
+	int i;
+
+	sc->Samples++;
+	changed = sc->LastBank ^ bank;
+
+	/* active low: a bit that was 1 last sample and is 0 now is a new press */
+	pressed = sc->LastBank & ~bank & sc->PlayerMask;
+
+	if(pressed != 0)
+	{
+		res->TimeNs = now;
+		res->WindowNs = now - sc->LastNs;
+		res->Count = 0;
+		for(i = 0; i < sc->Players; i++)
+		{
+			if(pressed & (1u << sc->Pins[i]))
+				res->Order[res->Count++] = i;
+		}
+		res->Tie = res->Count > 1;
+
+		if(res->Tie)
+		{
+			sc->Ties++;
+			BreakTie(sc, res);
+		}
+
+		for(i = 0; i < res->Count; i++)
+			ScannerPublish(sc, res->Order[i], now, res->Tie ? i + 1 : 0);
+	}
+
+	if(changed & sc->WatchMask)
+		atomic_store_explicit(&sc->WatchNs, now, memory_order_release);
+
+	/* the operator interrupt wakes every wait itself, not via main() */
+	if(sc->LastBank & ~bank & sc->CancelMask)
+		CancelRaise(sc->Interrupt, now);
+
+	sc->LastBank = bank;
+	sc->LastNs = now;
+	atomic_store_explicit(&sc->Bank, bank, memory_order_release);
+
+	/* wake whoever is sleeping on a bit that moved */
+	if(changed & (sc->PlayerMask | sc->WatchMask | sc->CancelMask))
+	{
+		if(TraceActive != NULL)
+			ScannerTrace(sc, changed, bank, now);
+
+		for(i = 0; i < sc->Players; i++)
+			if(changed & (1u << sc->Pins[i]))
+				Poke(sc->WakeFd[i]);
+		if(changed & sc->WatchMask)
+			Poke(sc->WatchFd);
+	}
+
+	return pressed != 0 ? res->Count : 0;
+}
+
+int ScannerSample(Scanner *sc, uint64_t now, ScanResult *res)
+{
+	return ScannerDecode(sc, DebounceFilter(&sc->Filter, GPIOLevBank()), now, res);
+}
@@ -0,0 +1,141 @@
+/* Filename: scanner.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Single-register input scanner. Every player's button
+   is decoded from one GPLEV0 snapshot, so two near-simultaneous
+   presses are ordered by the hardware sample rather than by whichever
+   thread the scheduler happened to run first. Presses that land in
+   the same sample are reported as a tie and ordered by a
+   deterministic, configurable tie-break policy.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "debounce.h"
+#include "cancel.h"
+
+#define SCAN_MAX_PLAYERS 16
+
+typedef enum TieBreak {
+	TIEBREAK_LOWEST,			// lowest player number wins every tie
+	TIEBREAK_ROTATE,			// tie winner rotates, starting after the last tie's winner
+	TIEBREAK_RANDOM				// seeded pseudo-random, same seed gives the same order
+} TieBreak;
+
+typedef struct ScanResult {
+	uint64_t TimeNs;			// when the snapshot was taken
+	uint64_t WindowNs;			// presses happened somewhere in the WindowNs before TimeNs
+	int Count;				// players newly pressed in this snapshot
+	int Order[SCAN_MAX_PLAYERS];		// their indices, tie-break winner first
+	bool Tie;				// Count > 1
+} ScanResult;
+
+typedef struct Scanner {
+	int Players;
+	uint8_t Pins[SCAN_MAX_PLAYERS];		// BCM GPIO of each player, all below 32
+	uint32_t PlayerMask;
+	TieBreak Policy;
+	uint32_t Seed;
+	int RotateNext;
+
+	/* ScannerSample() debounces the raw bank before decoding it */
+	Debounce Filter;
+	uint32_t LastBank;
+	uint64_t LastNs;
+
+	/* Published for the player threads and main(). A player's press is
+	   written before Bank, so a reader that sees its bit low in Bank
+	   sees the press that made it low. Read them with ScannerPress():
+	   PressSeq is a seqlock, odd while the scanner is rewriting them,
+	   so the three always come from the same snapshot and the 64-bit
+	   ones can't tear on a 32-bit Pi. */
+	_Atomic uint32_t Bank;
+	_Atomic uint32_t PressSeq[SCAN_MAX_PLAYERS];
+	_Atomic uint64_t PressNs[SCAN_MAX_PLAYERS];
+	_Atomic uint64_t PrevPressNs[SCAN_MAX_PLAYERS];	// the press before, for a thread that slept through both
+	_Atomic uint8_t TieRank[SCAN_MAX_PLAYERS];	// 0 = not in a tie, otherwise 1-based place in it
+
+	/* eventfds poked after a snapshot in which the bit changed, so
+	   consumers can sleep instead of spinning on Bank. -1 for none. */
+	int WakeFd[SCAN_MAX_PLAYERS];
+	uint32_t WatchMask;			// extra non-player pins (the Enabler)
+	int WatchFd;
+	_Atomic uint64_t WatchNs;		// snapshot time of the last change in WatchMask, see ScannerWatchNs()
+	uint32_t CancelMask;			// pins that raise Interrupt on going low (the operator interrupt)
+	Cancel *Interrupt;
+
+	unsigned long Samples;
+	unsigned long Ties;
+} Scanner;
+
+/* One player's press as the scanner last published it */
+typedef struct ScanPress {
+	uint64_t PressNs;
+	uint64_t PrevPressNs;
+	uint8_t TieRank;
+} ScanPress;
+
+void ScannerInit(Scanner *sc, const uint8_t *pins, int players, TieBreak policy, uint32_t seed);
+/* Also track a non-player pin, poking fd whenever it changes. All
+   watched pins share the one fd. */
+void ScannerWatch(Scanner *sc, uint8_t pin, int fd);
+/* Raise c, stamped with the snapshot, whenever pin goes low */
+void ScannerCancelOn(Scanner *sc, uint8_t pin, Cancel *c);
+
+int ScannerParsePolicy(const char *arg, TieBreak *policy, uint32_t *seed);
+const char *ScannerPolicyName(TieBreak policy);
+
+/* Decode one snapshot taken at now. Returns the number of players newly
+   pressed (active low) and fills res when that is nonzero. */
+int ScannerDecode(Scanner *sc, uint32_t bank, uint64_t now, ScanResult *res);
+
+/* Read the bank from the active GPIO backend, debounce it and decode it. */
+int ScannerSample(Scanner *sc, uint64_t now, ScanResult *res);
+
+/* Level of a player's pin in the latest snapshot. */
+static inline uint8_t ScannerLev(Scanner *sc, int player)
+{
+	return (atomic_load_explicit(&sc->Bank, memory_order_acquire) >> sc->Pins[player]) & 1;
+}
+
+/* Level of any pin in the latest snapshot. */
+static inline uint8_t ScannerPinLev(Scanner *sc, uint8_t pin)
+{
+	return (atomic_load_explicit(&sc->Bank, memory_order_acquire) >> pin) & 1;
+}
+
+/* A player's latest press, all three fields from the same snapshot */
+static inline void ScannerPress(Scanner *sc, int player, ScanPress *out)
+{
+	uint32_t seq;
+
+	do
+	{
+		while((seq = atomic_load_explicit(&sc->PressSeq[player], memory_order_acquire)) & 1)
+			;
+		out->PressNs = atomic_load_explicit(&sc->PressNs[player], memory_order_relaxed);
+		out->PrevPressNs = atomic_load_explicit(&sc->PrevPressNs[player], memory_order_relaxed);
+		out->TieRank = atomic_load_explicit(&sc->TieRank[player], memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+	} while(atomic_load_explicit(&sc->PressSeq[player], memory_order_relaxed) != seq);
+}
+
+/* Snapshot time of the last change on a watched pin (the Enabler) */
+static inline uint64_t ScannerWatchNs(Scanner *sc)
+{
+	return atomic_load_explicit(&sc->WatchNs, memory_order_acquire);
+}
+
+#endif
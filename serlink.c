@@ -0,0 +1,253 @@
+/* Filename: serlink.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Keeps the serial port to the MCP open. See serlink.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <termios.h>
+#include <sys/inotify.h>
+
+#include "clock.h"
+#include "serlink.h"
+
+int SerLinkInit(SerLink *l, const char *path)
+{
+	char *dir;
+
+	memset(l, 0, sizeof(*l));
+	l->Path = path;
+	l->Fd = -1;
+	l->RetryMs = SERLINK_RETRY_MIN_MS;
+	l->DownNs = MonotonicNs();
+
+	/* the device node coming and going, or udev fixing its permissions */
+	l->WatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(l->WatchFd < 0)
+		return 0;
+	dir = strdup(path);
+	if(dir == NULL || inotify_add_watch(l->WatchFd, dirname(dir), IN_CREATE | IN_MOVED_TO | IN_ATTRIB) < 0)
+	{
+		close(l->WatchFd);
+		l->WatchFd = -1;
+	}
+	free(dir);
+
+	return 0;
+}
+
+void SerLinkClose(SerLink *l)
+{
+	if(l->Fd >= 0)
+		close(l->Fd);
+	if(l->WatchFd >= 0)
+		close(l->WatchFd);
+	l->Fd = -1;
+	l->WatchFd = -1;
+}
+
+static const struct {
+	int Rate;
+	speed_t Speed;
+} SerLinkBauds[] = {
+	{ 1000000, B1000000 },
+	{ 921600, B921600 },
+	{ 500000, B500000 },
+	{ 460800, B460800 },
+	{ 230400, B230400 },
+	{ 115200, B115200 },
+	{ 57600, B57600 },
+	{ 38400, B38400 },
+	{ 19200, B19200 },
+	{ 9600, B9600 }
+};
+
+#define SERLINK_BAUDS	(sizeof(SerLinkBauds) / sizeof(SerLinkBauds[0]))
+
+static int SerLinkBaudIndex(int rate)
+{
+	int i;
+
+	for(i = 0; i < (int)SERLINK_BAUDS; i++)
+		if(SerLinkBauds[i].Rate == rate)
+			return i;
+	return -1;
+}
+
+bool SerLinkBaudSupported(int rate)
+{
+	return SerLinkBaudIndex(rate) >= 0 && rate >= SERLINK_BASE_BAUD && rate <= SERLINK_MAX_BAUD;
+}
+
+int SerLinkSlowerBaud(int rate)
+{
+	int i;
+
+	for(i = 0; i < (int)SERLINK_BAUDS; i++)
+		if(SerLinkBauds[i].Rate < rate)
+			return SerLinkBauds[i].Rate > SERLINK_BASE_BAUD ? SerLinkBauds[i].Rate : SERLINK_BASE_BAUD;
+	return SERLINK_BASE_BAUD;
+}
+
+/* 8N1 at rate, raw */
+static int SerLinkConfigure(int fd, int rate)
+{
+	struct termios options;
+	int i = SerLinkBaudIndex(rate);
+
+	if(i < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if(tcgetattr(fd, &options) != 0)
+		return -1;
+
+	cfsetispeed(&options, SerLinkBauds[i].Speed);
+	cfsetospeed(&options, SerLinkBauds[i].Speed);
+
+	options.c_cflag &= ~PARENB;
+	options.c_cflag &= ~CSTOPB;
+	options.c_cflag &= ~CSIZE;
+	options.c_cflag |= CS8;
+	options.c_cflag &= ~CRTSCTS;
+	options.c_cc[VMIN] = 1;
+	options.c_cc[VTIME] = 5;
+	options.c_cflag |= CREAD | CLOCAL;
+	options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG | IEXTEN);
+	/* frames are binary: 0x11 and 0x13 are not XON/XOFF, 0x0D and
+	   0x0A are not line endings */
+	options.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL | INLCR | IGNCR | ISTRIP | BRKINT | PARMRK | INPCK);
+	options.c_oflag &= ~OPOST;
+
+	return tcsetattr(fd, TCSANOW, &options);
+}
+
+bool SerLinkOpen(SerLink *l)
+{
+	int fd;
+
+	if(l->Fd >= 0)
+		return true;
+
+	fd = open(l->Path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if(fd >= 0 && SerLinkConfigure(fd, SERLINK_BASE_BAUD) != 0)
+	{
+		l->LastErrno = errno;
+		close(fd);
+		fd = -1;
+	}
+	else if(fd < 0)
+		l->LastErrno = errno;
+
+	if(fd < 0)
+	{
+		/* not yet; look again later, less often the longer it's gone */
+		l->RetryNs = MonotonicNs() + (uint64_t)l->RetryMs * 1000000ull;
+		l->RetryMs *= 2;
+		if(l->RetryMs > SERLINK_RETRY_MAX_MS)
+			l->RetryMs = SERLINK_RETRY_MAX_MS;
+		return false;
+	}
+
+	l->Fd = fd;
+	l->Baud = SERLINK_BASE_BAUD;
+	l->Opens++;
+	l->RetryMs = SERLINK_RETRY_MIN_MS;
+	l->LastDownMs = (MonotonicNs() - l->DownNs) / 1000000ull;
+	return true;
+}
+
+int SerLinkSetBaud(SerLink *l, int rate)
+{
+	struct termios options;
+	int i = SerLinkBaudIndex(rate);
+
+	if(l->Fd < 0 || i < 0)
+	{
+		errno = l->Fd < 0 ? EBADF : EINVAL;
+		return -1;
+	}
+	if(tcgetattr(l->Fd, &options) != 0)
+		return -1;
+
+	cfsetispeed(&options, SerLinkBauds[i].Speed);
+	cfsetospeed(&options, SerLinkBauds[i].Speed);
+	if(tcsetattr(l->Fd, TCSADRAIN, &options) != 0)
+		return -1;
+
+	l->Baud = rate;
+	return 0;
+}
+
+void SerLinkDrop(SerLink *l)
+{
+	if(l->Fd < 0)
+		return;
+
+	close(l->Fd);
+	l->Fd = -1;
+	l->Drops++;
+	l->DownNs = MonotonicNs();
+
+	/* it may well be back before the first retry; the watch will say */
+	l->RetryMs = SERLINK_RETRY_MIN_MS;
+	l->RetryNs = l->DownNs + (uint64_t)l->RetryMs * 1000000ull;
+}
+
+int SerLinkTimeout(const SerLink *l)
+{
+	uint64_t now;
+
+	if(l->Fd >= 0)
+		return -1;
+
+	now = MonotonicNs();
+	if(now >= l->RetryNs)
+		return 0;
+	return (int)((l->RetryNs - now + 999999) / 1000000ull);
+}
+
+bool SerLinkService(SerLink *l)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	const char *name;
+	bool seen = false;
+	ssize_t got;
+	char *p;
+
+	if(l->Fd >= 0)
+		return false;
+
+	/* anything happen to our device's name? */
+	name = strrchr(l->Path, '/');
+	name = name ? name + 1 : l->Path;
+	while(l->WatchFd >= 0 && (got = read(l->WatchFd, buf, sizeof(buf))) > 0)
+	{
+		for(p = buf; p < buf + got; p += sizeof(*ev) + ev->len)
+		{
+			ev = (const struct inotify_event *)p;
+			if(ev->len > 0 && strcmp(ev->name, name) == 0)
+				seen = true;
+		}
+	}
+
+	if(!seen && MonotonicNs() < l->RetryNs)
+		return false;
+
+	return SerLinkOpen(l);
+}
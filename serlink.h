@@ -0,0 +1,95 @@
+/* Filename: serlink.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Keeps the serial port to the MCP open. If the device
+   isn't there, or goes away (a USB adapter pulled, the MCP reset), the
+   link waits for it to come back without using any CPU: an inotify
+   watch on its directory says the moment the device node appears or
+   changes, and a retry timer backing off from SERLINK_RETRY_MIN_MS to
+   SERLINK_RETRY_MAX_MS covers whatever inotify can't see. The caller
+   poll()s SerLinkPollFd() for SerLinkTimeout() ms and calls
+   SerLinkService() when either runs out.
+
+   It always opens at SERLINK_BASE_BAUD, what every MCP speaks; see
+   serproto.h for how the two ends agree on something faster.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef SERLINK_H
+#define SERLINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SERLINK_DEFAULT_PATH	"/dev/ttyS0"
+#define SERLINK_RETRY_MIN_MS	50
+#define SERLINK_RETRY_MAX_MS	2000
+
+#define SERLINK_BASE_BAUD	9600
+#define SERLINK_MAX_BAUD	1000000
+#define SERLINK_PINGS		8	// round trips timed at pairing
+#define SERLINK_BAUD_REVERT_MS	500	// MCP goes back to the base rate if not told to keep the new one
+
+typedef struct SerLink {
+	const char *Path;
+	int Fd;				// the port, -1 while it's down
+	int WatchFd;			// inotify on Path's directory, -1 if we couldn't
+	int RetryMs;			// next wait, doubling while it stays down
+	int Baud;			// what the port is set to now
+	uint64_t RetryNs;		// when to try again without being told
+
+	uint64_t DownNs;		// when it went down, for how long it took to come back
+	uint64_t LastDownMs;		// ...and how long that was, last time
+	int LastErrno;			// why the last open failed
+	unsigned long Opens;
+	unsigned long Drops;
+} SerLink;
+
+/* Set up to keep path open; doesn't open it yet */
+int SerLinkInit(SerLink *l, const char *path);
+void SerLinkClose(SerLink *l);
+
+/* Try to open and set up the port now. Returns true if it's up. */
+bool SerLinkOpen(SerLink *l);
+
+/* Rates we can set the port to, fastest first, and the next one down
+   from rate (SERLINK_BASE_BAUD at the bottom) */
+bool SerLinkBaudSupported(int rate);
+int SerLinkSlowerBaud(int rate);
+
+/* Switch the port's speed once what's been written has gone out.
+   Returns 0, or -1 with errno set. */
+int SerLinkSetBaud(SerLink *l, int rate);
+
+/* The port went away (EOF, a hangup or a read error); close it and
+   start waiting for it again */
+void SerLinkDrop(SerLink *l);
+
+static inline bool SerLinkUp(const SerLink *l)
+{
+	return l->Fd >= 0;
+}
+
+/* What to poll() for POLLIN: the port while it's up, the inotify watch
+   while it's down (-1 if there's none) */
+static inline int SerLinkPollFd(const SerLink *l)
+{
+	return l->Fd >= 0 ? l->Fd : l->WatchFd;
+}
+
+/* How long poll() may sleep before SerLinkService() is due: -1 while
+   the port is up */
+int SerLinkTimeout(const SerLink *l);
+
+/* While it's down: take what the watch saw and try again if the
+   device showed up or the retry is due. Returns true if the port has
+   just come back up. */
+bool SerLinkService(SerLink *l);
+
+#endif
@@ -0,0 +1,205 @@
+/* Filename: serout.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Outbound queue to the MCP. See serout.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "serout.h"
+
+void SerOutInit(SerOut *o)
+{
+	memset(o, 0, sizeof(*o));
+}
+
+static SerOutPrio SerOutPriority(uint8_t type)
+{
+	switch(type)
+	{
+		case FRAME_RINGIN:
+			return SEROUT_RINGIN;
+		case FRAME_TIMED_OUT:
+		case FRAME_READY:
+			return SEROUT_STATUS;
+		default:
+			return SEROUT_REPLY;
+	}
+}
+
+bool SerOutPush(SerOut *o, uint8_t type, const void *payload, uint8_t len, uint64_t nowns, uint64_t startns)
+{
+	SerOutPrio prio = SerOutPriority(type);
+	SerOutMsg *m;
+	uint32_t i;
+
+	if(len > FRAME_MAX_PAYLOAD)
+		return false;
+
+	/* the MCP only needs telling once */
+	if(prio == SEROUT_STATUS)
+	{
+		for(i = o->Tail[prio]; i != o->Head[prio]; i++)
+		{
+			m = &o->Slots[prio][i % SEROUT_SLOTS];
+			if(m->Type == type && m->Len == len && memcmp(m->Payload, payload, len) == 0)
+			{
+				o->Merged++;
+				return true;
+			}
+		}
+	}
+
+	if(o->Head[prio] - o->Tail[prio] == SEROUT_SLOTS)
+		return false;
+
+	m = &o->Slots[prio][o->Head[prio]++ % SEROUT_SLOTS];
+	m->Type = type;
+	m->Len = len;
+	if(len > 0)
+		memcpy(m->Payload, payload, len);
+	m->QueuedNs = nowns;
+	m->StartNs = startns;
+	o->Queued++;
+	return true;
+}
+
+int SerOutDepth(const SerOut *o)
+{
+	int prio, depth = 0;
+
+	for(prio = 0; prio < SEROUT_PRIOS; prio++)
+		depth += o->Head[prio] - o->Tail[prio];
+	return depth;
+}
+
+/* The old single bytes for m into out; 0 if it has none */
+static size_t SerOutLegacy(const SerOutMsg *m, uint8_t *out)
+{
+	switch(m->Type)
+	{
+		case FRAME_PAIR_ACK:
+			out[0] = '@';
+			return 1;
+		case FRAME_READY:
+			memcpy(out, "SReady\r\n", 8);
+			return 8;
+		case FRAME_RINGIN:	// '1'-'3'
+		case FRAME_TIMED_OUT:	// '4'-'6'
+			if(m->Len < 1 || m->Payload[0] < 1 || m->Payload[0] > 3)
+				return 0;
+			out[0] = (m->Type == FRAME_RINGIN ? '0' : '3') + m->Payload[0];
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+int SerOutEncode(SerOut *o, bool framed, uint16_t *txseq, uint32_t timeus)
+{
+	SerOutMsg *m;
+	size_t len;
+	int prio, n = 0, depth = SerOutDepth(o);
+
+	if(depth == 0)
+		return 0;
+
+	o->Batches++;
+	o->DepthSum += depth;
+	if(depth > o->MaxDepth)
+		o->MaxDepth = depth;
+
+	/* make room behind what the port hasn't taken yet */
+	if(o->Sent > 0)
+	{
+		memmove(o->Buf, o->Buf + o->Sent, o->Have - o->Sent);
+		o->Have -= o->Sent;
+		o->Sent = 0;
+	}
+
+	for(prio = 0; prio < SEROUT_PRIOS; prio++)
+	{
+		while(o->Tail[prio] != o->Head[prio] && o->Have + FRAME_MAX <= sizeof(o->Buf)
+			&& o->FlightHead - o->FlightTail < SEROUT_FLIGHT)
+		{
+			m = &o->Slots[prio][o->Tail[prio]++ % SEROUT_SLOTS];
+			if(framed)
+				len = FrameEncode(o->Buf + o->Have, m->Type, (*txseq)++, timeus, m->Payload, m->Len);
+			else
+				len = SerOutLegacy(m, o->Buf + o->Have);
+			o->Have += len;
+			o->Encoded += len;
+			m->End = o->Encoded;
+			o->Flight[o->FlightHead++ % SEROUT_FLIGHT] = *m;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+ssize_t SerOutWrite(SerOut *o, int fd)
+{
+	ssize_t got;
+
+	if(o->Have == o->Sent)
+		return 0;
+
+	got = write(fd, o->Buf + o->Sent, o->Have - o->Sent);
+	if(got < 0)
+		return errno == EAGAIN ? 0 : -1;
+
+	o->Writes++;
+	o->Bytes += got;
+	o->Taken += got;
+	o->Sent += got;
+	if(o->Sent == o->Have)
+		o->Sent = o->Have = 0;
+	return got;
+}
+
+int SerOutSent(SerOut *o, SerOutMsg *done, int max)
+{
+	SerOutMsg *m;
+	int n = 0;
+
+	while(o->FlightTail != o->FlightHead)
+	{
+		m = &o->Flight[o->FlightTail % SEROUT_FLIGHT];
+		if(m->End > o->Taken)
+			break;
+		if(done != NULL && n < max)
+			done[n] = *m;
+		o->FlightTail++;
+		n++;
+	}
+
+	return n;
+}
+
+void SerOutDiscard(SerOut *o)
+{
+	int prio;
+
+	for(prio = 0; prio < SEROUT_PRIOS; prio++)
+	{
+		o->Dropped += o->Head[prio] - o->Tail[prio];
+		o->Tail[prio] = o->Head[prio];
+	}
+
+	/* encoded but not all sent: never will be now */
+	for(; o->FlightTail != o->FlightHead; o->FlightTail++)
+		if(o->Flight[o->FlightTail % SEROUT_FLIGHT].End > o->Taken)
+			o->Dropped++;
+	o->Taken = o->Encoded;
+	o->Sent = o->Have = 0;
+}
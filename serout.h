@@ -0,0 +1,110 @@
+/* Filename: serout.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Messages waiting to go to the MCP. Everything the
+   serial thread has for the MCP in one wakeup (ring-ins from main(),
+   answers to what the MCP just sent, time-outs) is queued here and
+   goes out in one write(), ring-ins first: at 9600 baud every byte
+   ahead of a ring-in is another millisecond before the MCP starts the
+   countdown. A status message already waiting isn't queued twice, and
+   what the port won't take yet is kept for when it will.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef SEROUT_H
+#define SEROUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "serproto.h"
+
+#define SEROUT_SLOTS		32	// messages waiting, per priority
+#define SEROUT_BYTES		1024	// encoded, waiting for the port
+#define SEROUT_FLIGHT		128	// encoded messages the port hasn't taken all of
+
+typedef enum SerOutPrio {
+	SEROUT_RINGIN,			// FRAME_RINGIN: the MCP starts the countdown on it
+	SEROUT_REPLY,			// pairing acks, pings and rate changes, in order
+	SEROUT_STATUS,			// time-outs and hello; repeats merged
+	SEROUT_PRIOS
+} SerOutPrio;
+
+typedef struct SerOutMsg {
+	uint8_t Type;			// FrameType
+	uint8_t Len;
+	uint8_t Payload[FRAME_MAX_PAYLOAD];
+	uint64_t QueuedNs;
+	uint64_t StartNs;		// the press, for a ring-in; 0 otherwise
+	uint64_t End;			// once encoded: Encoded just past its last byte
+} SerOutMsg;
+
+typedef struct SerOut {
+	SerOutMsg Slots[SEROUT_PRIOS][SEROUT_SLOTS];
+	uint32_t Head[SEROUT_PRIOS];	// queued, ever
+	uint32_t Tail[SEROUT_PRIOS];	// encoded, ever
+
+	uint8_t Buf[SEROUT_BYTES];
+	size_t Sent;			// Buf up to here has gone...
+	size_t Have;			// ...up to here is waiting
+
+	/* Encoded messages, in the order their bytes are in Buf, until the
+	   port has taken the last of them. End and the two counts below run
+	   over every byte ever encoded, so they survive Buf being compacted. */
+	SerOutMsg Flight[SEROUT_FLIGHT];
+	uint32_t FlightHead, FlightTail;
+	uint64_t Encoded;		// bytes ever put in Buf
+	uint64_t Taken;			// ...and ever taken by the port or thrown away
+
+	unsigned long Queued;
+	unsigned long Merged;		// status messages already waiting
+	unsigned long Dropped;		// no room, or thrown away with the port gone
+	unsigned long Writes;
+	unsigned long Bytes;
+	unsigned long Batches;		// SerOutEncode() calls that had something
+	unsigned long DepthSum;		// messages waiting at each of those
+	int MaxDepth;
+} SerOut;
+
+void SerOutInit(SerOut *o);
+
+/* Queue a message; startns is the press for a ring-in, else 0.
+   Returns false if there was no room: SerOutEncode() and try again,
+   or count it in Dropped. */
+bool SerOutPush(SerOut *o, uint8_t type, const void *payload, uint8_t len, uint64_t nowns, uint64_t startns);
+
+/* Messages waiting to be encoded */
+int SerOutDepth(const SerOut *o);
+
+/* Move what's queued into Buf, ring-ins first, as frames (numbered
+   from *txseq) or, if the MCP hasn't shown it speaks them, the old
+   single bytes. Returns how many; anything that doesn't fit stays
+   queued. */
+int SerOutEncode(SerOut *o, bool framed, uint16_t *txseq, uint32_t timeus);
+
+/* One write() of everything encoded. Returns what the port took
+   (from Buf + Sent before the call), 0 if it took nothing, or -1. */
+ssize_t SerOutWrite(SerOut *o, int fd);
+
+/* Messages whose last byte the port has taken since the last call,
+   oldest first, copied to done up to max (may be NULL); returns how
+   many. Call it after each SerOutWrite() so Flight doesn't fill up. */
+int SerOutSent(SerOut *o, SerOutMsg *done, int max);
+
+/* Encoded bytes the port hasn't taken yet: poll() for POLLOUT */
+static inline bool SerOutPending(const SerOut *o)
+{
+	return o->Have > o->Sent;
+}
+
+/* The port's gone; throw it all away */
+void SerOutDiscard(SerOut *o);
+
+#endif
@@ -0,0 +1,360 @@
+/* Filename: serproto.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: MCP frame parser and encoder. See serproto.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "serproto.h"
+
+/* payloads for the old single-byte commands */
+static const uint8_t LegacyPlayer[] = { 1, 2, 3 };
+
+void FrameParserInit(FrameParser *p)
+{
+	memset(p, 0, sizeof(*p));
+}
+
+uint16_t FrameCrc(const uint8_t *data, size_t len)
+{
+	uint16_t crc = 0xffff;
+	size_t i;
+	int bit;
+
+	for(i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for(bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+
+	return crc;
+}
+
+/* Look at a candidate frame starting at b[0] == FRAME_SYNC. Returns its
+   total size if it is complete and good, 0 if more bytes are needed,
+   or -1 if it can't be a frame. */
+static int FrameCheck(FrameParser *p, const uint8_t *b, size_t n, Frame *f)
+{
+	size_t size;
+	uint16_t crc;
+
+	if(n >= 2 && b[1] != FRAME_VERSION)
+		return -1;
+	if(n >= 4 && b[3] > FRAME_MAX_PAYLOAD)
+		return -1;
+	if(n < FRAME_HEADER)
+		return 0;
+
+	size = FRAME_HEADER + b[3] + FRAME_CRC;
+	if(n < size)
+		return 0;
+
+	crc = b[size - 2] | (b[size - 1] << 8);
+	if(FrameCrc(b + 1, size - 1 - FRAME_CRC) != crc)
+	{
+		p->BadCrc++;
+		return -1;
+	}
+
+	f->Version = b[1];
+	f->Type = b[2];
+	f->Len = b[3];
+	f->Seq = b[4] | (b[5] << 8);
+	f->TimeUs = (uint32_t)b[6] | ((uint32_t)b[7] << 8) | ((uint32_t)b[8] << 16) | ((uint32_t)b[9] << 24);
+	f->Payload = b + FRAME_HEADER;
+
+	p->Frames++;
+	p->Framed = true;
+	return (int)size;
+}
+
+static bool FrameLegacy(uint8_t c, Frame *f)
+{
+	memset(f, 0, sizeof(*f));
+	switch(c)
+	{
+		case '!':
+			f->Type = FRAME_PAIR_REQ;
+			return true;
+		case '7':
+		case '8':
+		case '9':
+			f->Type = FRAME_COUNTDOWN_END;
+			f->Len = 1;
+			f->Payload = &LegacyPlayer[c - '7'];
+			return true;
+		default:
+			return false;
+	}
+}
+
+int FrameParse(FrameParser *p, const uint8_t **data, size_t *len, Frame *f)
+{
+	const uint8_t *d = *data;
+	size_t n = *len, need, take;
+	uint8_t *sync;
+	int r;
+
+	/* the last frame came out of Buf; whatever followed it is still to be looked at */
+	if(p->Used > 0)
+	{
+		p->Have -= p->Used;
+		memmove(p->Buf, p->Buf + p->Used, p->Have);
+		p->Used = 0;
+	}
+
+	/* finish a frame that started in an earlier read */
+	while(p->Have > 0)
+	{
+		r = FrameCheck(p, p->Buf, p->Have, f);
+		if(r > 0)
+		{
+			p->Used = r;		// f->Payload points into Buf until the next call
+			*data = d;
+			*len = n;
+			return 1;
+		}
+
+		if(r < 0)
+		{
+			/* not a frame after all, look for the next sync byte in what we kept */
+			sync = memchr(p->Buf + 1, FRAME_SYNC, p->Have - 1);
+			need = sync ? (size_t)(sync - p->Buf) : p->Have;
+			p->Skipped += need;
+			p->Have -= need;
+			memmove(p->Buf, p->Buf + need, p->Have);
+			continue;
+		}
+
+		if(n == 0)
+		{
+			*data = d;
+			*len = 0;
+			return 0;
+		}
+
+		need = p->Have < 4 ? 4 - p->Have : p->Have < FRAME_HEADER ? FRAME_HEADER - p->Have : FRAME_HEADER + p->Buf[3] + FRAME_CRC - p->Have;
+		take = n < need ? n : need;
+		memcpy(p->Buf + p->Have, d, take);
+		p->Have += take;
+		d += take;
+		n -= take;
+	}
+
+	/* then work straight out of the caller's buffer */
+	while(n > 0)
+	{
+		if(d[0] != FRAME_SYNC)
+		{
+			if(!p->Framed && FrameLegacy(d[0], f))
+			{
+				p->Legacy++;
+				*data = d + 1;
+				*len = n - 1;
+				return 1;
+			}
+
+			p->Skipped++;
+			d++;
+			n--;
+			continue;
+		}
+
+		r = FrameCheck(p, d, n, f);
+		if(r > 0)
+		{
+			*data = d + r;
+			*len = n - r;
+			return 1;
+		}
+
+		if(r < 0)
+		{
+			p->Skipped++;
+			d++;
+			n--;
+			continue;
+		}
+
+		/* partial frame at the end of this read, keep it */
+		memcpy(p->Buf, d, n);
+		p->Have = n;
+		d += n;
+		n = 0;
+	}
+
+	*data = d;
+	*len = 0;
+	return 0;
+}
+
+size_t FrameEncode(uint8_t *out, uint8_t type, uint16_t seq, uint32_t timeus, const void *payload, uint8_t len)
+{
+	size_t size = FRAME_HEADER + len;
+	uint16_t crc;
+
+	if(len > FRAME_MAX_PAYLOAD)
+		return 0;
+
+	out[0] = FRAME_SYNC;
+	out[1] = FRAME_VERSION;
+	out[2] = type;
+	out[3] = len;
+	out[4] = seq & 0xff;
+	out[5] = seq >> 8;
+	out[6] = timeus & 0xff;
+	out[7] = (timeus >> 8) & 0xff;
+	out[8] = (timeus >> 16) & 0xff;
+	out[9] = timeus >> 24;
+	if(len)
+		memcpy(out + FRAME_HEADER, payload, len);
+
+	crc = FrameCrc(out + 1, size - 1);
+	out[size] = crc & 0xff;
+	out[size + 1] = crc >> 8;
+
+	return size + FRAME_CRC;
+}
+
+int FrameSeqCheck(FrameSeq *s, uint16_t seq)
+{
+	uint16_t ahead;
+
+	if(!s->Synced)
+	{
+		s->Synced = true;
+		s->Next = seq + 1;
+		return 0;
+	}
+
+	/* anything in the half-window behind Next has been seen already */
+	ahead = seq - s->Next;
+	if(ahead >= 0x8000)
+	{
+		s->Dups++;
+		return -1;
+	}
+
+	s->Lost += ahead;
+	s->Next = seq + 1;
+	return ahead;
+}
+
+void SerRingInit(SerRing *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+ssize_t SerRingRead(SerRing *r, int fd, uint64_t nowns)
+{
+	struct iovec iov[2];
+	uint32_t at, room, first;
+	ssize_t got, total = 0;
+	int n;
+
+	while((room = SER_RING_BYTES - (r->Head - r->Tail)) > 0)
+	{
+		/* free space runs to the end of Buf, then from the start */
+		at = r->Head & (SER_RING_BYTES - 1);
+		first = SER_RING_BYTES - at < room ? SER_RING_BYTES - at : room;
+		iov[0].iov_base = r->Buf + at;
+		iov[0].iov_len = first;
+		iov[1].iov_base = r->Buf;
+		iov[1].iov_len = room - first;
+		n = iov[1].iov_len > 0 ? 2 : 1;
+
+		got = readv(fd, iov, n);
+		if(got < 0 && errno == EINTR)
+			continue;
+		if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if(got == 0)
+			errno = 0;		// hung up, not an error as such
+		if(got <= 0)
+			return total > 0 ? total : -1;
+
+		r->Head += got;
+		r->Reads++;
+		r->Bytes += got;
+		total += got;
+	}
+
+	if(total > 0)
+	{
+		/* one stamp per wake-up; if the parser has fallen that far
+		   behind, the newest stamp just covers more */
+		if(r->StampHead - r->StampTail == SER_RING_STAMPS)
+			r->StampHead--;
+		r->Stamps[r->StampHead & (SER_RING_STAMPS - 1)].End = r->Head;
+		r->Stamps[r->StampHead & (SER_RING_STAMPS - 1)].Ns = nowns;
+		r->StampHead++;
+	}
+
+	return total;
+}
+
+int SerRingParse(SerRing *r, FrameParser *p, Frame *f, uint64_t *arrivedns)
+{
+	const uint8_t *data;
+	size_t len, n;
+	uint32_t at;
+
+	do
+	{
+		/* up to the end of Buf; a frame split across the wrap is
+		   finished by FrameParse() from its own buffer */
+		at = r->Tail & (SER_RING_BYTES - 1);
+		len = r->Head - r->Tail;
+		if(len > SER_RING_BYTES - at)
+			len = SER_RING_BYTES - at;
+		data = r->Buf + at;
+		n = len;
+
+		if(FrameParse(p, &data, &len, f))
+		{
+			r->Tail += n - len;
+
+			/* the read that brought in byte Tail - 1 */
+			while(r->StampTail != r->StampHead && r->Stamps[r->StampTail & (SER_RING_STAMPS - 1)].End < r->Tail)
+				r->LastNs = r->Stamps[r->StampTail++ & (SER_RING_STAMPS - 1)].Ns;
+			*arrivedns = r->StampTail != r->StampHead ? r->Stamps[r->StampTail & (SER_RING_STAMPS - 1)].Ns : r->LastNs;
+			return 1;
+		}
+		r->Tail += n - len;
+	}
+	while(r->Tail != r->Head);
+
+	/* all parsed; what's left of a frame finishes in a later read */
+	while(r->StampTail != r->StampHead && r->Stamps[r->StampTail & (SER_RING_STAMPS - 1)].End <= r->Tail)
+		r->LastNs = r->Stamps[r->StampTail++ & (SER_RING_STAMPS - 1)].Ns;
+	return 0;
+}
+
+int SerRingLast(const SerRing *r, uint32_t n, const uint8_t **span, size_t *spanlen)
+{
+	uint32_t at = (r->Head - n) & (SER_RING_BYTES - 1);
+
+	span[0] = r->Buf + at;
+	if(at + n <= SER_RING_BYTES)
+	{
+		spanlen[0] = n;
+		return 1;
+	}
+
+	spanlen[0] = SER_RING_BYTES - at;
+	span[1] = r->Buf;
+	spanlen[1] = n - spanlen[0];
+	return 2;
+}
@@ -0,0 +1,167 @@
+/* Filename: serproto.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Framed binary protocol for the serial link to the MCP.
+   The old link was single ASCII bytes with no way to tell a dropped
+   or doubled byte from line noise. Each frame now carries its own
+   length, type, sequence number, sender timestamp and CRC:
+
+	offset	size
+	0	1	FRAME_SYNC (0xA5)
+	1	1	version, FRAME_VERSION
+	2	1	type, FrameType
+	3	1	payload length, 0 to FRAME_MAX_PAYLOAD
+	4	2	sequence number, little endian, +1 per frame sent
+	6	4	sender timestamp in microseconds, little endian, wraps
+	10	n	payload
+	10+n	2	CRC-16/CCITT-FALSE of bytes 1 to 9+n, little endian
+
+   That is 12 bytes of overhead, 12.5 ms for an empty frame at 9600
+   baud. An MCP still speaking the old single bytes ('!', '7', '8',
+   '9') is understood until the first good frame arrives; see
+   FrameParse().
+
+   Changing speed: the link always opens at SERLINK_BASE_BAUD. At the
+   first framed pairing we send FRAME_BAUD with the fastest rate we'll
+   go to. The MCP answers FRAME_BAUD_ACK with the rate it picks (no
+   faster than asked, 0 for none), finishes sending it and switches;
+   we switch when it arrives. We then time SERLINK_PINGS FRAME_PINGs
+   at the new rate and, if every FRAME_PONG came back, send FRAME_BAUD
+   with the same rate again to say keep it. An MCP that doesn't get
+   that within SERLINK_BAUD_REVERT_MS of switching goes back to the
+   base rate, and so do we, trying the next rate down once it has.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef SERPROTO_H
+#define SERPROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FRAME_SYNC		0xA5
+#define FRAME_VERSION		1
+#define FRAME_HEADER		10
+#define FRAME_CRC		2
+#define FRAME_MAX_PAYLOAD	32
+#define FRAME_MAX		(FRAME_HEADER + FRAME_MAX_PAYLOAD + FRAME_CRC)
+
+#define SER_RING_BYTES		1024	// receive ring, must be a power of 2
+#define SER_RING_STAMPS		8	// arrival times kept, must be a power of 2
+
+typedef enum FrameType {
+	/* MCP -> us */
+	FRAME_PAIR_REQ		= 0x01,	// was '!'; resets the MCP's sequence numbering
+	FRAME_COUNTDOWN_END	= 0x10,	// was '7'/'8'/'9'; payload: player
+	FRAME_PENALTY		= 0x11,	// new; payload: early ring-in penalty (ms, LE16)
+	FRAME_BAUD_ACK		= 0x04,	// payload: rate it's switching to (LE32), 0 to stay put
+	FRAME_PONG		= 0x05,	// payload: the FRAME_PING's, echoed
+
+	/* us -> MCP */
+	FRAME_PAIR_ACK		= 0x02,	// was '@'
+	FRAME_READY		= 0x03,	// was "SReady\r\n"
+	FRAME_RINGIN		= 0x20,	// was '1'; payload: player, tie rank, press time (us, LE32)
+	FRAME_TIMED_OUT		= 0x21,	// was '4'; payload: player
+	FRAME_BAUD		= 0x06,	// payload: rate to switch to (LE32); see below
+	FRAME_PING		= 0x07	// payload: ping number
+} FrameType;
+
+typedef struct Frame {
+	uint8_t Version;			// 0 for an old single-byte command
+	uint8_t Type;				// FrameType
+	uint8_t Len;
+	uint16_t Seq;
+	uint32_t TimeUs;
+	const uint8_t *Payload;			// Len bytes, valid until the next FrameParse()
+} Frame;
+
+typedef struct FrameParser {
+	uint8_t Buf[FRAME_MAX];			// only used for a frame split across reads
+	size_t Have;
+	size_t Used;				// bytes of Buf handed out as the last frame
+	bool Framed;				// seen a good frame, stop accepting single bytes
+
+	unsigned long Frames;
+	unsigned long Legacy;
+	unsigned long BadCrc;
+	unsigned long Skipped;			// bytes thrown away hunting for FRAME_SYNC
+} FrameParser;
+
+/* Bytes from the MCP, read straight in as they come and parsed out in
+   place, each remembered with when it arrived */
+typedef struct SerRing {
+	uint8_t Buf[SER_RING_BYTES];
+	uint32_t Head;				// bytes read in, ever
+	uint32_t Tail;				// bytes parsed
+	struct {
+		uint32_t End;			// Head after the read...
+		uint64_t Ns;			// ...and when it was woken for
+	} Stamps[SER_RING_STAMPS];
+	uint32_t StampHead;
+	uint32_t StampTail;
+	uint64_t LastNs;
+
+	unsigned long Reads;
+	unsigned long Bytes;
+} SerRing;
+
+typedef struct FrameSeq {
+	bool Synced;
+	uint16_t Next;
+	unsigned long Lost;
+	unsigned long Dups;
+} FrameSeq;
+
+void FrameParserInit(FrameParser *p);
+
+/* Pull the next frame out of data (len bytes), advancing both past what was
+   used. Returns 1 with f filled in, or 0 once the input is used up
+   (a partial frame is kept for the next call). A frame that lies
+   entirely inside the caller's buffer is not copied; f->Payload points
+   straight into it. Bad sync, version, length or CRC drops one byte
+   and hunts for the next FRAME_SYNC. */
+int FrameParse(FrameParser *p, const uint8_t **data, size_t *len, Frame *f);
+
+/* Build a frame in out (at least FRAME_HEADER + len + FRAME_CRC bytes).
+   Returns its size, or 0 if len is too long. */
+size_t FrameEncode(uint8_t *out, uint8_t type, uint16_t seq, uint32_t timeus, const void *payload, uint8_t len);
+
+uint16_t FrameCrc(const uint8_t *data, size_t len);
+
+/* Track the peer's sequence numbers. Returns how many frames went
+   missing just before this one, or -1 if it is a duplicate (or older)
+   and should be ignored. FrameSeqReset() on pairing. */
+int FrameSeqCheck(FrameSeq *s, uint16_t seq);
+
+void SerRingInit(SerRing *r);
+
+/* Read everything fd (non-blocking) has for us, up to the room left,
+   and stamp it as arrived at nowns. Returns the bytes read, 0 if
+   there were none, or -1 if fd has gone: errno 0 for EOF, or the read
+   error (never EAGAIN). */
+ssize_t SerRingRead(SerRing *r, int fd, uint64_t nowns);
+
+/* The next whole frame in the ring, as FrameParse() does it: returns 1
+   with f filled in and *arrivedns set to when its last byte came in,
+   or 0 once the ring is used up, a partial frame kept in p. f->Payload
+   is good until the next SerRingRead(). */
+int SerRingParse(SerRing *r, FrameParser *p, Frame *f, uint64_t *arrivedns);
+
+/* n bytes read in most recently, as up to two spans (the ring wraps);
+   returns the number of spans */
+int SerRingLast(const SerRing *r, uint32_t n, const uint8_t **span, size_t *spanlen);
+
+static inline void FrameSeqReset(FrameSeq *s)
+{
+	s->Synced = false;
+}
+
+#endif
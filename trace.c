@@ -0,0 +1,153 @@
+/* Filename: trace.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: mmap'd ring file event trace. See trace.h.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+Trace *TraceActive = NULL;
+
+static Trace TraceFile;
+
+int TraceOpen(const char *path, uint64_t records)
+{
+	Trace *t = &TraceFile;
+	char prev[4096];
+	struct timespec ts;
+
+	if(TraceActive != NULL)
+		TraceClose();
+	if(records == 0)
+		records = TRACE_DEFAULT_RECORDS;
+
+	snprintf(prev, sizeof(prev), "%s.prev", path);
+	if(access(path, F_OK) == 0 && rename(path, prev) != 0)
+		printf("TraceOpen(): couldn't keep the old trace as %s - error %d %s\n", prev, errno, strerror(errno));
+
+	t->Capacity = records;
+	t->Size = TRACE_HEADER_SIZE + records * sizeof(TraceRecord);
+	t->Fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(t->Fd == -1)
+	{
+		printf("TraceOpen(): failed to open %s - error %d %s\n", path, errno, strerror(errno));
+		return -1;
+	}
+
+	/* allocate the whole file up front so a full disk shows up now,
+	   not as a SIGBUS halfway through a game */
+	if(posix_fallocate(t->Fd, 0, t->Size) != 0 && ftruncate(t->Fd, t->Size) != 0)
+	{
+		printf("TraceOpen(): failed to size %s - error %d %s\n", path, errno, strerror(errno));
+		close(t->Fd);
+		return -1;
+	}
+
+	t->Header = mmap(NULL, t->Size, PROT_READ | PROT_WRITE, MAP_SHARED, t->Fd, 0);
+	if(t->Header == MAP_FAILED)
+	{
+		printf("TraceOpen(): failed to map %s - error %d %s\n", path, errno, strerror(errno));
+		close(t->Fd);
+		return -1;
+	}
+	t->Records = (TraceRecord *)((char *)t->Header + TRACE_HEADER_SIZE);
+
+	/* keep the hot path from ever taking a page fault */
+	mlock(t->Header, t->Size);
+
+	memcpy(t->Header->Magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	t->Header->Version = TRACE_VERSION;
+	t->Header->RecordSize = sizeof(TraceRecord);
+	t->Header->Capacity = records;
+	t->Header->OpenMonoNs = ClockNow();
+	clock_gettime(CLOCK_REALTIME, &ts);
+	t->Header->OpenRealNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+	atomic_store(&t->Header->Head, 0);
+
+	TraceActive = t;
+	TraceLog(TRACE_START, 0, 0xff, TRACE_VERSION, (uint64_t)getpid());
+	return 0;
+}
+
+void TraceClose(void)
+{
+	Trace *t = TraceActive;
+
+	if(t == NULL)
+		return;
+
+	TraceLog(TRACE_STOP, 0, 0xff, 0, 0);
+	TraceActive = NULL;
+
+	/* not needed to survive a crash, but a clean exit may as well hit the disk */
+	msync(t->Header, t->Size, MS_SYNC);
+	munmap(t->Header, t->Size);
+	close(t->Fd);
+}
+
+void TraceWrite(Trace *t, uint64_t ns, uint8_t type, uint8_t player, uint8_t pin, uint32_t value, uint64_t arg)
+{
+	uint64_t seq = atomic_fetch_add_explicit(&t->Header->Head, 1, memory_order_relaxed);
+	TraceRecord *r = &t->Records[seq % t->Capacity];
+	uint64_t cur = atomic_load_explicit(&r->Seq, memory_order_relaxed);
+	uint64_t busy = TRACE_SEQ_BUSY | (seq + 1);
+
+	/* mark the slot as ours and in progress, fill it in, then publish it.
+	   If we were preempted long enough for the ring to come round, the
+	   slot holds a newer record: drop ours rather than put it over that
+	   one. If someone is still filling it in, older or newer, drop ours
+	   too. Only the writer that claimed a slot ever touches its fields,
+	   so a record can't be published with someone else's in it. */
+	do
+	{
+		if((cur & TRACE_SEQ_BUSY) || cur > seq + 1)
+			return;
+	} while(!atomic_compare_exchange_weak_explicit(&r->Seq, &cur, busy, memory_order_acquire, memory_order_relaxed));
+	atomic_thread_fence(memory_order_release);
+	r->TimeNs = ns;
+	r->Type = type;
+	r->Player = player;
+	r->Pin = pin;
+	r->Pad = 0;
+	r->Value = value;
+	r->Arg = arg;
+	atomic_store_explicit(&r->Seq, seq + 1, memory_order_release);
+}
+
+void TraceBytes(uint8_t type, const uint8_t *data, size_t len)
+{
+	Trace *t = TraceActive;
+	uint64_t now, arg;
+	size_t n, i;
+
+	if(t == NULL)
+		return;
+
+	now = ClockNow();
+	while(len > 0)
+	{
+		n = len < 8 ? len : 8;
+		arg = 0;
+		for(i = 0; i < n; i++)
+			arg |= (uint64_t)data[i] << (8 * i);
+		TraceWrite(t, now, type, 0, 0xff, n, arg);
+		data += n;
+		len -= n;
+	}
+}
@@ -0,0 +1,117 @@
+/* Filename: trace.h
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Always-on binary event trace. Every input edge, Enabler
+   change, command, serial byte and light change is written as one
+   32-byte record into a ring in a memory-mapped file. The mapping is
+   MAP_SHARED, so the records are in the kernel's page cache the moment
+   they are written and survive a crash or ^C; only losing power loses
+   them. Use tracedump (make jeopardy-trace) to read one back.
+
+   Writing a record is an atomic add to claim a slot and a handful of
+   stores, from any thread; it never blocks or allocates. With no trace
+   open, TraceLog() is a single test of a NULL pointer.
+
+   File layout: a TRACE_HEADER_SIZE header, then Capacity records. The
+   record for sequence number n lives in slot n % Capacity and has
+   Seq = n + 1 once it is complete, so a reader can tell a finished
+   record from one that was being written when we died (those have
+   TRACE_SEQ_BUSY set). A writer that finds a newer record already in
+   its slot, or another writer still filling it in, drops its own.
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "clock.h"
+
+#define TRACE_MAGIC		"JPTRACE"
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	4096
+#define TRACE_DEFAULT_RECORDS	65536		// 2 MB, a long show's worth
+#define TRACE_SEQ_BUSY		(1ull << 63)	// in Seq while the record is being written
+
+typedef enum TraceType {
+	TRACE_START		= 1,	// trace opened, Arg = pid
+	TRACE_STOP,			// clean shutdown
+	TRACE_EDGE,			// input edge: Pin, Value = level, Player if it's a podium, Arg = tie rank
+	TRACE_ENABLER,			// Enabler change: Value = 0 active, 1 inactive
+	TRACE_CMD,			// main() -> player: Player, Value = MsgCode, Arg = Msg.Seq
+	TRACE_RESP,			// player -> main(): Player, Value = MsgCode, Arg = Msg.TimeNs
+	TRACE_SERIAL_RX,		// bytes from the MCP: Value = count (up to 8), Arg = the bytes
+	TRACE_SERIAL_TX,		// bytes to the MCP, same layout
+	TRACE_LIGHT,			// output write: Pin, Value = level
+	TRACE_NOTE,			// free-form marker: Value/Arg caller-defined
+	TRACE_LIGHTS			// output mask write: Value = GPIOs set high, Arg = GPIOs cleared
+} TraceType;
+
+typedef struct TraceRecord {
+	uint64_t TimeNs;			// CLOCK_MONOTONIC
+	_Atomic uint64_t Seq;			// sequence number + 1, written last
+	uint8_t Type;				// TraceType
+	uint8_t Player;				// 1-based, 0 for none
+	uint8_t Pin;				// BCM GPIO, 0xff for none
+	uint8_t Pad;
+	uint32_t Value;
+	uint64_t Arg;
+} TraceRecord;
+
+typedef struct TraceHeader {
+	char Magic[8];
+	uint32_t Version;
+	uint32_t RecordSize;
+	uint64_t Capacity;			// records in the ring
+	uint64_t OpenMonoNs;			// CLOCK_MONOTONIC and CLOCK_REALTIME at open,
+	uint64_t OpenRealNs;			// to put wall-clock times on the records
+	_Alignas(64) _Atomic uint64_t Head;	// next sequence number to hand out
+} TraceHeader;
+
+typedef struct Trace {
+	TraceHeader *Header;
+	TraceRecord *Records;
+	uint64_t Capacity;
+	int Fd;
+	size_t Size;
+} Trace;
+
+/* The process-wide trace, NULL when tracing is off */
+extern Trace *TraceActive;
+
+/* Create (or replace) a trace file with room for records records and
+   make it the active trace. An existing file at path is kept as
+   path.prev, so restarting after a crash doesn't eat the evidence. */
+int TraceOpen(const char *path, uint64_t records);
+void TraceClose(void);
+
+void TraceWrite(Trace *t, uint64_t ns, uint8_t type, uint8_t player, uint8_t pin, uint32_t value, uint64_t arg);
+
+static inline void TraceLogAt(uint64_t ns, uint8_t type, uint8_t player, uint8_t pin, uint32_t value, uint64_t arg)
+{
+	Trace *t = TraceActive;
+
+	if(t != NULL)
+		TraceWrite(t, ns, type, player, pin, value, arg);
+}
+
+static inline void TraceLog(uint8_t type, uint8_t player, uint8_t pin, uint32_t value, uint64_t arg)
+{
+	Trace *t = TraceActive;
+
+	if(t != NULL)
+		TraceWrite(t, ClockNow(), type, player, pin, value, arg);
+}
+
+/* Serial traffic, split into records of up to 8 bytes */
+void TraceBytes(uint8_t type, const uint8_t *data, size_t len);
+
+#endif
@@ -0,0 +1,212 @@
+/* Filename: tracedump.c
+   Author: neko2k (neko2k@beige-box)
+   Website: http://www.beige-box.com
+   Description: Turns a trace file written by trace.c into a readable
+   timeline, oldest record first. Works on a trace left behind by a
+   crash; records that were half written when it happened are counted
+   and skipped.
+
+   Usage: jeopardy-trace trace-file [-p player]
+
+   The following source code is (c) 2014-2022 The Little Beige Box
+   and is released as open-source software under the terms of the
+   Pirate License. Yar har fiddle dee dee being a pirate is alright
+   to be do what you want cause a pirate is free you are a pirate!
+
+   support@beige-box.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "msgqueue.h"
+
+static const char *TypeName(uint8_t type)
+{
+	switch(type)
+	{
+		case TRACE_START:	return "START";
+		case TRACE_STOP:	return "STOP";
+		case TRACE_EDGE:	return "EDGE";
+		case TRACE_ENABLER:	return "ENABLER";
+		case TRACE_CMD:		return "CMD";
+		case TRACE_RESP:	return "RESP";
+		case TRACE_SERIAL_RX:	return "SER-RX";
+		case TRACE_SERIAL_TX:	return "SER-TX";
+		case TRACE_LIGHT:	return "LIGHT";
+		case TRACE_NOTE:	return "NOTE";
+		case TRACE_LIGHTS:	return "LIGHTS";
+		default:		return "?";
+	}
+}
+
+static const char *MsgName(uint32_t code)
+{
+	switch(code)
+	{
+		case CMD_OPERATOR_INTERRUPT:	return "CMD_OPERATOR_INTERRUPT";
+		case CMD_INPUT_EDGE:		return "CMD_INPUT_EDGE";
+		case CMD_ENABLER_ACTIVE:	return "CMD_ENABLER_ACTIVE";
+		case CMD_ENABLER_INACTIVE:	return "CMD_ENABLER_INACTIVE";
+		case CMD_RINGIN_WON:		return "CMD_RINGIN_WON";
+		case CMD_LOCKED_OUT:		return "CMD_LOCKED_OUT";
+		case RESP_RANG_IN:		return "RESP_RANG_IN";
+		case RESP_TIMED_OUT:		return "RESP_TIMED_OUT";
+		case RESP_COUNTDOWN:		return "RESP_COUNTDOWN";
+		case RESP_PENALIZED:		return "RESP_PENALIZED";
+		default:			return "?";
+	}
+}
+
+static void PrintDetail(const TraceRecord *r, uint64_t base)
+{
+	uint32_t i;
+	uint8_t c;
+
+	switch(r->Type)
+	{
+		case TRACE_START:
+			printf("trace v%u opened by pid %llu", r->Value, (unsigned long long)r->Arg);
+			break;
+		case TRACE_EDGE:
+			printf("gpio %u %s", r->Pin, r->Value ? "high" : "low (pressed)");
+			if(r->Arg)
+				printf(", place %llu in a tie", (unsigned long long)r->Arg);
+			break;
+		case TRACE_ENABLER:
+			printf("%s", r->Value ? "inactive" : "active");
+			break;
+		case TRACE_CMD:
+			printf("%s seq %llu", MsgName(r->Value), (unsigned long long)r->Arg);
+			break;
+		case TRACE_RESP:
+			printf("%s", MsgName(r->Value));
+			if(r->Arg >= base && r->Value != RESP_TIMED_OUT)
+				printf(", pressed at %.6f", (r->Arg - base) / 1e9);
+			break;
+		case TRACE_SERIAL_RX:
+		case TRACE_SERIAL_TX:
+			for(i = 0; i < r->Value && i < 8; i++)
+				printf("%02x ", (unsigned)((r->Arg >> (8 * i)) & 0xff));
+			printf(" \"");
+			for(i = 0; i < r->Value && i < 8; i++)
+			{
+				c = (r->Arg >> (8 * i)) & 0xff;
+				putchar(c >= 0x20 && c < 0x7f ? c : '.');
+			}
+			printf("\"");
+			break;
+		case TRACE_LIGHT:
+			printf("gpio %u %s", r->Pin, r->Value ? "on" : "off");
+			break;
+		case TRACE_NOTE:
+			printf("%u %llu", r->Value, (unsigned long long)r->Arg);
+			break;
+		case TRACE_LIGHTS:
+			printf("on");
+			for(i = 0; i < 32; i++)
+				if(r->Value & (1u << i))
+					printf(" %u", i);
+			printf(", off");
+			for(i = 0; i < 32; i++)
+				if(r->Arg & (1ull << i))
+					printf(" %u", i);
+			break;
+		default:
+			break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const TraceHeader *h;
+	const TraceRecord *records, *r;
+	struct stat st;
+	uint64_t head, first, seq, base = 0, last = 0, torn = 0;
+	time_t wall;
+	char when[64];
+	int fd, player = 0;
+
+	if(argc < 2)
+	{
+		printf("usage: %s trace-file [-p player]\n", argv[0]);
+		return 1;
+	}
+	if(argc >= 4 && strcmp(argv[2], "-p") == 0)
+		player = atoi(argv[3]);
+
+	fd = open(argv[1], O_RDONLY);
+	if(fd == -1 || fstat(fd, &st) != 0)
+	{
+		printf("tracedump: can't open %s - error %d %s\n", argv[1], errno, strerror(errno));
+		return 1;
+	}
+	if((size_t)st.st_size < TRACE_HEADER_SIZE)
+	{
+		printf("tracedump: %s is too short to be a trace\n", argv[1]);
+		return 1;
+	}
+
+	h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(h == MAP_FAILED)
+	{
+		printf("tracedump: can't map %s - error %d %s\n", argv[1], errno, strerror(errno));
+		return 1;
+	}
+
+	if(memcmp(h->Magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || h->Version != TRACE_VERSION || h->RecordSize != sizeof(TraceRecord)
+		|| (uint64_t)st.st_size < TRACE_HEADER_SIZE + h->Capacity * sizeof(TraceRecord) || h->Capacity == 0)
+	{
+		printf("tracedump: %s isn't a version %d trace file\n", argv[1], TRACE_VERSION);
+		return 1;
+	}
+
+	records = (const TraceRecord *)((const char *)h + TRACE_HEADER_SIZE);
+	head = atomic_load(&((TraceHeader *)h)->Head);
+	first = head > h->Capacity ? head - h->Capacity : 0;
+
+	wall = (time_t)(h->OpenRealNs / 1000000000ull);
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&wall));
+	printf("tracedump: %s: opened %s, %llu records written, %llu kept\n", argv[1], when,
+		(unsigned long long)head, (unsigned long long)(head - first));
+	printf("%14s %12s  %-8s %-3s  %s\n", "seconds", "delta us", "event", "ply", "detail");
+
+	base = h->OpenMonoNs;
+	for(seq = first; seq < head; seq++)
+	{
+		r = &records[seq % h->Capacity];
+		if(atomic_load(&((TraceRecord *)r)->Seq) != seq + 1)
+		{
+			torn++;
+			continue;
+		}
+		if(player != 0 && r->Player != player)
+			continue;
+
+		printf("%14.6f %12.1f  %-8s ", r->TimeNs >= base ? (r->TimeNs - base) / 1e9 : -((base - r->TimeNs) / 1e9),
+			last ? (int64_t)(r->TimeNs - last) / 1e3 : 0.0, TypeName(r->Type));
+		if(r->Player)
+			printf("P%-2u  ", r->Player);
+		else
+			printf("     ");
+		PrintDetail(r, base);
+		printf("\n");
+
+		last = r->TimeNs;
+	}
+
+	if(torn)
+		printf("tracedump: %llu record(s) were being written when the trace stopped and are skipped\n", (unsigned long long)torn);
+
+	munmap((void *)h, st.st_size);
+	close(fd);
+	return 0;
+}